@@ -0,0 +1,43 @@
+#-------------------------------------------------
+#
+# Crawl, unpack, save, load, diff and grouping timings
+# on synthetic heaps or saved snapshot files
+#
+#-------------------------------------------------
+
+QT       += core gui concurrent
+
+TARGET = UMPBench
+TEMPLATE = app
+
+CONFIG += console c++11
+CONFIG -= app_bundle
+
+DEFINES += QT_DEPRECATED_WARNINGS
+
+INCLUDEPATH += $$PWD $$PWD/../include $$PWD/../src
+
+SOURCES += \
+        umpbench.cpp \
+        umpsynthetic.cpp \
+        ../src/globalLog.cpp \
+        ../src/umpanalyzer.cpp \
+        ../src/umpcrawler.cpp \
+        ../src/umpmodel.cpp \
+        ../src/umpquery.cpp \
+        ../src/umpstringpool.cpp \
+        ../src/umptrace.cpp
+
+HEADERS += \
+        umpsynthetic.h \
+        ../include/globalLog.h \
+        ../include/umpanalyzer.h \
+        ../include/umpcrawler.h \
+        ../include/umpmemory.h \
+        ../include/umpmodel.h \
+        ../include/umpparallel.h \
+        ../include/umpquery.h \
+        ../include/umpstringpool.h \
+        ../include/umptrace.h
+
+win32: LIBS += -lpsapi
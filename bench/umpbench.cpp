@@ -0,0 +1,219 @@
+#include "umpcrawler.h"
+#include "umpmodel.h"
+#include "umpsynthetic.h"
+
+#include <QBuffer>
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QDataStream>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QTextStream>
+
+#include <vector>
+
+#if defined(Q_OS_WIN)
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+// UMPBench [--objects n] [--fanout n] [--depth n] [--array-length n] [--array-every n] [--sections n]
+//          [--types n] [--roots n] [--stacks n] [--seed n] [--iterations n]
+// UMPBench --replay file.uss [--iterations n]
+// prints one tab separated line per phase: name, ms, objects/s, MB/s of heap, peak rss in MB
+
+static double PeakRssMegabytes() {
+#if defined(Q_OS_WIN)
+    PROCESS_MEMORY_COUNTERS counters;
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+        return 0;
+    return static_cast<double>(counters.PeakWorkingSetSize) / 1024 / 1024;
+#else
+    rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+        return 0;
+#if defined(Q_OS_MACOS)
+    return static_cast<double>(usage.ru_maxrss) / 1024 / 1024; // bytes
+#else
+    return static_cast<double>(usage.ru_maxrss) / 1024; // kilobytes
+#endif
+#endif
+}
+
+class BenchReport {
+public:
+    BenchReport() : out_(stdout) {
+        out_ << "phase\tms\tobjects/s\tMB/s\tpeak rss MB" << "\n";
+    }
+    void Add(const QString& phase, qint64 nanoseconds, std::uint64_t objectCount, std::uint64_t byteCount) {
+        auto seconds = static_cast<double>(std::max<qint64>(nanoseconds, 1)) / 1e9;
+        out_ << phase << "\t" << QString::number(seconds * 1000, 'f', 1)
+             << "\t" << QString::number(static_cast<double>(objectCount) / seconds, 'f', 0)
+             << "\t" << QString::number(static_cast<double>(byteCount) / 1024 / 1024 / seconds, 'f', 1)
+             << "\t" << QString::number(PeakRssMegabytes(), 'f', 1) << "\n";
+        out_.flush();
+    }
+private:
+    QTextStream out_;
+};
+
+static std::uint64_t HeapBytesOf(const CrawledMemorySnapshot* snapshot) {
+    std::uint64_t bytes = 0;
+    for (auto& section : snapshot->managedHeap_)
+        bytes += section.sectionSize_;
+    return bytes;
+}
+
+static void WriteSnapshotFile(QIODevice* device, const std::vector<CrawledMemorySnapshot*>& snapshots) {
+    QDataStream stream(device);
+    stream.setVersion(QDataStream::Qt_5_12);
+    stream << static_cast<quint32>(APP_MAGIC);
+    stream << static_cast<quint32>(APP_VERSION);
+    stream << static_cast<quint32>(snapshots.size());
+    for (auto snapshot : snapshots)
+        CrawledMemorySnapshot::WriteSnapshot(stream, snapshot, snapshot->name_);
+}
+
+static void FreeSnapshot(CrawledMemorySnapshot* snapshot) {
+    CrawledMemorySnapshot::Free(snapshot);
+    delete snapshot;
+}
+
+// save, load, diff against first and type grouping, shared by both modes
+static void BenchCrawled(BenchReport& report, CrawledMemorySnapshot* snapshot, const CrawledMemorySnapshot* first) {
+    QElapsedTimer timer;
+    auto objectCount = static_cast<std::uint64_t>(snapshot->managedObjects_.size());
+    auto heapBytes = HeapBytesOf(snapshot);
+    QBuffer buffer;
+    buffer.open(QIODevice::ReadWrite);
+    timer.start();
+    WriteSnapshotFile(&buffer, { snapshot });
+    report.Add("save", timer.nsecsElapsed(), objectCount, heapBytes);
+    buffer.seek(0);
+    std::vector<CrawledMemorySnapshot*> loaded;
+    timer.restart();
+    CrawledMemorySnapshot::ReadSnapshotFile(&buffer, loaded);
+    report.Add("load", timer.nsecsElapsed(), objectCount, heapBytes);
+    buffer.close();
+    timer.restart();
+    auto diffed = CrawledMemorySnapshot::Diff(first != nullptr ? first : loaded[0], snapshot);
+    report.Add("diff", timer.nsecsElapsed(), objectCount, heapBytes);
+    // the model takes the snapshot over
+    timer.restart();
+    auto typeGroups = new UMPTypeGroupModel(diffed, nullptr);
+    report.Add("group", timer.nsecsElapsed(), objectCount, heapBytes);
+    delete typeGroups;
+    for (auto snapshot : loaded)
+        FreeSnapshot(snapshot);
+}
+
+static int RunSynthetic(const QCommandLineParser& parser, int iterations) {
+    QTextStream err(stderr);
+    UMPSyntheticOptions options;
+    auto optionValue = [&parser](const char* name, std::uint32_t value) {
+        return parser.isSet(name) ? parser.value(name).toUInt() : value;
+    };
+    options.objectCount_ = optionValue("objects", options.objectCount_);
+    options.fanOut_ = optionValue("fanout", options.fanOut_);
+    options.depth_ = optionValue("depth", options.depth_);
+    options.arrayLength_ = optionValue("array-length", options.arrayLength_);
+    options.arrayEvery_ = optionValue("array-every", options.arrayEvery_);
+    options.sectionCount_ = optionValue("sections", options.sectionCount_);
+    options.typeCount_ = optionValue("types", options.typeCount_);
+    options.rootCount_ = optionValue("roots", options.rootCount_);
+    options.stackCount_ = optionValue("stacks", options.stackCount_);
+    options.seed_ = parser.isSet("seed") ? parser.value("seed").toULongLong() : options.seed_;
+    BenchReport report;
+    QElapsedTimer timer;
+    for (int iteration = 0; iteration < iterations; iteration++) {
+        // crawling marks the generated headers, every iteration needs a fresh heap
+        timer.start();
+        auto raw = UMPGenerateSnapshot(options);
+        std::uint64_t rawBytes = 0;
+        for (std::uint32_t i = 0; i < raw->heap.sectionCount; i++)
+            rawBytes += raw->heap.sections[i].sectionSize;
+        report.Add("generate", timer.nsecsElapsed(), options.objectCount_, rawBytes);
+        PackedCrawlerData packed(raw);
+        Crawler crawler;
+        timer.restart();
+        crawler.Crawl(packed, raw);
+        report.Add("crawl", timer.nsecsElapsed(), packed.managedObjects_.size(), rawBytes);
+        auto snapshot = new CrawledMemorySnapshot();
+        timer.restart();
+        CrawledMemorySnapshot::Unpack(*snapshot, raw, packed);
+        report.Add("unpack", timer.nsecsElapsed(), snapshot->managedObjects_.size(), rawBytes);
+        UMPFreeSyntheticSnapshot(raw);
+        if (snapshot->managedObjects_.size() != options.objectCount_) {
+            err << "crawled " << snapshot->managedObjects_.size() << " of " << options.objectCount_
+                << " generated objects, the rest is unreachable with this fan-out" << "\n";
+        }
+        BenchCrawled(report, snapshot, nullptr);
+        FreeSnapshot(snapshot);
+    }
+    return 0;
+}
+
+// crawling needs the raw capture, so a replay starts at the saved snapshots
+static int RunReplay(const QString& fileName, int iterations) {
+    QTextStream err(stderr);
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        err << "can't open " << fileName << "\n";
+        return 1;
+    }
+    BenchReport report;
+    QElapsedTimer timer;
+    for (int iteration = 0; iteration < iterations; iteration++) {
+        file.seek(0);
+        std::vector<CrawledMemorySnapshot*> snapshots;
+        timer.start();
+        if (CrawledMemorySnapshot::ReadSnapshotFile(&file, snapshots) != 0) {
+            err << fileName << " is not a snapshot file" << "\n";
+            return 1;
+        }
+        std::uint64_t objectCount = 0;
+        std::uint64_t heapBytes = 0;
+        for (auto snapshot : snapshots) {
+            objectCount += snapshot->managedObjects_.size();
+            heapBytes += HeapBytesOf(snapshot);
+        }
+        report.Add("read file", timer.nsecsElapsed(), objectCount, heapBytes);
+        for (std::size_t i = 0; i < snapshots.size(); i++) {
+            auto snapshot = snapshots[i];
+            timer.restart();
+            CrawledMemorySnapshot::BuildIndices(snapshot);
+            report.Add("indices " + snapshot->name_, timer.nsecsElapsed(), snapshot->managedObjects_.size(), HeapBytesOf(snapshot));
+            BenchCrawled(report, snapshot, i > 0 ? snapshots[i - 1] : nullptr);
+        }
+        for (auto snapshot : snapshots)
+            FreeSnapshot(snapshot);
+    }
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Times crawling, unpacking, saving, loading, diffing and grouping of snapshots.");
+    parser.addHelpOption();
+    parser.addOption(QCommandLineOption("objects", "Managed objects to generate.", "n"));
+    parser.addOption(QCommandLineOption("fanout", "Reference fields per class instance.", "n"));
+    parser.addOption(QCommandLineOption("depth", "Levels between the roots and the leaves.", "n"));
+    parser.addOption(QCommandLineOption("array-length", "Elements per object and byte array.", "n"));
+    parser.addOption(QCommandLineOption("array-every", "One object and one byte array per n objects, 0 for none.", "n"));
+    parser.addOption(QCommandLineOption("sections", "Heap sections.", "n"));
+    parser.addOption(QCommandLineOption("types", "Class types the instances are spread over.", "n"));
+    parser.addOption(QCommandLineOption("roots", "GC handles into the first level.", "n"));
+    parser.addOption(QCommandLineOption("stacks", "Thread stacks of 64 KB.", "n"));
+    parser.addOption(QCommandLineOption("seed", "Random seed of the generated heap.", "n"));
+    parser.addOption(QCommandLineOption("iterations", "Times to repeat every phase.", "n", "1"));
+    parser.addOption(QCommandLineOption("replay", "Time the snapshots of a saved .uss file instead.", "file"));
+    parser.process(app);
+    auto iterations = std::max(1, parser.value("iterations").toInt());
+    if (parser.isSet("replay"))
+        return RunReplay(parser.value("replay"), iterations);
+    return RunSynthetic(parser, iterations);
+}
@@ -0,0 +1,290 @@
+#include "umpsynthetic.h"
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <vector>
+
+const std::uint32_t kSyntheticPointerSize = 8;
+const std::uint32_t kSyntheticObjectHeaderSize = 16;
+const std::uint32_t kSyntheticArrayHeaderSize = 32;
+const std::uint32_t kSyntheticGranularity = 16;
+const std::uint32_t kSyntheticStaticFieldCount = 16;
+const std::uint32_t kSyntheticStackSize = 64 * 1024;
+const std::uint64_t kSyntheticHeapBase = 0x1000000000ull;
+const std::uint64_t kSyntheticSectionGap = 1024 * 1024;
+const std::uint64_t kSyntheticTypeInfoBase = 0x70000000ull;
+
+// fixed type indices, the class types of the instances follow them
+enum SyntheticType : std::uint32_t {
+    kSyntheticByte = 0,
+    kSyntheticByteArray,
+    kSyntheticObject,
+    kSyntheticObjectArray,
+    kSyntheticStatics,
+    kSyntheticFirstNode,
+};
+
+// xorshift64*, fast and the same on every platform so runs are comparable
+class SyntheticRandom {
+public:
+    explicit SyntheticRandom(std::uint64_t seed) : state_(seed == 0 ? 0x9E3779B97F4A7C15ull : seed) {}
+    std::uint64_t Next() {
+        state_ ^= state_ >> 12;
+        state_ ^= state_ << 25;
+        state_ ^= state_ >> 27;
+        return state_ * 0x2545F4914F6CDD1Dull;
+    }
+    std::uint32_t Below(std::uint32_t bound) {
+        return bound == 0 ? 0 : static_cast<std::uint32_t>(Next() % bound);
+    }
+private:
+    std::uint64_t state_;
+};
+
+static char* CopyName(const std::string& name) {
+    auto copy = new char[name.size() + 1];
+    memcpy(copy, name.c_str(), name.size() + 1);
+    return copy;
+}
+
+static void InitType(Il2CppMetadataType& type, std::uint32_t index, const std::string& name, const char* assembly,
+                     Il2CppMetadataTypeFlags flags, std::uint32_t baseOrElement, std::uint32_t size) {
+    memset(&type, 0, sizeof(type));
+    type.flags = flags;
+    type.baseOrElementTypeIndex = baseOrElement;
+    type.name = CopyName(name);
+    type.assemblyName = CopyName(assembly);
+    type.typeInfoAddress = kSyntheticTypeInfoBase + index * 0x100;
+    type.size = size;
+    type.typeIndex = index;
+}
+
+static void WritePointer(std::uint8_t* bytes, std::uint64_t value) {
+    memcpy(bytes, &value, sizeof(value));
+}
+
+static std::uint64_t Align(std::uint64_t size) {
+    return (size + kSyntheticGranularity - 1) / kSyntheticGranularity * kSyntheticGranularity;
+}
+
+Il2CppManagedMemorySnapshot* UMPGenerateSnapshot(const UMPSyntheticOptions& options) {
+    auto snapshot = new Il2CppManagedMemorySnapshot();
+    memset(snapshot, 0, sizeof(Il2CppManagedMemorySnapshot));
+    snapshot->runtimeInformation.pointerSize = kSyntheticPointerSize;
+    snapshot->runtimeInformation.objectHeaderSize = kSyntheticObjectHeaderSize;
+    snapshot->runtimeInformation.arrayHeaderSize = kSyntheticArrayHeaderSize;
+    snapshot->runtimeInformation.arrayBoundsOffsetInHeader = 16;
+    snapshot->runtimeInformation.arraySizeOffsetInHeader = 24;
+    snapshot->runtimeInformation.allocationGranularity = kSyntheticGranularity;
+    SyntheticRandom random(options.seed_);
+    auto objectCount = std::max<std::uint32_t>(1, options.objectCount_);
+    auto depth = std::max<std::uint32_t>(1, std::min(options.depth_, objectCount));
+    auto typeCount = std::max<std::uint32_t>(1, options.typeCount_);
+    auto sectionCount = std::max<std::uint32_t>(1, std::min(options.sectionCount_, objectCount));
+    auto arrayRank1 = static_cast<Il2CppMetadataTypeFlags>(kArray | (1 << 16));
+    // types
+    auto& metadata = snapshot->metadata;
+    metadata.typeCount = kSyntheticFirstNode + typeCount;
+    metadata.types = new Il2CppMetadataType[metadata.typeCount];
+    InitType(metadata.types[kSyntheticByte], kSyntheticByte, "System.Byte", "mscorlib", kValueType, static_cast<std::uint32_t>(-1), 1);
+    InitType(metadata.types[kSyntheticByteArray], kSyntheticByteArray, "System.Byte[]", "mscorlib", arrayRank1, kSyntheticByte, 0);
+    InitType(metadata.types[kSyntheticObject], kSyntheticObject, "System.Object", "mscorlib", kNone, static_cast<std::uint32_t>(-1), kSyntheticObjectHeaderSize);
+    InitType(metadata.types[kSyntheticObjectArray], kSyntheticObjectArray, "System.Object[]", "mscorlib", arrayRank1, kSyntheticObject, 0);
+    auto& statics = metadata.types[kSyntheticStatics];
+    InitType(statics, kSyntheticStatics, "Bench.Statics", "Assembly-CSharp", kNone, kSyntheticObject, kSyntheticObjectHeaderSize);
+    statics.fieldCount = kSyntheticStaticFieldCount;
+    statics.fields = new Il2CppMetadataField[statics.fieldCount];
+    for (std::uint32_t j = 0; j < statics.fieldCount; j++)
+        statics.fields[j] = { j * kSyntheticPointerSize, kSyntheticObject, CopyName("s_root" + std::to_string(j)), true };
+    statics.staticsSize = statics.fieldCount * kSyntheticPointerSize;
+    statics.statics = new std::uint8_t[statics.staticsSize];
+    auto nodeSize = kSyntheticObjectHeaderSize + options.fanOut_ * kSyntheticPointerSize;
+    for (std::uint32_t t = 0; t < typeCount; t++) {
+        auto& type = metadata.types[kSyntheticFirstNode + t];
+        InitType(type, kSyntheticFirstNode + t, "Bench.Node" + std::to_string(t), "Assembly-CSharp", kNone, kSyntheticObject, nodeSize);
+        type.fieldCount = options.fanOut_;
+        type.fields = new Il2CppMetadataField[type.fieldCount];
+        for (std::uint32_t j = 0; j < type.fieldCount; j++)
+            type.fields[j] = { kSyntheticObjectHeaderSize + j * kSyntheticPointerSize, kSyntheticObject, CopyName("m_ref" + std::to_string(j)), false };
+    }
+    // object types and sizes, arrays are spread evenly so every level has some
+    std::vector<std::uint32_t> objectTypes(objectCount);
+    std::vector<std::uint64_t> objectSizes(objectCount);
+    std::uint64_t heapSize = 0;
+    for (std::uint32_t i = 0; i < objectCount; i++) {
+        auto slot = options.arrayEvery_ > 0 ? i % options.arrayEvery_ : 2;
+        if (options.arrayEvery_ > 1 && slot == 0) {
+            objectTypes[i] = kSyntheticObjectArray;
+            objectSizes[i] = kSyntheticArrayHeaderSize + static_cast<std::uint64_t>(options.arrayLength_) * kSyntheticPointerSize;
+        } else if (options.arrayEvery_ > 1 && slot == 1) {
+            objectTypes[i] = kSyntheticByteArray;
+            objectSizes[i] = kSyntheticArrayHeaderSize + options.arrayLength_;
+        } else {
+            objectTypes[i] = kSyntheticFirstNode + random.Below(typeCount);
+            objectSizes[i] = nodeSize;
+        }
+        objectSizes[i] = Align(objectSizes[i]);
+        heapSize += objectSizes[i];
+    }
+    // section sizes are 32 bit
+    sectionCount = static_cast<std::uint32_t>(std::max<std::uint64_t>(sectionCount, std::min<std::uint64_t>(objectCount, heapSize / 0x40000000ull + 1)));
+    // sections take consecutive objects until they hold their share of the heap
+    std::vector<std::uint64_t> addresses(objectCount);
+    std::vector<std::uint32_t> sectionFirst;
+    std::vector<std::uint64_t> sectionSizes;
+    {
+        auto share = heapSize / sectionCount + 1;
+        auto address = kSyntheticHeapBase;
+        std::uint64_t sectionSize = 0;
+        for (std::uint32_t i = 0; i < objectCount; i++) {
+            if (i == 0 || (sectionSize >= share && sectionFirst.size() < sectionCount)) {
+                if (i > 0) {
+                    sectionSizes.push_back(sectionSize);
+                    address += kSyntheticSectionGap;
+                }
+                sectionFirst.push_back(i);
+                sectionSize = 0;
+            }
+            addresses[i] = address;
+            address += objectSizes[i];
+            sectionSize += objectSizes[i];
+        }
+        sectionSizes.push_back(sectionSize);
+    }
+    // level l holds objects [levelBegins[l], levelBegins[l + 1]) and references level l + 1. the first level is
+    // one object per gchandle and the levels grow geometrically from there, so with enough reference slots
+    // every object can be given a parent slot in the level before it
+    auto rootCount = std::max<std::uint32_t>(1, std::min(options.rootCount_, objectCount / depth));
+    std::vector<std::uint32_t> levelBegins(depth + 1, objectCount);
+    {
+        auto total = [rootCount, depth](double ratio) {
+            double sum = 0, size = rootCount;
+            for (std::uint32_t l = 0; l < depth; l++, size *= ratio)
+                sum += size;
+            return sum;
+        };
+        double low = 1, high = objectCount;
+        for (int i = 0; i < 64; i++) {
+            auto middle = (low + high) / 2;
+            (total(middle) < objectCount ? low : high) = middle;
+        }
+        double begin = 0, size = rootCount;
+        for (std::uint32_t l = 0; l < depth; l++, size *= low) {
+            levelBegins[l] = static_cast<std::uint32_t>(std::min<double>(begin + 0.5, objectCount));
+            begin += size;
+        }
+    }
+    auto levelSize = [&levelBegins](std::uint32_t level) {
+        return levelBegins[level + 1] - levelBegins[level];
+    };
+    auto randomInLevel = [&](std::uint32_t level) -> std::uint64_t {
+        if (level >= depth || levelSize(level) == 0)
+            return 0;
+        return addresses[levelBegins[level] + random.Below(levelSize(level))];
+    };
+    auto slotCountOf = [&](std::uint32_t i) -> std::uint64_t {
+        if (objectTypes[i] == kSyntheticByteArray)
+            return 0;
+        return objectTypes[i] == kSyntheticObjectArray ? options.arrayLength_ : options.fanOut_;
+    };
+    std::vector<std::uint64_t> levelSlots(depth, 0);
+    for (std::uint32_t l = 0; l < depth; l++) {
+        for (auto i = levelBegins[l]; i < levelBegins[l + 1]; i++)
+            levelSlots[l] += slotCountOf(i);
+    }
+    // slots are handed to the children of the next level evenly, the ones left over point at random
+    // children, making shared references. children past the slot count stay unreachable
+    std::uint32_t level = 0;
+    std::uint64_t slot = 0;
+    auto nextReference = [&]() -> std::uint64_t {
+        auto s = slot++;
+        if (level + 1 >= depth)
+            return 0;
+        auto slots = levelSlots[level];
+        auto children = static_cast<std::uint64_t>(levelSize(level + 1));
+        auto child = (s * children + slots - 1) / slots;
+        if (child < children && child * slots / children == s)
+            return addresses[levelBegins[level + 1] + child];
+        return randomInLevel(level + 1);
+    };
+    auto& heap = snapshot->heap;
+    heap.sectionCount = static_cast<std::uint32_t>(sectionFirst.size());
+    heap.sections = new Il2CppManagedMemorySection[heap.sectionCount];
+    for (std::uint32_t s = 0; s < heap.sectionCount; s++) {
+        auto& section = heap.sections[s];
+        auto first = sectionFirst[s];
+        auto last = s + 1 < heap.sectionCount ? sectionFirst[s + 1] : objectCount;
+        section.sectionStartAddress = addresses[first];
+        section.sectionSize = static_cast<std::uint32_t>(sectionSizes[s]);
+        section.sectionBytes = new std::uint8_t[section.sectionSize];
+        memset(section.sectionBytes, 0, section.sectionSize);
+        for (auto i = first; i < last; i++) {
+            while (level + 1 < depth && i >= levelBegins[level + 1]) {
+                level++;
+                slot = 0;
+            }
+            auto bytes = section.sectionBytes + (addresses[i] - section.sectionStartAddress);
+            auto& type = metadata.types[objectTypes[i]];
+            WritePointer(bytes, type.typeInfoAddress);
+            if (objectTypes[i] == kSyntheticByteArray || objectTypes[i] == kSyntheticObjectArray) {
+                WritePointer(bytes + 24, options.arrayLength_);
+                if (objectTypes[i] == kSyntheticObjectArray) {
+                    for (std::uint32_t j = 0; j < options.arrayLength_; j++)
+                        WritePointer(bytes + kSyntheticArrayHeaderSize + j * kSyntheticPointerSize, nextReference());
+                } else {
+                    memset(bytes + kSyntheticArrayHeaderSize, 0xAB, options.arrayLength_);
+                }
+                continue;
+            }
+            for (std::uint32_t j = 0; j < options.fanOut_; j++)
+                WritePointer(bytes + kSyntheticObjectHeaderSize + j * kSyntheticPointerSize, nextReference());
+        }
+    }
+    // crawler sorts the sections, so hand them over in any order
+    for (std::uint32_t s = heap.sectionCount; s > 1; s--)
+        std::swap(heap.sections[s - 1], heap.sections[random.Below(s)]);
+    // a gchandle per object of the first level
+    snapshot->gcHandles.trackedObjectCount = levelSize(0);
+    snapshot->gcHandles.pointersToObjects = new std::uint64_t[levelSize(0)];
+    for (std::uint32_t i = 0; i < levelSize(0); i++)
+        snapshot->gcHandles.pointersToObjects[i] = addresses[i];
+    for (std::uint32_t j = 0; j < statics.fieldCount; j++)
+        WritePointer(statics.statics + j * kSyntheticPointerSize, randomInLevel(0));
+    // stacks are mostly small integers and return addresses, one word in 16 points at an object
+    snapshot->stacks.stackCount = options.stackCount_;
+    snapshot->stacks.stacks = new Il2CppManagedMemorySection[options.stackCount_];
+    for (std::uint32_t s = 0; s < options.stackCount_; s++) {
+        auto& stack = snapshot->stacks.stacks[s];
+        stack.sectionStartAddress = 0x7F0000000000ull + static_cast<std::uint64_t>(s) * 0x100000;
+        stack.sectionSize = kSyntheticStackSize;
+        stack.sectionBytes = new std::uint8_t[stack.sectionSize];
+        for (std::uint32_t offset = 0; offset < stack.sectionSize; offset += kSyntheticPointerSize) {
+            auto word = random.Next();
+            word = (word & 15) == 0 ? randomInLevel(random.Below(depth)) : (word >> 40);
+            WritePointer(stack.sectionBytes + offset, word);
+        }
+    }
+    return snapshot;
+}
+
+void UMPFreeSyntheticSnapshot(Il2CppManagedMemorySnapshot* snapshot) {
+    for (std::uint32_t i = 0; i < snapshot->heap.sectionCount; i++)
+        delete[] snapshot->heap.sections[i].sectionBytes;
+    delete[] snapshot->heap.sections;
+    for (std::uint32_t i = 0; i < snapshot->stacks.stackCount; i++)
+        delete[] snapshot->stacks.stacks[i].sectionBytes;
+    delete[] snapshot->stacks.stacks;
+    delete[] snapshot->gcHandles.pointersToObjects;
+    for (std::uint32_t i = 0; i < snapshot->metadata.typeCount; i++) {
+        auto& type = snapshot->metadata.types[i];
+        for (std::uint32_t j = 0; j < type.fieldCount; j++)
+            delete[] type.fields[j].name;
+        delete[] type.fields;
+        delete[] type.statics;
+        delete[] type.name;
+        delete[] type.assemblyName;
+    }
+    delete[] snapshot->metadata.types;
+    delete snapshot;
+}
@@ -0,0 +1,26 @@
+#ifndef UMPSYNTHETIC_H
+#define UMPSYNTHETIC_H
+
+#include <cstdint>
+
+#include "umpmemory.h"
+
+// shape of a generated heap, objects are laid out in depth levels and every level only references the next one
+struct UMPSyntheticOptions {
+    std::uint32_t objectCount_ = 1000000;
+    std::uint32_t fanOut_ = 4; // reference fields per class instance
+    std::uint32_t depth_ = 8; // levels between the roots and the leaves
+    std::uint32_t arrayLength_ = 32; // elements of every object and byte array
+    std::uint32_t arrayEvery_ = 16; // one object array and one byte array per this many objects, 0 for none
+    std::uint32_t sectionCount_ = 64;
+    std::uint32_t typeCount_ = 256; // class types the instances are spread over
+    std::uint32_t rootCount_ = 1024; // gchandles, one per object of the first level, the levels below grow geometrically
+    std::uint32_t stackCount_ = 16;
+    std::uint64_t seed_ = 1;
+};
+
+// a snapshot as RemoteProcess decodes it, with 64 bit il2cpp header sizes
+Il2CppManagedMemorySnapshot* UMPGenerateSnapshot(const UMPSyntheticOptions& options);
+void UMPFreeSyntheticSnapshot(Il2CppManagedMemorySnapshot* snapshot);
+
+#endif // UMPSYNTHETIC_H
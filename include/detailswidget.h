@@ -3,9 +3,9 @@
 
 #include <QWidget>
 #include <QListWidget>
+#include <QListView>
 
 #include <vector>
-#include <unordered_map>
 
 namespace Ui {
 class DetailsWidget;
@@ -19,6 +19,8 @@ struct ThingInMemory;
 struct ManagedObject;
 struct CrawledMemorySnapshot;
 class PrimitiveValueReader;
+class UMPThingLinkModel;
+class UMPObjectValueModel;
 class DetailsWidget : public QWidget {
     Q_OBJECT
 public:
@@ -32,14 +34,17 @@ signals:
 
 private slots:
     void OnListItemDoubleClicked(QListWidgetItem *item);
+    void OnListIndexDoubleClicked(const QModelIndex &index);
 
 private:
-    void SizeToContent(QListWidget* widget);
-    void DrawLinks(QListWidget* widget, const std::vector<std::uint64_t>& pointers);
+    void SizeToContent(QAbstractItemView* view);
     void DrawLinks(QListWidget* widget, const std::vector<ThingInMemory*> things);
     ThingInMemory* GetThingAt(std::uint64_t address);
+    QString PathCaptionOf(const ThingInMemory* thing) const;
+    QString PathText(const std::vector<const ThingInMemory*>& path) const;
+    void DrawPaths(QListWidget* widget, ThingInMemory* thing);
 
-    void DrawFields(QListWidget* widget, TypeDescription* type, const BytesAndOffset& bo, bool useStatics = false);
+    void DrawFields(QListWidget* widget, const TypeDescription* type, const BytesAndOffset& bo, bool useStatics = false);
     void DrawFields(QListWidget* widget, ManagedObject* mo);
     void DrawValueFor(QListWidget* widget, const FieldDescription* field, const BytesAndOffset& bo);
 
@@ -47,7 +52,9 @@ private:
     Ui::DetailsWidget *ui;
     CrawledMemorySnapshot* snapshot_;
     PrimitiveValueReader* primitiveValueReader_;
-    std::unordered_map<std::uint64_t, ThingInMemory*> managedObjCache_;
+    UMPObjectValueModel* valueModel_;
+    UMPThingLinkModel* refsModel_;
+    UMPThingLinkModel* refbysModel_;
 };
 
 #endif // DETAILSWIDGET_H
@@ -3,14 +3,38 @@
 
 #include <QString>
 
-class GlobalLogDef  {
-public:
-    GlobalLogDef();
-    static void writeToFile(QString &str,int type);
-    static void writeToFile(int &str,int type);
-    static QString  log;
+#include <atomic>
+
+enum class UMPLogLevel : int {
+    kDebug = 0,
+    kInfo,
+    kWarning,
+    kError,
+    kOff,
 };
 
-#endif // GLOBALLOG_H
+// messages go into a fixed ring of slots without taking a lock and a background thread writes them out,
+// a full ring drops messages rather than blocking the caller. nothing is logged before Start
+class UMPLog {
+public:
+    // level defaults to UMP_LOG_LEVEL from the environment (debug, info, warning, error, off), else info
+    static void Start(const QString& fileName);
+    static void Start(const QString& fileName, UMPLogLevel level);
+    // writes out what is left and joins the flush thread
+    static void Stop();
+    static void SetLevel(UMPLogLevel level);
+    static bool IsEnabled(UMPLogLevel level) { return static_cast<int>(level) >= level_.load(std::memory_order_relaxed); }
+    static void Write(UMPLogLevel level, const QString& message);
 
+private:
+    static std::atomic<int> level_;
+};
+
+// the message is only built when its level is enabled, cheap enough for model data()
+#define UMPLOG(level, message) do { if (UMPLog::IsEnabled(level)) UMPLog::Write(level, message); } while (0)
+#define UMPLOGD(message) UMPLOG(UMPLogLevel::kDebug, message)
+#define UMPLOGI(message) UMPLOG(UMPLogLevel::kInfo, message)
+#define UMPLOGW(message) UMPLOG(UMPLogLevel::kWarning, message)
+#define UMPLOGE(message) UMPLOG(UMPLogLevel::kError, message)
 
+#endif // GLOBALLOG_H
@@ -2,6 +2,8 @@
 #define MAINWINDOW_H
 
 #include <QMainWindow>
+#include <QElapsedTimer>
+#include <QFutureWatcher>
 #include <QProgressDialog>
 #include <QTimer>
 #include <QMap>
@@ -16,6 +18,10 @@ class MainWindow;
 
 class QFile;
 struct CrawledMemorySnapshot;
+class UMPDuplicateGroupModel;
+class UMPDuplicateTypeModel;
+class UMPQueryGroupModel;
+enum class UMPExportTable;
 class MainWindow : public QMainWindow {
     Q_OBJECT
 public:
@@ -26,7 +32,6 @@ public:
     void SaveSettings();
 
     void closeEvent(QCloseEvent *event) override;
-    static QString globalLog ;
 
 private:
     void SaveToFile(QFile *file);
@@ -37,10 +42,13 @@ private:
 
     void ConnectionFailed();
     void ShowSnapshot(CrawledMemorySnapshot* snapshot);
+    void AddAnalysisPage(QWidget* page, const QString& title, const QString& toolTip);
+    void ShowDuplicateGroups(UMPDuplicateGroupModel* model, const QString& title, UMPDuplicateTypeModel* typeModel = nullptr);
+    void ShowQueryResult(UMPQueryGroupModel* model, const QString& query);
+    void SelectType(std::uint32_t typeIndex, bool showObjectsPage = true);
     void UpdateShowNextPrev();
-    QString _cacheCsvContent;
-    bool exportExecl( QString &fileName, QString &datas);
-
+    void ExportTable(const CrawledMemorySnapshot* snapshot, UMPExportTable table, const QString& fileName);
+    void WaitForExport();
 
 private slots:
     void FixedUpdate();
@@ -51,9 +59,12 @@ private slots:
 
     void OnTabBarContextMenuRequested(const QPoint& pos);
     void OnThingSelected(std::uint32_t index);
+    void OnExportFinished();
 
     void on_actionOpen_triggered();
     void on_actionSave_triggered();
+    void on_actionExport_Table_triggered();
+    void on_actionExport_Trace_triggered();
     void on_actionExit_triggered();
     void on_actionAbout_triggered();
     void on_sdkPushButton_clicked();
@@ -67,6 +78,14 @@ private slots:
     void on_actionJump_Forward_triggered();
     void on_actionMark_First_triggered();
     void on_actionMark_Second_triggered();
+    void on_actionDuplicate_Strings_triggered();
+    void on_actionDuplicate_Arrays_triggered();
+    void on_actionQuery_triggered();
+    void on_actionAssembly_Rollup_triggered();
+    void on_actionTreemap_triggered();
+    void on_actionHeap_Fragmentation_triggered();
+    void on_actionUnreachable_Objects_triggered();
+    void on_actionRoots_triggered();
 
 private:
     Ui::MainWindow *ui;
@@ -75,11 +94,17 @@ private:
     QString pythonPath_;
     QString appPid_;
     QString lastOpenDir_;
+    QString lastQuery_;
     QTimer* mainTimer_;
 
     QMap<QWidget*, struct SnapshotTabInfo> snapShots_;
     QWidget* firstDiffPage_ = nullptr;
 
+    // exports run off the ui thread, the snapshot must outlive them
+    QFutureWatcher<int> exportWatcher_;
+    QElapsedTimer exportTimer_;
+    QString exportFileName_;
+
     // adb shell monkey -p packagename -c android.intent.category.LAUNCHER 1
     StartAppProcess *startAppProcess_;
 
@@ -50,6 +50,9 @@ private:
     quint32 compressBufferSize_ = 1024;
     QByteArray bufferCache_;
     Il2CppManagedMemorySnapshot *snapShot_ = nullptr;
+    // capture clock times of the last request and of the first bytes of the packet being received
+    std::int64_t requestTime_ = 0;
+    std::int64_t packetTime_ = 0;
 };
 
 #endif // STACKTRACEPROCESS_H
@@ -0,0 +1,135 @@
+#ifndef UMPANALYZER_H
+#define UMPANALYZER_H
+
+#include <QString>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+struct CrawledMemorySnapshot;
+
+// managed objects whose payloads are byte-for-byte identical
+struct UMPDuplicateGroup {
+    std::vector<std::uint32_t> objects_; // managedObjects_ indices
+    std::int64_t instanceSize_ = 0; // from the object header, also in a diff
+    std::int64_t wastedSize_ = 0; // every copy but one
+};
+
+// duplicate totals of one type, e.g. every System.Byte[] group
+struct UMPDuplicateTypeSummary {
+    std::uint32_t typeIndex_ = 0;
+    std::uint32_t groupCount_ = 0;
+    std::uint32_t copyCount_ = 0; // every copy but one, summed over the groups
+    std::int64_t wastedSize_ = 0;
+};
+
+// 64-bit hash over four independent 8-byte lanes, so the block loop pipelines (and vectorizes where
+// 64-bit multiplies do), only meant for bucketing payloads before an exact compare
+std::uint64_t UMPHashBytes(const std::uint8_t* data, std::size_t size);
+
+// System.String instances grouped by content, most wasted bytes first
+void UMPFindDuplicateStrings(const CrawledMemorySnapshot* snapshot, std::vector<UMPDuplicateGroup>& outGroups);
+
+// arrays of value types (byte[], int[], Vector3[]...) grouped by element bytes, most wasted bytes first
+void UMPFindDuplicateArrays(const CrawledMemorySnapshot* snapshot, std::vector<UMPDuplicateGroup>& outGroups);
+
+// per type totals of groups found above, most wasted bytes first
+void UMPSummarizeDuplicatesByType(const CrawledMemorySnapshot* snapshot, const std::vector<UMPDuplicateGroup>& groups,
+                                  std::vector<UMPDuplicateTypeSummary>& outSummaries);
+
+enum class UMPRollupLevel {
+    kRoot,
+    kAssembly,
+    kNamespace,
+    kType
+};
+
+// one node of the assembly -> namespace -> type rollup, node 0 is the root holding the snapshot totals
+struct UMPRollupNode {
+    QString name_;
+    UMPRollupLevel level_ = UMPRollupLevel::kRoot;
+    std::uint32_t parent_ = 0;
+    std::vector<std::uint32_t> children_; // most retained first
+    std::uint32_t typeIndex_ = 0; // kType only
+    std::uint32_t count_ = 0; // statics and managed objects
+    std::int64_t shallowSize_ = 0;
+    // everything only reachable through the node's objects, objects dominated by another one of the same node count once
+    std::int64_t retainedSize_ = 0;
+};
+
+// namespace part of a type name, generic arguments and array ranks don't count
+QString UMPNamespaceOf(const QString& typeName);
+
+// rolls per type totals up to namespaces and assemblies, retained sizes come from a single walk of the dominator tree
+void UMPBuildRollup(const CrawledMemorySnapshot* snapshot, std::vector<UMPRollupNode>& outNodes);
+
+// cells of a section's heat strip, each holds the live fraction of 1/kHeatStripCells of the section
+const std::size_t kHeatStripCells = 128;
+// hole histogram buckets, bucket i holds holes of [2^i, 2^(i+1)) bytes
+const std::size_t kHoleBuckets = 32;
+
+// live objects versus holes in one managedHeap_ section
+struct UMPSectionOccupancy {
+    std::uint32_t section_ = 0; // managedHeap_ index
+    std::uint64_t start_ = 0;
+    std::uint64_t size_ = 0;
+    std::uint64_t liveSize_ = 0;
+    std::uint32_t objectCount_ = 0;
+    std::uint64_t freeSize_ = 0; // bytes not covered by a reachable object
+    std::uint32_t holeCount_ = 0;
+    std::uint64_t largestHole_ = 0;
+    float cells_[kHeatStripCells];
+};
+
+struct UMPFragmentationReport {
+    std::vector<UMPSectionOccupancy> sections_; // by address
+    std::uint64_t holeCounts_[kHoleBuckets];
+    std::uint64_t holeSizes_[kHoleBuckets];
+    std::uint64_t heapSize_ = 0;
+    std::uint64_t liveSize_ = 0;
+    std::uint64_t largestHole_ = 0;
+};
+
+// sweeps the address sorted objects against the sorted sections once, so it is linear in both
+void UMPAnalyzeFragmentation(const CrawledMemorySnapshot* snapshot, UMPFragmentationReport& outReport);
+
+// objects of one type found by the heap walk that no root reaches
+struct UMPUnreachableTypeSummary {
+    std::uint32_t typeIndex_ = 0;
+    std::uint32_t count_ = 0;
+    std::uint64_t size_ = 0;
+};
+
+struct UMPHeapWalkReport {
+    std::vector<UMPUnreachableTypeSummary> types_; // most bytes first
+    std::uint64_t reachableCount_ = 0;
+    std::uint64_t reachableSize_ = 0;
+    std::uint64_t unreachableCount_ = 0;
+    std::uint64_t unreachableSize_ = 0;
+};
+
+// walks every heap section from start to end, parsing an object header wherever no reachable object starts.
+// a header counts if its class pointer is a known reference type and the size rules fit the object into the
+// section before the next reachable object, otherwise the walk moves on by the allocation granularity.
+// sections are split across threads
+void UMPWalkHeap(const CrawledMemorySnapshot* snapshot, UMPHeapWalkReport& outReport);
+
+// a gchandle, static field holder or thread stack and what it alone keeps alive
+struct UMPRootSummary {
+    std::uint32_t index_ = 0; // allObjects_ index of the root
+    std::uint32_t retainedCount_ = 0; // things the root dominates, itself included
+    std::int64_t retainedSize_ = 0;
+};
+
+struct UMPRootReport {
+    std::vector<UMPRootSummary> roots_; // most retained bytes first
+    // reachable things kept alive by more than one root, so retained by none of them
+    std::uint64_t sharedCount_ = 0;
+    std::int64_t sharedSize_ = 0;
+};
+
+// ranks the roots by retained size, counts come from a single pass up the dominator tree
+void UMPBuildRootReport(const CrawledMemorySnapshot* snapshot, UMPRootReport& outReport);
+
+#endif // UMPANALYZER_H
@@ -5,10 +5,24 @@
 #include <QDataStream>
 
 #include <cstdint>
+#include <limits>
+#include <memory>
 #include <vector>
 #include <unordered_map>
 
 #include "umpmemory.h"
+#include "umpstringpool.h"
+
+// .uss snapshot files
+#define APP_MAGIC 0xA1B9E9F7
+#define APP_VERSION 5
+#define APP_VERSION_FIELD_IDS 2
+#define APP_VERSION_STACK_ROOTS 3
+#define APP_VERSION_STATIC_FIELD_ROOTS 4
+// field path table, field ids only next to the refs
+#define APP_VERSION_FIELD_PATHS 5
+
+class QIODevice;
 
 struct Connection {
     std::uint32_t from_;
@@ -16,6 +30,19 @@ struct Connection {
     Connection(std::uint32_t from, std::uint32_t to) : from_(from), to_(to) {}
 };
 
+// field ids stored per connection: an index into the flat list of every type's fields (in type order),
+// an array element index tagged with kFieldIdArrayElement, or a FieldPath index tagged with kFieldIdPath
+const std::uint32_t kFieldIdNone = 0xFFFFFFFF;
+const std::uint32_t kFieldIdArrayElement = 0x80000000;
+const std::uint32_t kFieldIdPath = 0x40000000;
+
+// a reference inside an embedded struct or a struct array element, e.g. .outer.inner or [].name. paths are
+// kept per type and field, never per element, the element index is read back from the array when shown
+struct FieldPath {
+    std::uint32_t parent_; // field id of the struct holding the field, kFieldIdArrayElement for any element
+    std::uint32_t fieldId_;
+};
+
 struct PackedManagedObject {
     std::uint64_t address_;
     std::uint32_t typeIndex_;
@@ -25,11 +52,22 @@ struct PackedManagedObject {
 struct StartIndices {
     std::uint32_t gcHandleCount_;
     std::uint32_t staticFieldsCount_;
-    StartIndices(std::uint32_t gcHandleCount = 0, std::uint32_t staticFieldsCount = 0)
-        : gcHandleCount_(gcHandleCount), staticFieldsCount_(staticFieldsCount) {}
+    std::uint32_t staticFieldRootCount_;
+    std::uint32_t stackCount_;
+    StartIndices(std::uint32_t gcHandleCount = 0, std::uint32_t staticFieldsCount = 0, std::uint32_t staticFieldRootCount = 0, std::uint32_t stackCount = 0)
+        : gcHandleCount_(gcHandleCount), staticFieldsCount_(staticFieldsCount), staticFieldRootCount_(staticFieldRootCount), stackCount_(stackCount) {}
     std::uint32_t OfFirstGCHandle() const { return 0; }
     std::uint32_t OfFirstStaticFields() const { return OfFirstGCHandle() + gcHandleCount_; }
-    std::uint32_t OfFirstManagedObject() const { return OfFirstStaticFields() + staticFieldsCount_; }
+    std::uint32_t OfFirstStaticFieldRoot() const { return OfFirstStaticFields() + staticFieldsCount_; }
+    std::uint32_t OfFirstStack() const { return OfFirstStaticFieldRoot() + staticFieldRootCount_; }
+    std::uint32_t OfFirstManagedObject() const { return OfFirstStack() + stackCount_; }
+};
+
+// a static field that can hold references, crawled as a root of its own
+struct PackedStaticFieldRoot {
+    std::uint32_t holder_; // index into typesWithStaticFields_
+    std::uint32_t fieldIndex_; // into the holder's fields
+    std::uint32_t fieldId_;
 };
 
 struct PackedCrawlerData {
@@ -38,7 +76,11 @@ struct PackedCrawlerData {
     StartIndices startIndices_;
     std::vector<PackedManagedObject> managedObjects_;
     std::vector<Il2CppMetadataType*> typesWithStaticFields_;
+    // filled by Crawler::Crawl, which knows which field types can hold references
+    std::vector<PackedStaticFieldRoot> staticFieldRoots_;
     std::vector<Connection> connections_;
+    std::vector<std::uint32_t> connectionFields_; // parallel to connections_
+    std::vector<FieldPath> fieldPaths_;
     std::vector<Il2CppMetadataType*> typeDescriptions_;
     PackedCrawlerData(Il2CppManagedMemorySnapshot* snapshot) {
         valid_ = true;
@@ -50,6 +92,7 @@ struct PackedCrawlerData {
         }
         startIndices_.gcHandleCount_ = snapshot->gcHandles.trackedObjectCount;
         startIndices_.staticFieldsCount_ = static_cast<std::uint32_t>(typesWithStaticFields_.size());
+        startIndices_.stackCount_ = snapshot->stacks.stackCount;
     }
 };
 
@@ -96,26 +139,101 @@ struct BytesAndOffset {
     }
 };
 
+// branchless lower bound on values sorted by keyOf, the halving loop compiles to conditional moves
+// so it doesn't stall on mispredicted branches when searching millions of addresses
+template<typename T, typename KeyOf>
+inline std::size_t UMPLowerBound(const T* values, std::size_t count, std::uint64_t key, KeyOf keyOf) {
+    if (count == 0)
+        return 0;
+    const T* base = values;
+    while (count > 1) {
+        auto half = count / 2;
+        base = keyOf(base[half]) < key ? base + half : base;
+        count -= half;
+    }
+    return static_cast<std::size_t>(base - values) + (keyOf(*base) < key ? 1 : 0);
+}
+
+// index of the section holding addr in sections sorted by start address, count if none
+template<typename Section, typename StartOf, typename SizeOf>
+inline std::size_t UMPFindSection(const Section* sections, std::size_t count, std::uint64_t addr, StartOf startOf, SizeOf sizeOf) {
+    auto i = UMPLowerBound(sections, count, addr, startOf);
+    if (i < count && startOf(sections[i]) == addr)
+        return i;
+    if (i == 0)
+        return count;
+    i--;
+    return addr < startOf(sections[i]) + static_cast<std::uint64_t>(sizeOf(sections[i])) ? i : count;
+}
+
+// builtin types the details view decodes directly, resolved from the type name once per snapshot
+enum class PrimitiveKind : std::uint8_t {
+    kNone = 0,
+    kBoolean,
+    kChar,
+    kSByte,
+    kByte,
+    kInt16,
+    kUInt16,
+    kInt32,
+    kUInt32,
+    kInt64,
+    kUInt64,
+    kSingle,
+    kDouble,
+    kIntPtr,
+    kUIntPtr,
+    kString,
+};
+
+PrimitiveKind PrimitiveKindOf(const QString& typeName);
+
+// how the crawler sizes an object of a type, resolved once per type index
+enum class CrawledObjectKind : std::uint8_t {
+    kPlain = 0,
+    kString,
+    kArray,
+};
+
 class Crawler {
 public:
     void Crawl(PackedCrawlerData& result, Il2CppManagedMemorySnapshot* snapshot);
-    void CrawlPointer(Il2CppManagedMemorySnapshot* snapshot, StartIndices startIndices, std::uint64_t pointer, std::uint32_t indexOfFrom,
-                      std::vector<Connection>& oConnections, std::vector<PackedManagedObject>& outManagedObjects);
+    // conservative scan of every thread stack: sorted, distinct addresses of the objects each stack's
+    // pointer aligned words point at. must run before crawling marks the object headers
+    void FindStackReferences(Il2CppManagedMemorySnapshot* snapshot, std::vector<std::vector<std::uint64_t>>& outReferences);
+    void CrawlPointer(Il2CppManagedMemorySnapshot* snapshot, StartIndices startIndices, std::uint64_t pointer, std::uint32_t indexOfFrom, std::uint32_t fieldId,
+                      std::vector<Connection>& oConnections, std::vector<std::uint32_t>& outConnectionFields, std::vector<PackedManagedObject>& outManagedObjects);
     void ParseObjectHeader(StartIndices& startIndices, Il2CppManagedMemorySnapshot* snapshot, std::uint64_t originalHeapAddress, std::uint64_t& typeInfoAddress,
                            std::uint32_t& indexOfObject, bool& wasAlreadyCrawled, std::vector<PackedManagedObject>& outManagedObjects);
+    // fieldPath is the field id of the struct being crawled inside indexOfFrom, kFieldIdNone for the object's own fields
     void CrawlRawObjectData(Il2CppManagedMemorySnapshot* packedMemorySnapshot, StartIndices startIndices, BytesAndOffset bytesAndOffset,
-                            Il2CppMetadataType* typeDescription, bool useStaticFields, std::uint32_t indexOfFrom,
-                            std::vector<Connection>& out_connections, std::vector<PackedManagedObject>& out_managedObjects);
+                            Il2CppMetadataType* typeDescription, bool useStaticFields, std::uint32_t indexOfFrom, std::uint32_t fieldPath,
+                            std::vector<Connection>& out_connections, std::vector<std::uint32_t>& out_connectionFields,
+                            std::vector<PackedManagedObject>& out_managedObjects);
     int SizeOfObjectInBytes(Il2CppMetadataType* typeDescription, BytesAndOffset bo, Il2CppManagedMemorySnapshot* snapshot, std::uint64_t address);
+    // true if instances of the type can't hold managed pointers (primitives and blittable structs)
+    bool HasNoReferences(Il2CppMetadataType* typeDescription);
+    // field id of fieldId inside the struct at parent, every distinct path is stored once
+    std::uint32_t FieldPathOf(std::uint32_t parent, std::uint32_t fieldId);
 private:
     std::unordered_map<std::uint64_t, Il2CppMetadataType*> typeInfoToTypeDescription_;
     std::vector<Il2CppMetadataType*> typeDescriptions_;
+    std::vector<std::uint32_t> fieldIdBases_;
+    std::vector<PrimitiveKind> primitiveKinds_;
+    std::vector<CrawledObjectKind> objectKinds_;
+    // bytes per element for array types, 0 for the rest
+    std::vector<std::uint32_t> elementSizes_;
+    // ReferenceScan per type index, filled on demand by HasNoReferences
+    std::vector<std::uint8_t> referenceScans_;
+    std::vector<FieldPath> fieldPaths_;
+    // parent << 32 | fieldId -> index into fieldPaths_
+    std::unordered_map<std::uint64_t, std::uint32_t> fieldPathIndices_;
 };
 
 struct FieldDescription {
     std::uint32_t offset_;
     std::uint32_t typeIndex_;
-    QString name_;
+    std::uint32_t nameId_; // in UMPTypeCatalog::strings_
     bool isStatic_;
 };
 
@@ -130,34 +248,13 @@ enum class CrawledDiffFlags : std::uint8_t {
 struct TypeDescription {
     Il2CppMetadataTypeFlags flags_;
     std::vector<FieldDescription> fields_;
-    std::uint8_t* statics_ = nullptr;
-    std::uint32_t staticsSize_ = 0;
     std::uint32_t baseOrElementTypeIndex_;
-    QString name_;
-    QString assemblyName_;
-    std::uint64_t typeInfoAddress_;
+    // in UMPTypeCatalog::strings_
+    std::uint32_t nameId_;
+    std::uint32_t assemblyNameId_;
     std::int64_t size_;
     std::uint32_t typeIndex_;
-    TypeDescription() = default;
-    TypeDescription(const TypeDescription& other) {
-        flags_ = other.flags_;
-        fields_ = other.fields_;
-        baseOrElementTypeIndex_ = other.baseOrElementTypeIndex_;
-        name_ = other.name_;
-        assemblyName_ = other.assemblyName_;
-        typeInfoAddress_ = other.typeInfoAddress_;
-        size_ = other.size_;
-        typeIndex_ = other.typeIndex_;
-        if (statics_ != nullptr) {
-            delete statics_;
-            statics_ = nullptr;
-        }
-        staticsSize_ = other.staticsSize_;
-        if (staticsSize_ > 0) {
-            statics_ = new std::uint8_t[staticsSize_];
-            memcpy(statics_, other.statics_, staticsSize_);
-        }
-    }
+    PrimitiveKind primitiveKind_ = PrimitiveKind::kNone;
     bool IsArray() const {
         return (flags_ & Il2CppMetadataTypeFlags::kArray) != 0;
     }
@@ -169,11 +266,37 @@ struct TypeDescription {
     }
 };
 
+// everything about the types of a build that doesn't change between captures. snapshots of the same build
+// share one catalog, static field bytes and class pointers stay with each snapshot
+struct UMPTypeCatalog {
+    std::vector<TypeDescription> types_;
+    // type, assembly and field names
+    UMPStringPool strings_;
+    // first field id of every type, see kFieldIdNone
+    std::vector<std::uint32_t> fieldIdBases_;
+    std::uint64_t hash_ = 0;
+
+    QString TypeName(const TypeDescription& type) const { return strings_.String(type.nameId_); }
+    QString AssemblyName(const TypeDescription& type) const { return strings_.String(type.assemblyNameId_); }
+    QString FieldName(const FieldDescription& field) const { return strings_.String(field.nameId_); }
+
+    // the live catalog with the same types, or a new one made of them. primitiveKind_ is filled in here
+    static std::shared_ptr<const UMPTypeCatalog> Intern(std::vector<TypeDescription>&& types, UMPStringPool&& strings);
+    static std::uint64_t HashOf(const std::vector<TypeDescription>& types, const UMPStringPool& strings);
+};
+
+const std::uint32_t kUnreachableDistance = std::numeric_limits<std::uint32_t>::max();
+const std::uint32_t kNoManagedObject = std::numeric_limits<std::uint32_t>::max();
+// immediate dominator of roots and unreachable things
+const std::uint32_t kNoDominator = std::numeric_limits<std::uint32_t>::max();
+
 enum class ThingType {
     NONE = 0,
     MANAGED,
     GCHANDLE,
-    STATIC
+    STATIC,
+    STACK,
+    STATIC_FIELD
 };
 
 struct ThingInMemory {
@@ -196,20 +319,36 @@ struct ThingInMemory {
 
 struct ManagedObject : public ThingInMemory {
     std::uint64_t address_;
-    TypeDescription* typeDescription_;
+    const TypeDescription* typeDescription_;
     ThingType type() const override { return ThingType::MANAGED; }
 };
 
 struct GCHandle : public ThingInMemory {
+    // managedObjects_ index of the object the handle points at, kNoManagedObject for null and non heap pointers
+    std::uint32_t target_ = kNoManagedObject;
     ThingType type() const override { return ThingType::GCHANDLE; }
 };
 
 struct StaticFields : public ThingInMemory {
-    TypeDescription* typeDescription_;
+    const TypeDescription* typeDescription_;
     std::uint64_t nameHash_;
     ThingType type() const override { return ThingType::STATIC; }
 };
 
+// one static field of a type and what it references, the slot's bytes are taken off its StaticFields holder
+struct StaticFieldRoot : public ThingInMemory {
+    const TypeDescription* typeDescription_;
+    std::uint32_t fieldId_;
+    std::uint64_t nameHash_;
+    ThingType type() const override { return ThingType::STATIC_FIELD; }
+};
+
+// a thread stack, referencing every object one of its words points at
+struct StackRoot : public ThingInMemory {
+    std::uint64_t stackAddress_;
+    ThingType type() const override { return ThingType::STACK; }
+};
+
 struct CrawledManagedMemorySection {
     std::uint64_t sectionStartAddress_ = 0;
     std::uint32_t sectionSize_ = 0;
@@ -225,11 +364,39 @@ struct CrawledMemorySnapshot {
     std::vector<GCHandle> gcHandles_{};
     std::vector<ManagedObject> managedObjects_{};
     std::vector<StaticFields> staticFields_{};
+    std::vector<StaticFieldRoot> staticFieldRoots_{};
+    std::vector<StackRoot> stackRoots_{};
 
     std::vector<ThingInMemory*> allObjects_{};
+    // field id of every reference, one per edge for both directions: thing t's references_[j] is
+    // referenceFields_[referenceFieldStarts_[t] + j]
+    std::vector<std::uint32_t> referenceFields_{};
+    std::vector<std::uint32_t> referenceFieldStarts_{};
+    // the referenceFields_ slot of thing t's referencedBy_[i] at referencedBySlots_[referencedByStarts_[t] + i]
+    std::vector<std::uint32_t> referencedBySlots_{};
+    std::vector<std::uint32_t> referencedByStarts_{};
+    // targets of field ids tagged with kFieldIdPath
+    std::vector<FieldPath> fieldPaths_{};
 
     std::vector<CrawledManagedMemorySection> managedHeap_;
-    std::vector<TypeDescription> typeDescriptions_{};
+    std::shared_ptr<const UMPTypeCatalog> typeCatalog_{};
+    // static field bytes of every type back to back, type i owns [staticsOffsets_[i], staticsOffsets_[i + 1])
+    std::uint8_t* staticsBytes_ = nullptr;
+    std::vector<std::uint32_t> staticsOffsets_{};
+    // the runtime's class pointer of every type, differs between runs of the same build
+    std::vector<std::uint64_t> typeInfoAddresses_{};
+
+    // shortest reference count from any gchandle, static, static field or stack root, indexed by ThingInMemory::index_
+    std::vector<std::uint32_t> rootDistances_{};
+    // nearest thing every path from the roots goes through, kNoDominator for roots and unreachable things
+    std::vector<std::uint32_t> immediateDominators_{};
+    // reachable things, each before its immediate dominator
+    std::vector<std::uint32_t> dominatorOrder_{};
+    // size_ plus the size of everything only reachable through the thing, by ThingInMemory::index_
+    std::vector<std::int64_t> retainedSizes_{};
+    // managed object addresses in ascending order, and the managedObjects_ index at each of them
+    std::vector<std::uint64_t> sortedAddresses_{};
+    std::vector<std::uint32_t> sortedObjects_{};
 
     Il2CppRuntimeInformation runtimeInformation_;
 
@@ -237,11 +404,37 @@ struct CrawledMemorySnapshot {
     QString name_ = "EmptySnapshot";
 
     static void Unpack(CrawledMemorySnapshot& result, Il2CppManagedMemorySnapshot* snapshot, PackedCrawlerData& packedCrawlerData);
+    static void BuildIndices(CrawledMemorySnapshot* snapshot);
+    static void BuildDominators(CrawledMemorySnapshot* snapshot);
+    // sums size_ up the dominator tree, rerun after sizes change
+    static void BuildRetainedSizes(CrawledMemorySnapshot* snapshot);
+    static bool IsRoot(const ThingInMemory* thing);
+    static void FindPathsToRoot(const CrawledMemorySnapshot* snapshot, const ThingInMemory* thing, std::size_t maxPaths,
+                                std::vector<std::vector<const ThingInMemory*>>& outPaths);
+    static QString FieldName(const CrawledMemorySnapshot* snapshot, std::uint32_t fieldId);
+    // field id of thing->references_[i] and of thing->referencedBy_[i]
+    static std::uint32_t ReferenceField(const CrawledMemorySnapshot* snapshot, const ThingInMemory* thing, std::size_t i);
+    static std::uint32_t ReferencedByField(const CrawledMemorySnapshot* snapshot, const ThingInMemory* thing, std::size_t i);
+    static QString ReferenceName(const CrawledMemorySnapshot* snapshot, const ThingInMemory* from, const ThingInMemory* to);
+    // FieldName of an edge with the element index of a struct array filled in
+    static QString EdgeName(const CrawledMemorySnapshot* snapshot, const ThingInMemory* from, const ThingInMemory* to, std::uint32_t fieldId);
     static BytesAndOffset FindInHeap(const CrawledMemorySnapshot* snapshot, std::uint64_t addr);
+    // managedObjects_ index of the object starting at address (or containing it if allowInterior), kNoManagedObject if none
+    static std::uint32_t FindObjectAt(const CrawledMemorySnapshot* snapshot, std::uint64_t address, bool allowInterior = false);
     static QString ReadString(const CrawledMemorySnapshot* snapshot, const BytesAndOffset& bo);
-    static int ReadArrayLength(const CrawledMemorySnapshot* snapshot, std::uint64_t address, TypeDescription* arrayType);
+    static int ReadArrayLength(const CrawledMemorySnapshot* snapshot, std::uint64_t address, const TypeDescription* arrayType);
+    // static field bytes of the type in this capture, invalid if it has none
+    static BytesAndOffset StaticsOf(const CrawledMemorySnapshot* snapshot, std::uint32_t typeIndex);
+    // length and lower bound of every dimension, a single [length, 0] for szarrays
+    static void ReadArrayBounds(const CrawledMemorySnapshot* snapshot, std::uint64_t address, const TypeDescription* arrayType,
+                                std::vector<int>& outLengths, std::vector<int>& outLowerBounds);
     static void AllFieldsOf(const CrawledMemorySnapshot* snapshot, const TypeDescription* typeDescription,
                             FieldFindOptions options, std::vector<const FieldDescription*>& outFields);
+    // one snapshot of a .uss file, the file header is written by the caller
+    static void WriteSnapshot(QDataStream& stream, const CrawledMemorySnapshot* snapshot, const QString& name);
+    static CrawledMemorySnapshot* ReadSnapshot(QDataStream& stream, quint32 version);
+    // every snapshot of a .uss file, -1 if it isn't one or was written by a newer version
+    static int ReadSnapshotFile(QIODevice* device, std::vector<CrawledMemorySnapshot*>& outSnapshots);
     static CrawledMemorySnapshot* Clone(const CrawledMemorySnapshot* src);
     static CrawledMemorySnapshot* Diff(const CrawledMemorySnapshot* firstSnapshot, const CrawledMemorySnapshot* secondSnapshot);
     static void Free(CrawledMemorySnapshot* snapshot);
@@ -272,6 +465,26 @@ public:
     std::uint64_t ReadPointer(std::uint64_t address) const {
         return ReadPointer(CrawledMemorySnapshot::FindInHeap(snapshot_, address));
     }
+    // display text of a primitive value, empty for kNone and kString
+    QString ReadPrimitiveAsString(PrimitiveKind kind, const BytesAndOffset& bo) const {
+        switch (kind) {
+        case PrimitiveKind::kBoolean: return QString::number(ReadBool(bo));
+        case PrimitiveKind::kSByte: return QString::number(ReadInteger<std::int8_t>(bo));
+        case PrimitiveKind::kByte: return QString::number(ReadInteger<std::uint8_t>(bo));
+        case PrimitiveKind::kInt16: return QString::number(ReadInteger<std::int16_t>(bo));
+        case PrimitiveKind::kChar:
+        case PrimitiveKind::kUInt16: return QString::number(ReadInteger<std::uint16_t>(bo));
+        case PrimitiveKind::kInt32: return QString::number(ReadInteger<std::int32_t>(bo));
+        case PrimitiveKind::kUInt32: return QString::number(ReadInteger<std::uint32_t>(bo));
+        case PrimitiveKind::kInt64: return QString::number(ReadInteger<std::int64_t>(bo));
+        case PrimitiveKind::kUInt64: return QString::number(ReadInteger<std::uint64_t>(bo));
+        case PrimitiveKind::kSingle: return QString::number(static_cast<double>(ReadInteger<float>(bo)));
+        case PrimitiveKind::kDouble: return QString::number(ReadInteger<double>(bo));
+        case PrimitiveKind::kIntPtr:
+        case PrimitiveKind::kUIntPtr: return QString::number(ReadPointer(bo), 16);
+        default: return QString();
+        }
+    }
 private:
     const CrawledMemorySnapshot* snapshot_;
 };
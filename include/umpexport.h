@@ -0,0 +1,33 @@
+#ifndef UMPEXPORT_H
+#define UMPEXPORT_H
+
+#include <QString>
+
+#include <cstdint>
+
+class QIODevice;
+struct CrawledMemorySnapshot;
+
+enum class UMPExportTable {
+    kTypes = 0, // managed instances summed up by type
+    kInstances, // one row per managed object
+};
+
+enum class UMPExportFormat {
+    kCsv = 0,
+    kJsonLines,
+    // "UMPC" little-endian: version, row count and column count as u32, then per column its name (u32 length and
+    // utf-8 bytes), a kind byte (0 u32, 1 u64, 2 i64, 3 string) and its rows back to back. strings are a u32
+    // length and utf-8 bytes. column-major, so a reader can skip a column without parsing it
+    kColumnar,
+};
+
+// "csv", "jsonl" and "umpc", also picks the format for a file name
+QString UMPExportSuffix(UMPExportFormat format);
+UMPExportFormat UMPExportFormatOf(const QString& fileName);
+
+// streams the table straight from the snapshot arrays into the device. diff snapshots get their signed
+// deltas and a diff column. returns 0, or -1 when the device refuses a write
+int UMPExportSnapshot(const CrawledMemorySnapshot* snapshot, UMPExportTable table, UMPExportFormat format, QIODevice* device);
+
+#endif // UMPEXPORT_H
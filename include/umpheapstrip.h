@@ -0,0 +1,39 @@
+#ifndef UMPHEAPSTRIP_H
+#define UMPHEAPSTRIP_H
+
+#include <QWidget>
+
+#include <cstdint>
+
+struct CrawledMemorySnapshot;
+struct UMPFragmentationReport;
+
+// one row per heap section, each cut into kHeatStripCells cells colored from red (free) to green (live),
+// clicking a cell selects the first object in it
+class UMPHeapStripWidget : public QWidget {
+    Q_OBJECT
+public:
+    UMPHeapStripWidget(const CrawledMemorySnapshot* snapshot, const UMPFragmentationReport* report, QWidget *parent = nullptr);
+    QSize sizeHint() const override;
+    void SetCurrentSection(int row);
+
+signals:
+    void ThingSelected(std::uint32_t index);
+
+protected:
+    void paintEvent(QPaintEvent* event) override;
+    void mousePressEvent(QMouseEvent* event) override;
+    void mouseMoveEvent(QMouseEvent* event) override;
+
+private:
+    // false if pos isn't over a cell
+    bool CellAt(const QPoint& pos, int& outRow, int& outCell) const;
+    QRect CellRect(int row, int cell) const;
+
+private:
+    const CrawledMemorySnapshot* snapshot_;
+    const UMPFragmentationReport* report_;
+    int currentRow_ = -1;
+};
+
+#endif // UMPHEAPSTRIP_H
@@ -4,6 +4,7 @@
 #include <QtEndian>
 #include <cstdint>
 #include <cstring>
+#include <vector>
 
 const uint32_t kSnapshotFormatVersion = 4;
 const uint32_t kSnapshotMagicBytes = 0xFABCED01;
@@ -15,6 +16,8 @@ const uint32_t kSnapshotGCHandlesMagicBytes = 0x3456132C;
 // const uint32_t kSnapshotNativeObjectsMagicBytes = 0x6173FAFE;
 const uint32_t kSnapshotRuntimeInfoMagicBytes = 0x0183EFAC;
 const uint32_t kSnapshotTailMagicBytes = 0x865EEAAF;
+// optional, follows the tail so readers that stop at the tail skip it
+const uint32_t kSnapshotTimingsMagicBytes = 0x5D1A7E11;
 
 struct Il2CppMetadataField
 {
@@ -51,6 +54,8 @@ struct Il2CppMetadataSnapshot
 {
     uint32_t typeCount;
     Il2CppMetadataType* types;
+    // every type, assembly and field name back to back, the name pointers point in here
+    char* strings;
 };
 
 struct Il2CppManagedMemorySection
@@ -122,6 +127,8 @@ public:
     bufferreader& operator>> (std::uint64_t& value);
     bufferreader& operator>> (char*& value);
     bufferreader& operator>> (bool& value);
+    // appends a zero terminated string to arena and returns where it starts, no allocation per string
+    std::uint32_t readString(std::vector<char>& arena);
 
 private:
     const char* data_;
@@ -172,6 +179,20 @@ inline bufferreader& bufferreader::operator>> (char*& value) {
     return *this;
 }
 
+inline std::uint32_t bufferreader::readString(std::vector<char>& arena) {
+    auto offset = static_cast<std::uint32_t>(arena.size());
+    std::uint32_t len = 0;
+    *this >> len;
+    if (index_ + len <= size_ && len > 0) {
+        arena.insert(arena.end(), &data_[index_], &data_[index_] + len);
+        index_ += len;
+    }
+    // the writer counts the terminator, a missing one still ends the string
+    if (arena.size() == offset || arena.back() != 0)
+        arena.push_back(0);
+    return offset;
+}
+
 inline bufferreader& bufferreader::operator>> (bool& value) {
     if (index_ + 1 <= size_) {
         value = data_[index_];
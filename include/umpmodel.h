@@ -2,23 +2,41 @@
 #define UMPMODEL_H
 
 #include "umpcrawler.h"
-
+#include "umpanalyzer.h"
+#include "umpquery.h"
 
 #include <QAbstractTableModel>
+#include <QAbstractListModel>
 #include <QSortFilterProxyModel>
 
 #include <QString>
 #include <QVector>
 
+// a contiguous run of UMPTypeGroupModel's grouped objects
+struct UMPThingSpan {
+    ThingInMemory* const* data_ = nullptr;
+    std::size_t size_ = 0;
+    ThingInMemory* const* begin() const { return data_; }
+    ThingInMemory* const* end() const { return data_ + size_; }
+    std::size_t size() const { return size_; }
+    ThingInMemory* operator[](std::size_t i) const { return data_[i]; }
+};
+
 struct UMPSnapshotType {
-    QString name_;
-    TypeDescription* type_;
-    std::vector<ThingInMemory*> objects_;
+    const TypeDescription* type_;
+    std::uint32_t offset_ = 0; // of objects_ in the grouped objects
+    UMPThingSpan objects_;
     std::int64_t size_ = 0;
 };
 
 QString sizeToString(qint64 size);
 
+class UMPTypeGroupModel;
+
+const std::uint32_t kNoGroupPosition = std::numeric_limits<std::uint32_t>::max();
+
+// rows come straight from the type's span, sorting only reorders a permutation of it,
+// so no proxy model is needed in front of this one
 class UMPThingInMemoryModel : public QAbstractTableModel {
 public:
     UMPThingInMemoryModel(QObject* parent);
@@ -26,11 +44,24 @@ public:
     int columnCount(const QModelIndex &parent = QModelIndex()) const override;
     QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
     QVariant headerData(int section, Qt::Orientation orientation, int role) const override;
-    void reset(const UMPSnapshotType& snapshotType, bool isDiff);
-    ThingInMemory* thingAt(int row) const { return objects_[row]; }
+    void sort(int column, Qt::SortOrder order = Qt::AscendingOrder) override;
+    void reset(const UMPTypeGroupModel* typeGroups, int typeRow, bool isDiff);
+    ThingInMemory* thingAt(int row) const {
+        auto i = static_cast<std::size_t>(row);
+        return objects_[order_.empty() ? i : order_[i]];
+    }
     int indexOf(const ThingInMemory* thing) const;
 private:
-    QVector<ThingInMemory*> objects_;
+    void sortObjects();
+private:
+    const UMPTypeGroupModel* typeGroups_ = nullptr;
+    std::uint32_t offset_ = 0;
+    UMPThingSpan objects_;
+    // row -> span index and back, both empty while unsorted
+    std::vector<std::uint32_t> order_;
+    std::vector<std::uint32_t> rows_;
+    int sortColumn_ = -1;
+    Qt::SortOrder sortOrder_ = Qt::AscendingOrder;
     bool isDiff_ = false;
 };
 
@@ -51,12 +82,237 @@ public:
     std::int64_t getTotalSize() const {
         return totalSize_;
     }
+    // position of thing in the grouped objects, kNoGroupPosition for things without a type (gchandles)
+    std::uint32_t groupPositionOf(const ThingInMemory* thing) const {
+        return groupPositions_[thing->index_];
+    }
 private:
-    QVector<UMPSnapshotType> types_;
+    std::vector<UMPSnapshotType> types_;
+    std::vector<ThingInMemory*> groupedObjects_; // statics and managed objects ordered by type index
+    std::vector<std::uint32_t> groupPositions_; // inverse of groupedObjects_, by ThingInMemory::index_
     CrawledMemorySnapshot* snapshot_;
     std::int64_t totalSize_;
 };
 
+// rows are handed to the view a page at a time through fetchMore and decoded in data(),
+// so a list over millions of elements costs nothing until it is scrolled
+class UMPLazyListModel : public QAbstractListModel {
+public:
+    UMPLazyListModel(QObject* parent) : QAbstractListModel(parent) {}
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+    bool canFetchMore(const QModelIndex &parent) const override;
+    void fetchMore(const QModelIndex &parent) override;
+    // total rows, including the ones not fetched yet
+    int totalRowCount() const {
+        return totalRows_;
+    }
+protected:
+    // Qt::UserRole is the ThingInMemory::index_ a row links to
+    virtual QVariant rowData(int row, int role) const = 0;
+    void resetRows(int totalRows);
+private:
+    int totalRows_ = 0;
+    int fetchedRows_ = 0;
+};
+
+// references_ or referencedBy_ of one thing
+class UMPThingLinkModel : public UMPLazyListModel {
+public:
+    enum class Direction {
+        kReferences,
+        kReferrers
+    };
+    UMPThingLinkModel(QObject* parent) : UMPLazyListModel(parent) {}
+    void reset(const CrawledMemorySnapshot* snapshot, const ThingInMemory* thing, Direction direction);
+protected:
+    QVariant rowData(int row, int role) const override;
+private:
+    const CrawledMemorySnapshot* snapshot_ = nullptr;
+    const ThingInMemory* thing_ = nullptr;
+    Direction direction_ = Direction::kReferences;
+};
+
+// the text of a string or the elements of an array, read from the heap row by row
+class UMPObjectValueModel : public UMPLazyListModel {
+public:
+    UMPObjectValueModel(QObject* parent) : UMPLazyListModel(parent) {}
+    ~UMPObjectValueModel() override;
+    void reset(const CrawledMemorySnapshot* snapshot, const ManagedObject* managed);
+protected:
+    QVariant rowData(int row, int role) const override;
+private:
+    QString indexText(int row) const;
+    QString valueText(const TypeDescription* type, const BytesAndOffset& bo, int depth) const;
+private:
+    const CrawledMemorySnapshot* snapshot_ = nullptr;
+    PrimitiveValueReader* reader_ = nullptr;
+    const ManagedObject* managed_ = nullptr;
+    const TypeDescription* elementType_ = nullptr;
+    BytesAndOffset elements_;
+    std::uint32_t elementSize_ = 0;
+    std::vector<int> lengths_;
+    std::vector<int> lowerBounds_;
+};
+
+// a list of managed objects, e.g. the copies in one duplicate group
+class UMPManagedListModel : public UMPLazyListModel {
+public:
+    UMPManagedListModel(QObject* parent) : UMPLazyListModel(parent) {}
+    // objects are managedObjects_ indices and must outlive the model or the next reset
+    void reset(const CrawledMemorySnapshot* snapshot, const std::vector<std::uint32_t>* objects);
+protected:
+    QVariant rowData(int row, int role) const override;
+private:
+    const CrawledMemorySnapshot* snapshot_ = nullptr;
+    const std::vector<std::uint32_t>* objects_ = nullptr;
+};
+
+class UMPDuplicateGroupModel : public QAbstractTableModel {
+public:
+    UMPDuplicateGroupModel(const CrawledMemorySnapshot* snapshot, std::vector<UMPDuplicateGroup> groups, QObject* parent);
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    int columnCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+    QVariant headerData(int section, Qt::Orientation orientation, int role) const override;
+    const UMPDuplicateGroup& groupAt(int row) const {
+        return groups_[static_cast<std::size_t>(row)];
+    }
+    const CrawledMemorySnapshot* getSnapshot() const {
+        return snapshot_;
+    }
+    std::int64_t getWastedSize() const {
+        return wastedSize_;
+    }
+private:
+    QString previewOf(const UMPDuplicateGroup& group) const;
+private:
+    const CrawledMemorySnapshot* snapshot_;
+    std::vector<UMPDuplicateGroup> groups_;
+    std::int64_t wastedSize_ = 0;
+};
+
+class UMPDuplicateTypeModel : public QAbstractTableModel {
+public:
+    UMPDuplicateTypeModel(const CrawledMemorySnapshot* snapshot, std::vector<UMPDuplicateTypeSummary> summaries, QObject* parent);
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    int columnCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+    QVariant headerData(int section, Qt::Orientation orientation, int role) const override;
+    const TypeDescription* typeAt(int row) const {
+        return &snapshot_->typeCatalog_->types_[summaries_[static_cast<std::size_t>(row)].typeIndex_];
+    }
+private:
+    const CrawledMemorySnapshot* snapshot_;
+    std::vector<UMPDuplicateTypeSummary> summaries_;
+};
+
+// assembly -> namespace -> type tree over nodes built once by UMPBuildRollup, expanding never touches objects
+class UMPRollupModel : public QAbstractItemModel {
+public:
+    UMPRollupModel(std::vector<UMPRollupNode> nodes, QObject* parent);
+    QModelIndex index(int row, int column, const QModelIndex &parent = QModelIndex()) const override;
+    QModelIndex parent(const QModelIndex &index) const override;
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    int columnCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+    QVariant headerData(int section, Qt::Orientation orientation, int role) const override;
+    const UMPRollupNode& nodeAt(const QModelIndex &index) const {
+        return nodes_[index.isValid() ? static_cast<std::size_t>(index.internalId()) : 0];
+    }
+    const UMPRollupNode& getTotals() const {
+        return nodes_[0];
+    }
+private:
+    std::vector<UMPRollupNode> nodes_;
+    std::vector<int> rows_; // position of every node in its parent's children
+};
+
+// one row per heap section of a fragmentation report, the other views of the report borrow it from here
+class UMPHeapSectionModel : public QAbstractTableModel {
+public:
+    UMPHeapSectionModel(UMPFragmentationReport report, QObject* parent);
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    int columnCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+    QVariant headerData(int section, Qt::Orientation orientation, int role) const override;
+    const UMPFragmentationReport& getReport() const {
+        return report_;
+    }
+private:
+    UMPFragmentationReport report_;
+};
+
+// non-empty hole size buckets of a fragmentation report
+class UMPHoleHistogramModel : public QAbstractTableModel {
+public:
+    UMPHoleHistogramModel(const UMPFragmentationReport* report, QObject* parent);
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    int columnCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+    QVariant headerData(int section, Qt::Orientation orientation, int role) const override;
+private:
+    const UMPFragmentationReport* report_;
+    std::vector<std::uint32_t> buckets_;
+};
+
+// unreachable bytes per type found by UMPWalkHeap
+class UMPUnreachableTypeModel : public QAbstractTableModel {
+public:
+    UMPUnreachableTypeModel(const CrawledMemorySnapshot* snapshot, UMPHeapWalkReport report, QObject* parent);
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    int columnCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+    QVariant headerData(int section, Qt::Orientation orientation, int role) const override;
+    const UMPHeapWalkReport& getReport() const {
+        return report_;
+    }
+private:
+    const CrawledMemorySnapshot* snapshot_;
+    UMPHeapWalkReport report_;
+};
+
+// roots ranked by UMPBuildRootReport, a gchandle row also shows the object it points at
+class UMPRootModel : public QAbstractTableModel {
+public:
+    UMPRootModel(const CrawledMemorySnapshot* snapshot, UMPRootReport report, QObject* parent);
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    int columnCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+    QVariant headerData(int section, Qt::Orientation orientation, int role) const override;
+    // the handle's target for gchandles, the root itself otherwise
+    std::uint32_t thingToShow(int row) const;
+    const UMPRootReport& getReport() const {
+        return report_;
+    }
+private:
+    const CrawledMemorySnapshot* snapshot_;
+    UMPRootReport report_;
+    std::uint32_t firstManaged_;
+};
+
+// one row per query group, or a single "All" row when the query wasn't grouped
+class UMPQueryGroupModel : public QAbstractTableModel {
+public:
+    UMPQueryGroupModel(const CrawledMemorySnapshot* snapshot, UMPQueryResult result, QObject* parent);
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    int columnCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+    QVariant headerData(int section, Qt::Orientation orientation, int role) const override;
+    const UMPQueryGroup& groupAt(int row) const {
+        return result_.groups_[static_cast<std::size_t>(row)];
+    }
+    const CrawledMemorySnapshot* getSnapshot() const {
+        return snapshot_;
+    }
+    const UMPQueryResult& getResult() const {
+        return result_;
+    }
+private:
+    const CrawledMemorySnapshot* snapshot_;
+    UMPQueryResult result_;
+};
+
 class UMPTableProxyModel : public QSortFilterProxyModel {
 public:
     UMPTableProxyModel(QAbstractItemModel* srcModel, QObject *parent = nullptr)
@@ -74,4 +330,26 @@ protected:
     }
 };
 
+// duplicate groups narrowed to one type, by type index rather than by the preview text
+class UMPDuplicateGroupProxyModel : public UMPTableProxyModel {
+public:
+    UMPDuplicateGroupProxyModel(UMPDuplicateGroupModel* srcModel, QObject *parent = nullptr)
+        : UMPTableProxyModel(srcModel, parent), groupModel_(srcModel) {}
+    // nullptr shows every group
+    void setTypeFilter(const TypeDescription* type) {
+        type_ = type;
+        invalidateFilter();
+    }
+protected:
+    bool filterAcceptsRow(int sourceRow, const QModelIndex &) const override {
+        if (type_ == nullptr)
+            return true;
+        auto& group = groupModel_->groupAt(sourceRow);
+        return groupModel_->getSnapshot()->managedObjects_[group.objects_[0]].typeDescription_->typeIndex_ == type_->typeIndex_;
+    }
+private:
+    UMPDuplicateGroupModel* groupModel_;
+    const TypeDescription* type_ = nullptr;
+};
+
 #endif // UMPMODEL_H
@@ -0,0 +1,86 @@
+#ifndef UMPPARALLEL_H
+#define UMPPARALLEL_H
+
+#include <algorithm>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+// below this many items per chunk spawning threads costs more than it saves
+const std::size_t kMinParallelChunkSize = 16 * 1024;
+
+inline std::size_t UMPThreadCount() {
+    auto count = static_cast<std::size_t>(std::thread::hardware_concurrency());
+    return count == 0 ? 1 : count;
+}
+
+inline std::size_t UMPChunkCount(std::size_t itemCount) {
+    auto chunks = (itemCount + kMinParallelChunkSize - 1) / kMinParallelChunkSize;
+    return std::max<std::size_t>(1, std::min(chunks, UMPThreadCount()));
+}
+
+// split [0, itemCount) into chunkCount contiguous ranges and run func(chunk, begin, end) for each,
+// chunk 0 runs on the calling thread
+template<typename Func>
+void UMPParallelChunks(std::size_t itemCount, std::size_t chunkCount, Func func) {
+    if (chunkCount <= 1) {
+        func(static_cast<std::size_t>(0), static_cast<std::size_t>(0), itemCount);
+        return;
+    }
+    auto chunkSize = (itemCount + chunkCount - 1) / chunkCount;
+    std::vector<std::thread> threads;
+    threads.reserve(chunkCount - 1);
+    for (std::size_t chunk = 1; chunk < chunkCount; chunk++) {
+        auto begin = std::min(itemCount, chunk * chunkSize);
+        auto end = std::min(itemCount, begin + chunkSize);
+        threads.push_back(std::thread(func, chunk, begin, end));
+    }
+    func(static_cast<std::size_t>(0), static_cast<std::size_t>(0), std::min(itemCount, chunkSize));
+    for (auto& thread : threads)
+        thread.join();
+}
+
+template<typename Func>
+void UMPParallelChunks(std::size_t itemCount, Func func) {
+    UMPParallelChunks(itemCount, UMPChunkCount(itemCount), func);
+}
+
+// sort chunks in parallel, then merge neighbouring runs pairwise until one is left
+template<typename T, typename Compare>
+void UMPParallelSort(std::vector<T>& items, Compare comp) {
+    auto itemCount = items.size();
+    auto chunkCount = UMPChunkCount(itemCount);
+    if (chunkCount <= 1) {
+        std::sort(items.begin(), items.end(), comp);
+        return;
+    }
+    UMPParallelChunks(itemCount, chunkCount, [&](std::size_t, std::size_t begin, std::size_t end) {
+        std::sort(items.begin() + static_cast<std::ptrdiff_t>(begin), items.begin() + static_cast<std::ptrdiff_t>(end), comp);
+    });
+    // same split as UMPParallelChunks
+    auto chunkSize = (itemCount + chunkCount - 1) / chunkCount;
+    std::vector<std::size_t> bounds;
+    for (std::size_t chunk = 0; chunk < chunkCount; chunk++)
+        bounds.push_back(std::min(itemCount, chunk * chunkSize));
+    bounds.push_back(itemCount);
+    while (bounds.size() > 2) {
+        auto runCount = bounds.size() - 1;
+        std::vector<std::thread> threads;
+        for (std::size_t run = 0; run + 1 < runCount; run += 2) {
+            auto first = items.begin() + static_cast<std::ptrdiff_t>(bounds[run]);
+            auto middle = items.begin() + static_cast<std::ptrdiff_t>(bounds[run + 1]);
+            auto last = items.begin() + static_cast<std::ptrdiff_t>(bounds[run + 2]);
+            threads.push_back(std::thread([=]() { std::inplace_merge(first, middle, last, comp); }));
+        }
+        for (auto& thread : threads)
+            thread.join();
+        std::vector<std::size_t> merged;
+        for (std::size_t i = 0; i < bounds.size(); i += 2)
+            merged.push_back(bounds[i]);
+        if (runCount % 2 == 1)
+            merged.push_back(itemCount);
+        bounds.swap(merged);
+    }
+}
+
+#endif // UMPPARALLEL_H
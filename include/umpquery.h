@@ -0,0 +1,40 @@
+#ifndef UMPQUERY_H
+#define UMPQUERY_H
+
+#include <QString>
+
+#include <cstdint>
+#include <vector>
+
+struct CrawledMemorySnapshot;
+
+enum class UMPQueryGroupBy {
+    kNone,
+    kType,
+    kAssembly
+};
+
+struct UMPQueryGroup {
+    QString key_;
+    std::vector<std::uint32_t> objects_; // managedObjects_ indices
+    std::int64_t size_ = 0;
+};
+
+struct UMPQueryResult {
+    UMPQueryGroupBy groupBy_ = UMPQueryGroupBy::kNone;
+    std::vector<UMPQueryGroup> groups_; // biggest first
+    std::size_t matchCount_ = 0;
+    std::int64_t matchSize_ = 0;
+};
+
+// filters the managed objects of a snapshot, e.g. `type ~ "Texture*" and size > 1MB and refcount == 0 group by assembly`
+//   type, assembly                       == != ~ (~ takes * and ? wildcards)
+//   size, refcount, refs, address        == != < <= > >=
+// numbers take B/KB/MB/GB suffixes or a 0x prefix, terms combine with and/or/not and parentheses,
+// and an optional trailing `group by type|assembly` buckets the matches.
+// string predicates are resolved once per type and numeric ones run as tight loops over columns
+// copied out of the snapshot, on all cores.
+// returns false with outError set if the query doesn't parse
+bool UMPRunQuery(const CrawledMemorySnapshot* snapshot, const QString& query, UMPQueryResult& outResult, QString& outError);
+
+#endif // UMPQUERY_H
@@ -0,0 +1,59 @@
+#ifndef UMPSTRINGPOOL_H
+#define UMPSTRINGPOOL_H
+
+#include <QString>
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+const std::uint64_t kFnvOffsetBasis = 0xCBF29CE484222325ULL;
+const std::uint64_t kFnvPrime = 0x100000001B3ULL;
+
+// FNV-1a, stable across runs unlike qHash
+inline std::uint64_t UMPHashBytes(const void* data, std::size_t size, std::uint64_t hash = kFnvOffsetBasis) {
+    auto bytes = static_cast<const std::uint8_t*>(data);
+    for (std::size_t i = 0; i < size; i++) {
+        hash ^= bytes[i];
+        hash *= kFnvPrime;
+    }
+    return hash;
+}
+
+// utf-8 strings stored once each in one growing block, a string's id is where it starts in the block.
+// every entry is a u32 length, the bytes and a zero, id 0 is the empty string
+class UMPStringPool {
+public:
+    UMPStringPool();
+
+    // id of the string, added if it isn't in the pool yet
+    std::uint32_t Add(const char* text, std::uint32_t length);
+    std::uint32_t Add(const char* text) { return Add(text, static_cast<std::uint32_t>(strlen(text))); }
+    std::uint32_t Add(const QString& text);
+
+    // zero terminated
+    const char* Data(std::uint32_t id) const { return bytes_.data() + id + sizeof(std::uint32_t); }
+    std::uint32_t Length(std::uint32_t id) const {
+        std::uint32_t length;
+        memcpy(&length, bytes_.data() + id, sizeof(length));
+        return length;
+    }
+    // a QString is only made for display, compare and hash by id or Data where possible
+    QString String(std::uint32_t id) const { return QString::fromUtf8(Data(id), static_cast<int>(Length(id))); }
+
+    std::size_t Count() const { return count_; }
+    std::size_t ByteSize() const { return bytes_.size(); }
+    // the same strings added in the same order give the same block and the same ids
+    std::uint64_t Hash() const { return UMPHashBytes(bytes_.data(), bytes_.size()); }
+    bool operator==(const UMPStringPool& other) const { return bytes_ == other.bytes_; }
+
+private:
+    void Rehash(std::size_t slotCount);
+
+    std::vector<char> bytes_;
+    // open addressing on the string hash, id + 1 per slot and 0 for a free one
+    std::vector<std::uint32_t> slots_;
+    std::size_t count_ = 0;
+};
+
+#endif // UMPSTRINGPOOL_H
@@ -0,0 +1,63 @@
+#ifndef UMPTRACE_H
+#define UMPTRACE_H
+
+#include <QByteArray>
+#include <QString>
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+enum class UMPTraceProcess : std::uint32_t {
+    HOST = 1,
+    AGENT = 2, // the plugin inside the app, its stages come with the snapshot
+};
+
+// a stage of a capture, times in microseconds since the capture began
+struct UMPTraceEvent {
+    QString name_;
+    UMPTraceProcess process_ = UMPTraceProcess::HOST;
+    std::uint32_t thread_ = 0;
+    std::uint32_t depth_ = 0; // scopes open around it on its thread
+    std::int64_t start_ = 0;
+    std::int64_t duration_ = 0;
+    std::vector<std::pair<QString, std::uint64_t>> counters_;
+};
+
+struct UMPTrace {
+    QString name_;
+    std::vector<UMPTraceEvent> events_;
+};
+
+// collects the stages of one capture between BeginCapture and EndCapture, outside of that a scoped timer
+// costs an atomic load
+class UMPTraceRecorder {
+public:
+    static void BeginCapture(const QString& name);
+    static UMPTrace EndCapture();
+    static bool IsCapturing();
+    static std::int64_t Now();
+    static std::uint32_t CurrentThread();
+    static void Add(UMPTraceEvent&& event);
+};
+
+class UMPScopedTimer {
+public:
+    explicit UMPScopedTimer(const char* name);
+    ~UMPScopedTimer();
+    UMPScopedTimer(const UMPScopedTimer&) = delete;
+    UMPScopedTimer& operator=(const UMPScopedTimer&) = delete;
+
+    void AddCounter(const char* name, std::uint64_t value);
+
+private:
+    UMPTraceEvent event_;
+    bool recording_;
+};
+
+// chrome://tracing and Perfetto json, one process for the host and one for the agent
+QByteArray UMPTraceToChromeJson(const UMPTrace& trace);
+// top level stages on one line, "wait 1200 ms, agent capture 300 ms (40.0 MB), receive 800 ms (45.0 MB), ..."
+QString UMPTraceSummary(const UMPTrace& trace);
+
+#endif // UMPTRACE_H
@@ -0,0 +1,76 @@
+#ifndef UMPTREEMAP_H
+#define UMPTREEMAP_H
+
+#include <QWidget>
+#include <QFutureWatcher>
+#include <QRectF>
+#include <QMap>
+
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+class UMPTypeGroupModel;
+
+struct UMPTreemapItem {
+    std::int64_t size_;
+    std::uint32_t id_;
+};
+
+// id_ of the rect holding everything past the largest items
+const std::uint32_t kTreemapOther = std::numeric_limits<std::uint32_t>::max();
+
+struct UMPTreemapRect {
+    QRectF rect_;
+    std::int64_t size_;
+    std::uint32_t id_;
+};
+
+// squarified layout (Bruls, Huizing & van Wijk) of items plus a kTreemapOther rect when otherSize is positive,
+// items with no positive size are left out
+void UMPSquarify(std::vector<UMPTreemapItem> items, std::int64_t otherSize, const QRectF& bounds, std::vector<UMPTreemapRect>& outRects);
+
+// types sized by their objects, double click zooms into the instances of a type and backspace or
+// a right click zooms back out. layouts are computed on the thread pool for the current zoom level
+// only and kept until the widget is resized, the last one is stretched over the widget meanwhile
+class UMPTreemapWidget : public QWidget {
+    Q_OBJECT
+public:
+    explicit UMPTreemapWidget(const UMPTypeGroupModel* typeGroups, QWidget *parent = nullptr);
+    ~UMPTreemapWidget() override;
+
+signals:
+    void TypeSelected(std::uint32_t typeIndex);
+    void ThingSelected(std::uint32_t index);
+
+protected:
+    void paintEvent(QPaintEvent* event) override;
+    void resizeEvent(QResizeEvent* event) override;
+    void mousePressEvent(QMouseEvent* event) override;
+    void mouseDoubleClickEvent(QMouseEvent* event) override;
+    void mouseMoveEvent(QMouseEvent* event) override;
+    void keyPressEvent(QKeyEvent* event) override;
+
+private:
+    void ZoomTo(std::uint32_t typeIndex);
+    void RequestLayout();
+    void StartLayout();
+    void OnLayoutFinished();
+    const UMPTreemapRect* RectAt(const QPointF& pos) const;
+    QString CaptionOf(const UMPTreemapRect& rect) const;
+
+private:
+    const UMPTypeGroupModel* typeGroups_;
+    std::uint32_t zoomType_ = kTreemapOther; // kTreemapOther shows every type
+    std::vector<UMPTreemapRect> rects_;
+    QRectF rectsBounds_; // widget rect rects_ were laid out for
+    QMap<std::uint32_t, std::vector<UMPTreemapRect>> layouts_; // by zoom level, for rectsBounds_
+    QFutureWatcher<std::vector<UMPTreemapRect>> watcher_;
+    std::uint64_t generation_ = 0; // of the newest layout request
+    std::uint64_t runningGeneration_ = 0; // of the layout watcher_ waits for
+    std::uint32_t runningZoom_ = kTreemapOther;
+    std::uint32_t selected_ = kTreemapOther;
+    std::uint32_t hovered_ = kTreemapOther;
+};
+
+#endif // UMPTREEMAP_H
@@ -1,3 +1,4 @@
+#include <atomic>
 #include <iomanip>
 #include <thread>
 #include <chrono>
@@ -30,12 +31,31 @@ void (*umpFreeCapturedMemorySnapshot_)(Il2CppManagedMemorySnapshot*);
 ALooper* mainThreadLooper_;
 int messagePipe_[2];
 io::buffer buffer((size_t)0, 256 * 1024 * 1024);
+std::atomic<std::int64_t> requestTime_ {0};
+
+// a stage of a capture, in microseconds since the request arrived
+struct umpStageTiming {
+    const char* name;
+    std::uint64_t start;
+    std::uint64_t duration;
+    std::uint64_t bytes;
+};
+
+std::int64_t umpNowMicroseconds() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
 
 int umpMainThreadLooperCallback(int fd, int, void*) {
     char msg;
     read(fd, &msg, 1);
     if (umpCaptureMemorySnapshot_ != nullptr && umpFreeCapturedMemorySnapshot_ != nullptr) {
+        auto requested = requestTime_.load();
+        auto captureBegin = umpNowMicroseconds();
         auto snapshot = umpCaptureMemorySnapshot_();
+        auto captured = umpNowMicroseconds();
+        std::uint64_t heapBytes = 0;
+        for (std::uint32_t i = 0; i < snapshot->heap.sectionCount; i++)
+            heapBytes += snapshot->heap.sections[i].sectionSize;
         UMPLOGI("Snapshot! heaps: %i, stacks: %i, types: %i, gcHandles: %i, %u", 
             snapshot->heap.sectionCount, snapshot->stacks.stackCount, snapshot->metadata.typeCount, snapshot->gcHandles.trackedObjectCount, kSnapshotMagicBytes);
         io::bufferwriter writer(buffer);
@@ -50,7 +70,7 @@ int umpMainThreadLooperCallback(int fd, int, void*) {
         for (std::uint32_t i = 0; i < snapshot->stacks.stackCount; i++) {
             auto& stack = snapshot->stacks.stacks[i];
             writer << stack.sectionStartAddress << stack.sectionSize;
-            writer.append(&stack.sectionBytes, stack.sectionSize);
+            writer.append(stack.sectionBytes, stack.sectionSize);
         }
         writer << kSnapshotMetadataMagicBytes << snapshot->metadata.typeCount;
         for (std::uint32_t i = 0; i < snapshot->metadata.typeCount; i++) {
@@ -76,6 +96,15 @@ int umpMainThreadLooperCallback(int fd, int, void*) {
                 snapshot->runtimeInformation.arrayHeaderSize << snapshot->runtimeInformation.arrayBoundsOffsetInHeader << 
                 snapshot->runtimeInformation.arraySizeOffsetInHeader << snapshot->runtimeInformation.allocationGranularity;
         writer << kSnapshotTailMagicBytes;
+        auto serialized = umpNowMicroseconds();
+        umpStageTiming timings[] = {
+            { "queue", 0, static_cast<std::uint64_t>(captureBegin - requested), 0 },
+            { "capture", static_cast<std::uint64_t>(captureBegin - requested), static_cast<std::uint64_t>(captured - captureBegin), heapBytes },
+            { "serialize", static_cast<std::uint64_t>(captured - requested), static_cast<std::uint64_t>(serialized - captured), static_cast<std::uint64_t>(buffer.size()) },
+        };
+        writer << kSnapshotTimingsMagicBytes << static_cast<std::uint32_t>(sizeof(timings) / sizeof(timings[0]));
+        for (auto& timing : timings)
+            writer << timing.name << timing.start << timing.duration << timing.bytes;
         umpSend(buffer.data(), buffer.size()); // blocking
         buffer.clear();
         umpFreeCapturedMemorySnapshot_(snapshot);
@@ -87,6 +116,7 @@ void umpOnRecvMessage(unsigned int type, const char* data, unsigned int size) {
     (void)data;
     (void)size;
     if (type == UMPMessageType::CAPTURE_SNAPSHOT) {
+        requestTime_ = umpNowMicroseconds();
         char empty = 255;
         write(messagePipe_[1], &empty, 1);
     }
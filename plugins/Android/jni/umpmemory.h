@@ -11,6 +11,8 @@ const uint32_t kSnapshotGCHandlesMagicBytes = 0x3456132C;
 // const uint32_t kSnapshotNativeObjectsMagicBytes = 0x6173FAFE;
 const uint32_t kSnapshotRuntimeInfoMagicBytes = 0x0183EFAC;
 const uint32_t kSnapshotTailMagicBytes = 0x865EEAAF;
+// optional, follows the tail so readers that stop at the tail skip it
+const uint32_t kSnapshotTimingsMagicBytes = 0x5D1A7E11;
 
 struct Il2CppMetadataField
 {
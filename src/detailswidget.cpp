@@ -11,15 +11,22 @@
 
 DetailsWidget::DetailsWidget(CrawledMemorySnapshot* snapshot, QWidget *parent) :
     QWidget(parent), ui(new Ui::DetailsWidget),
-    snapshot_(snapshot), primitiveValueReader_(new PrimitiveValueReader(snapshot)) {
+    snapshot_(snapshot), primitiveValueReader_(new PrimitiveValueReader(snapshot)),
+    valueModel_(new UMPObjectValueModel(this)), refsModel_(new UMPThingLinkModel(this)), refbysModel_(new UMPThingLinkModel(this)) {
     ui->setupUi(this);
+    ui->valueListView->setModel(valueModel_);
+    ui->refsListView->setModel(refsModel_);
+    ui->refbysListView->setModel(refbysModel_);
     ShowThing(nullptr, ThingType::NONE);
     connect(ui->fieldsWidget, &QListWidget::itemDoubleClicked, this, &DetailsWidget::OnListItemDoubleClicked);
-    connect(ui->refsListWidget, &QListWidget::itemDoubleClicked, this, &DetailsWidget::OnListItemDoubleClicked);
-    connect(ui->refbysListWidget, &QListWidget::itemDoubleClicked, this, &DetailsWidget::OnListItemDoubleClicked);
+    connect(ui->valueListView, &QListView::doubleClicked, this, &DetailsWidget::OnListIndexDoubleClicked);
+    connect(ui->refsListView, &QListView::doubleClicked, this, &DetailsWidget::OnListIndexDoubleClicked);
+    connect(ui->refbysListView, &QListView::doubleClicked, this, &DetailsWidget::OnListIndexDoubleClicked);
+    connect(ui->pathsListWidget, &QListWidget::itemDoubleClicked, this, &DetailsWidget::OnListItemDoubleClicked);
 }
 
 DetailsWidget::~DetailsWidget() {
+    delete primitiveValueReader_;
     delete ui;
 }
 
@@ -27,85 +34,78 @@ void DetailsWidget::ShowThing(ThingInMemory* thing, ThingType type) {
     if (type == ThingType::MANAGED) {
         auto managedObj = static_cast<ManagedObject*>(thing);
         auto managedType = managedObj->typeDescription_;
-        ui->managedType->setText(managedType->name_);
+        ui->managedType->setText(snapshot_->typeCatalog_->TypeName(*managedType));
         ui->managedAddr->setText(QString("%1").arg(managedObj->address_, 0, 16));
         ui->managedSize->setText(sizeToString(managedObj->size_));
-        ui->valueListWidget->clear();
-        if (managedType->name_ == "System.String") {
-            ui->valueListWidget->addItem(
-                        CrawledMemorySnapshot::ReadString(
-                            snapshot_, CrawledMemorySnapshot::FindInHeap(snapshot_, managedObj->address_)));
-        } else if (managedType->IsArray()) {
-            int elementCount = CrawledMemorySnapshot::ReadArrayLength(snapshot_, managedObj->address_, managedType);
-            int rank = managedType->ArrayRank();
-            if (rank != 1) {
-                ui->valueListWidget->addItem("Can't display multi-dimension arrays yet.");
-            } else if (snapshot_->typeDescriptions_[managedType->baseOrElementTypeIndex_].IsValueType()) {
-                ui->valueListWidget->addItem("Can't display valueType arrays yet.");
-            } else {
-                std::vector<std::uint64_t> pointers;
-                for (int i = 0; i < elementCount; i++) {
-                    pointers.push_back(
-                                primitiveValueReader_->ReadPointer(
-                                    managedObj->address_ + static_cast<std::uint64_t>(snapshot_->runtimeInformation_.arrayHeaderSize) +
-                                    static_cast<std::uint64_t>(static_cast<std::uint32_t>(i) * snapshot_->runtimeInformation_.pointerSize)));
-                }
-                DrawLinks(ui->valueListWidget, pointers);
-            }
-        }
-        ui->valueListWidget->setVisible(ui->valueListWidget->count() > 0);
-        ui->valuesLabel->setVisible(ui->valueListWidget->isVisible());
-        SizeToContent(ui->valueListWidget);
+        valueModel_->reset(snapshot_, managedObj);
+        ui->valueListView->setVisible(valueModel_->totalRowCount() > 0);
+        ui->valuesLabel->setVisible(ui->valueListView->isVisible());
+        ui->valuesLabel->setText(managedType->IsArray() ? QString("Values (%1):").arg(valueModel_->totalRowCount()) : QString("Values:"));
+        SizeToContent(ui->valueListView);
         ui->fieldsWidget->clear();
         DrawFields(ui->fieldsWidget, managedObj);
         ui->fieldsWidget->setVisible(ui->fieldsWidget->count() > 0);
         ui->fieldsLabel->setVisible(ui->fieldsWidget->isVisible());
         SizeToContent(ui->fieldsWidget);
-        ui->refbysListWidget->clear();
-        DrawLinks(ui->refbysListWidget, managedObj->referencedBy_);
-        ui->refbysListWidget->setVisible(ui->refbysListWidget->count() > 0);
-        ui->refbysLabel->setVisible(ui->refbysListWidget->isVisible());
-        SizeToContent(ui->refbysListWidget);
+        refbysModel_->reset(snapshot_, managedObj, UMPThingLinkModel::Direction::kReferrers);
+        ui->refbysListView->setVisible(refbysModel_->totalRowCount() > 0);
+        ui->refbysLabel->setVisible(ui->refbysListView->isVisible());
+        SizeToContent(ui->refbysListView);
+        ui->pathsListWidget->clear();
+        DrawPaths(ui->pathsListWidget, managedObj);
+        ui->pathsListWidget->setVisible(ui->pathsListWidget->count() > 0);
+        ui->pathsLabel->setVisible(ui->pathsListWidget->isVisible());
+        SizeToContent(ui->pathsListWidget);
+        refsModel_->reset(snapshot_, nullptr, UMPThingLinkModel::Direction::kReferences);
         ui->refsLabel->setVisible(false);
-        ui->refsListWidget->setVisible(false);
+        ui->refsListView->setVisible(false);
         ui->stackedWidget->setCurrentIndex(1);
         return;
-    } else if (type == ThingType::STATIC) {
-        auto staticObj = static_cast<StaticFields*>(thing);
-        ui->staticsType->setText(staticObj->typeDescription_->name_);
-        ui->staticsSize->setText(sizeToString(staticObj->size_));
+    } else if (type == ThingType::STATIC || type == ThingType::STATIC_FIELD) {
+        // a static field root shares the statics page, with its references instead of the type's fields
+        ui->staticsSize->setText(sizeToString(thing->size_));
         ui->fieldsWidget->clear();
-        BytesAndOffset bo;
-        bo.bytes_ = staticObj->typeDescription_->statics_;
-        bo.offset_ = 0;
-        bo.pointerSize_ = snapshot_->runtimeInformation_.pointerSize;
-        DrawFields(ui->fieldsWidget, staticObj->typeDescription_, bo, true);
+        if (type == ThingType::STATIC) {
+            auto typeDescription = static_cast<StaticFields*>(thing)->typeDescription_;
+            ui->staticsType->setText(snapshot_->typeCatalog_->TypeName(*typeDescription));
+            auto bo = CrawledMemorySnapshot::StaticsOf(snapshot_, typeDescription->typeIndex_);
+            if (bo.IsValid())
+                DrawFields(ui->fieldsWidget, typeDescription, bo, true);
+        } else {
+            ui->staticsType->setText(thing->caption_);
+        }
         ui->fieldsWidget->setVisible(ui->fieldsWidget->count() > 0);
         ui->fieldsLabel->setVisible(ui->fieldsWidget->isVisible());
         SizeToContent(ui->fieldsWidget);
-        ui->refbysListWidget->clear();
-        DrawLinks(ui->refbysListWidget, staticObj->referencedBy_);
-        ui->refbysListWidget->setVisible(ui->refbysListWidget->count() > 0);
-        ui->refbysLabel->setVisible(ui->refbysListWidget->isVisible());
-        SizeToContent(ui->refbysListWidget);
-        ui->refsListWidget->clear();
-        DrawLinks(ui->refsListWidget, staticObj->references_);
-        ui->refsListWidget->setVisible(ui->refsListWidget->count() > 0);
-        ui->refsLabel->setVisible(ui->refsListWidget->isVisible());
-        SizeToContent(ui->refsListWidget);
+        refbysModel_->reset(snapshot_, thing, UMPThingLinkModel::Direction::kReferrers);
+        ui->refbysListView->setVisible(refbysModel_->totalRowCount() > 0);
+        ui->refbysLabel->setVisible(ui->refbysListView->isVisible());
+        SizeToContent(ui->refbysListView);
+        refsModel_->reset(snapshot_, thing, UMPThingLinkModel::Direction::kReferences);
+        ui->refsListView->setVisible(refsModel_->totalRowCount() > 0);
+        ui->refsLabel->setVisible(ui->refsListView->isVisible());
+        SizeToContent(ui->refsListView);
         ui->stackedWidget->setCurrentIndex(2);
-        ui->valueListWidget->setVisible(false);
+        valueModel_->reset(snapshot_, nullptr);
+        ui->valueListView->setVisible(false);
         ui->valuesLabel->setVisible(false);
+        ui->pathsListWidget->setVisible(false);
+        ui->pathsLabel->setVisible(false);
         return;
     }
     ui->fieldsWidget->setVisible(false);
     ui->fieldsLabel->setVisible(false);
-    ui->valueListWidget->setVisible(false);
+    valueModel_->reset(snapshot_, nullptr);
+    refsModel_->reset(snapshot_, nullptr, UMPThingLinkModel::Direction::kReferences);
+    refbysModel_->reset(snapshot_, nullptr, UMPThingLinkModel::Direction::kReferrers);
+    ui->valueListView->setVisible(false);
     ui->valuesLabel->setVisible(false);
-    ui->refbysListWidget->setVisible(false);
+    ui->refbysListView->setVisible(false);
     ui->refbysLabel->setVisible(false);
     ui->refsLabel->setVisible(false);
-    ui->refsListWidget->setVisible(false);
+    ui->refsListView->setVisible(false);
+    ui->pathsListWidget->setVisible(false);
+    ui->pathsLabel->setVisible(false);
     ui->stackedWidget->setCurrentIndex(0);
 }
 
@@ -117,17 +117,21 @@ void DetailsWidget::OnListItemDoubleClicked(QListWidgetItem *item) {
         emit ThingSelected(index);
 }
 
-void DetailsWidget::SizeToContent(QListWidget* widget) {
-    auto extra = widget->horizontalScrollBar()->isVisible() ? widget->horizontalScrollBar()->height() : 0;
-    widget->setMinimumHeight(std::min(widget->sizeHintForRow(0) * widget->model()->rowCount() + extra + 10, 200));
-    widget->updateGeometry();
+void DetailsWidget::OnListIndexDoubleClicked(const QModelIndex &index) {
+    auto data = index.data(Qt::UserRole);
+    if (!data.isValid())
+        return;
+    auto thingIndex = data.toUInt();
+    if (thingIndex != std::numeric_limits<std::uint32_t>::max())
+        emit ThingSelected(thingIndex);
 }
 
-void DetailsWidget::DrawLinks(QListWidget* widget, const std::vector<std::uint64_t>& pointers) {
-    std::vector<ThingInMemory*> things(pointers.size());
-    for (std::size_t i = 0; i < pointers.size(); i++)
-        things[i] = GetThingAt(pointers[i]);
-    DrawLinks(widget, things);
+void DetailsWidget::SizeToContent(QAbstractItemView* view) {
+    auto extra = view->horizontalScrollBar()->isVisible() ? view->horizontalScrollBar()->height() : 0;
+    // only the first page is fetched, and the height is capped long before that
+    auto rows = std::min(view->model()->rowCount(), 100);
+    view->setMinimumHeight(std::min(view->sizeHintForRow(0) * rows + extra + 10, 200));
+    view->updateGeometry();
 }
 
 void DetailsWidget::DrawLinks(QListWidget* widget, const std::vector<ThingInMemory*> things) {
@@ -136,7 +140,7 @@ void DetailsWidget::DrawLinks(QListWidget* widget, const std::vector<ThingInMemo
         std::uint64_t addr = 0;
         if (thing && thing->type() == ThingType::MANAGED) {
             auto managed = static_cast<ManagedObject*>(thing);
-            if (managed != nullptr && managed->typeDescription_->name_ == "System.String")
+            if (managed != nullptr && managed->typeDescription_->primitiveKind_ == PrimitiveKind::kString)
                 caption = CrawledMemorySnapshot::ReadString(snapshot_, CrawledMemorySnapshot::FindInHeap(snapshot_, managed->address_));
             addr = managed->address_;
         }
@@ -148,20 +152,53 @@ void DetailsWidget::DrawLinks(QListWidget* widget, const std::vector<ThingInMemo
 }
 
 ThingInMemory* DetailsWidget::GetThingAt(std::uint64_t address) {
-    if (managedObjCache_.find(address) == managedObjCache_.end()) {
-        ThingInMemory* thing = nullptr;
-        for (auto& managed : snapshot_->managedObjects_) {
-            if (managed.address_ == address) {
-                thing = &managed;
-                break;
-            }
+    auto index = CrawledMemorySnapshot::FindObjectAt(snapshot_, address);
+    if (index == kNoManagedObject)
+        return nullptr;
+    return &snapshot_->managedObjects_[index];
+}
+
+QString DetailsWidget::PathCaptionOf(const ThingInMemory* thing) const {
+    if (thing->type() == ThingType::STATIC)
+        return snapshot_->typeCatalog_->TypeName(*static_cast<const StaticFields*>(thing)->typeDescription_);
+    return thing->caption_;
+}
+
+// "Foo.m_cache[123] -> Bar", arrays in the middle of a path are folded into their element index
+QString DetailsWidget::PathText(const std::vector<const ThingInMemory*>& path) const {
+    if (path.empty())
+        return QString();
+    auto text = PathCaptionOf(path[0]);
+    for (std::size_t j = 0; j + 1 < path.size(); j++) {
+        auto next = path[j + 1];
+        text += CrawledMemorySnapshot::ReferenceName(snapshot_, path[j], next);
+        bool foldArray = next->type() == ThingType::MANAGED && static_cast<const ManagedObject*>(next)->typeDescription_->IsArray();
+        if (!foldArray || j + 2 == path.size())
+            text += " -> " + PathCaptionOf(next);
+    }
+    return text;
+}
+
+const std::size_t kMaxRetentionPaths = 5;
+
+void DetailsWidget::DrawPaths(QListWidget* widget, ThingInMemory* thing) {
+    std::vector<std::vector<const ThingInMemory*>> paths;
+    CrawledMemorySnapshot::FindPathsToRoot(snapshot_, thing, kMaxRetentionPaths, paths);
+    for (std::size_t i = 0; i < paths.size(); i++) {
+        auto& path = paths[i];
+        auto header = new QListWidgetItem(QString("#%1 ").arg(static_cast<int>(i + 1)) + PathText(path));
+        header->setToolTip(header->text());
+        widget->addItem(header);
+        for (std::size_t j = 0; j + 1 < path.size(); j++) {
+            auto widgetItem = new QListWidgetItem();
+            widgetItem->setData(Qt::DisplayRole, "  " + PathCaptionOf(path[j]) + CrawledMemorySnapshot::ReferenceName(snapshot_, path[j], path[j + 1]));
+            widgetItem->setData(Qt::UserRole, path[j]->index_);
+            widget->addItem(widgetItem);
         }
-        managedObjCache_[address] = thing;
     }
-    return managedObjCache_[address];
 }
 
-void DetailsWidget::DrawFields(QListWidget* widget, TypeDescription* type, const BytesAndOffset& bo, bool useStatics) {
+void DetailsWidget::DrawFields(QListWidget* widget, const TypeDescription* type, const BytesAndOffset& bo, bool useStatics) {
     std::vector<const FieldDescription*> fields;
     CrawledMemorySnapshot::AllFieldsOf(snapshot_, type, useStatics ? FieldFindOptions::OnlyStatic : FieldFindOptions::OnlyInstance, fields);
     for (std::size_t i = 0; i < fields.size(); i++) {
@@ -177,55 +214,19 @@ void DetailsWidget::DrawFields(QListWidget* widget, ManagedObject* mo) {
 }
 
 void DetailsWidget::DrawValueFor(QListWidget* widget, const FieldDescription* field, const BytesAndOffset& bo) {
-    auto type = &snapshot_->typeDescriptions_[field->typeIndex_];
-    if (type->name_ == "System.Int32") {
-        widget->addItem(field->name_ + QString(": %1").arg(primitiveValueReader_->ReadInteger<std::int32_t>(bo)));
-    }
-    else if (type->name_ == "System.Int64") {
-        widget->addItem(field->name_ + QString(": %1").arg(primitiveValueReader_->ReadInteger<std::int64_t>(bo)));
-    }
-    else if (type->name_ == "System.UInt32") {
-        widget->addItem(field->name_ + QString(": %1").arg(primitiveValueReader_->ReadInteger<std::uint32_t>(bo)));
-    }
-    else if (type->name_ == "System.UInt64") {
-        widget->addItem(field->name_ + QString(": %1").arg(primitiveValueReader_->ReadInteger<std::uint64_t>(bo)));
-    }
-    else if (type->name_ == "System.Int16") {
-        widget->addItem(field->name_ + QString(": %1").arg(primitiveValueReader_->ReadInteger<std::int16_t>(bo)));
-    }
-    else if (type->name_ == "System.UInt16") {
-        widget->addItem(field->name_ + QString(": %1").arg(primitiveValueReader_->ReadInteger<std::uint16_t>(bo)));
-    }
-    else if (type->name_ == "System.Byte") {
-        widget->addItem(field->name_ + QString(": %1").arg(primitiveValueReader_->ReadInteger<std::uint8_t>(bo)));
-    }
-    else if (type->name_ == "System.SByte") {
-        widget->addItem(field->name_ + QString(": %1").arg(primitiveValueReader_->ReadInteger<std::int8_t>(bo)));
-    }
-    else if (type->name_ == "System.Char") {
-        widget->addItem(field->name_ + QString(": %1").arg(primitiveValueReader_->ReadInteger<std::uint16_t>(bo)));
-    }
-    else if (type->name_ == "System.Boolean") {
-        widget->addItem(field->name_ + QString(": %1").arg(primitiveValueReader_->ReadBool(bo)));
-    }
-    else if (type->name_ == "System.Single") {
-        widget->addItem(field->name_ + QString(": %1").arg(static_cast<double>(primitiveValueReader_->ReadInteger<float>(bo))));
-    }
-    else if (type->name_ == "System.Double") {
-        widget->addItem(field->name_ + QString(": %1").arg(primitiveValueReader_->ReadInteger<double>(bo)));
+    auto type = &snapshot_->typeCatalog_->types_[field->typeIndex_];
+    if (type->primitiveKind_ != PrimitiveKind::kNone && type->primitiveKind_ != PrimitiveKind::kString) {
+        widget->addItem(snapshot_->typeCatalog_->FieldName(*field) + ": " + primitiveValueReader_->ReadPrimitiveAsString(type->primitiveKind_, bo));
+        return;
     }
-    else if (type->name_ == "System.IntPtr") {
-        widget->addItem(field->name_ + QString(": %1").arg(primitiveValueReader_->ReadPointer(bo), 0, 16));
+    if (type->IsValueType()) {
+        DrawFields(widget, type, bo);
     } else {
-        if (type->IsValueType()) {
-            DrawFields(widget, type, bo);
+        auto thing = GetThingAt(bo.ReadPointer());
+        if (thing == nullptr) {
+            widget->addItem(snapshot_->typeCatalog_->FieldName(*field) + ": nullptr");
         } else {
-            auto thing = GetThingAt(bo.ReadPointer());
-            if (thing == nullptr) {
-                widget->addItem(field->name_ + ": nullptr");
-            } else {
-                DrawLinks(widget, { thing });
-            }
+            DrawLinks(widget, { thing });
         }
     }
 }
@@ -1,47 +1,173 @@
 #include "globalLog.h"
+
+#include <QByteArray>
+#include <QDateTime>
 #include <QFile>
-#include <QTextStream>
 
-GlobalLogDef::GlobalLogDef()
-{
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <mutex>
+#include <thread>
 
-}
+// 1024 slots of 256 bytes keep the log at a quarter of a megabyte however much is written
+const std::size_t kLogSlotCount = 1024; // a power of two, positions wrap with kLogSlotMask
+const std::size_t kLogSlotMask = kLogSlotCount - 1;
+const std::size_t kLogTextSize = 232;
+const auto kLogFlushInterval = std::chrono::milliseconds(100);
 
-void GlobalLogDef::writeToFile(QString &str ,int type){
-    QFile file("logfile.txt");
-    file.open(QIODevice::ReadWrite | QIODevice::Append);
-    QTextStream stream(&file);
-    if(type == 0){
+// a slot is free for the writer whose position equals its sequence and ready for the flush thread
+// once the sequence is one past that, Vyukov's bounded queue with a single consumer
+struct LogSlot {
+    std::atomic<std::size_t> sequence_;
+    qint64 time_;
+    UMPLogLevel level_;
+    std::uint32_t length_;
+    char text_[kLogTextSize];
+};
 
-        stream << str << "";
-    }
-    else{
-        stream << str << "\r\n";
-
-    }
+static LogSlot slots_[kLogSlotCount];
+static std::atomic<std::size_t> head_ {0};
+static std::size_t tail_ = 0; // flush thread only
+static std::atomic<std::uint64_t> dropped_ {0};
+static std::atomic<bool> running_ {false};
+static std::mutex wakeMutex_;
+static std::condition_variable wake_;
+static std::thread flushThread_;
+static QFile file_;
 
-    file.flush();
-    file.close();
+std::atomic<int> UMPLog::level_ {static_cast<int>(UMPLogLevel::kOff)};
 
+static const char* LevelName(UMPLogLevel level) {
+    switch (level) {
+    case UMPLogLevel::kDebug: return "D";
+    case UMPLogLevel::kInfo: return "I";
+    case UMPLogLevel::kWarning: return "W";
+    case UMPLogLevel::kError: return "E";
+    default: return "?";
+    }
+}
 
+static UMPLogLevel LevelFromEnvironment() {
+    auto name = qgetenv("UMP_LOG_LEVEL").toLower();
+    if (name == "debug")
+        return UMPLogLevel::kDebug;
+    if (name == "warning")
+        return UMPLogLevel::kWarning;
+    if (name == "error")
+        return UMPLogLevel::kError;
+    if (name == "off")
+        return UMPLogLevel::kOff;
+    return UMPLogLevel::kInfo;
 }
-void GlobalLogDef::writeToFile(int &str ,int type){
-    QFile file("logfile.txt");
-    file.open(QIODevice::ReadWrite | QIODevice::Append);
-    QTextStream stream(&file);
-    if(type == 0){
 
-        stream << str << "";
+// moves every ready slot into the file
+static void Drain() {
+    QByteArray lines;
+    while (true) {
+        auto& slot = slots_[tail_ & kLogSlotMask];
+        if (slot.sequence_.load(std::memory_order_acquire) != tail_ + 1)
+            break;
+        lines += QDateTime::fromMSecsSinceEpoch(slot.time_).toString("yyyy-MM-dd hh:mm:ss.zzz ").toUtf8();
+        lines += LevelName(slot.level_);
+        lines += ' ';
+        lines.append(slot.text_, static_cast<int>(slot.length_));
+        lines += '\n';
+        slot.sequence_.store(tail_ + kLogSlotCount, std::memory_order_release);
+        tail_++;
+    }
+    auto dropped = dropped_.exchange(0);
+    if (dropped > 0) {
+        lines += QDateTime::currentDateTime().toString("yyyy-MM-dd hh:mm:ss.zzz ").toUtf8();
+        lines += QString("W %1 messages dropped, the log ring was full\n").arg(dropped).toUtf8();
     }
-    else{
-        stream << str << "\r\n";
+    if (lines.isEmpty())
+        return;
+    file_.write(lines);
+    file_.flush();
+}
 
+static void FlushLoop() {
+    while (running_) {
+        Drain();
+        std::unique_lock<std::mutex> lock(wakeMutex_);
+        wake_.wait_for(lock, kLogFlushInterval);
     }
+    Drain();
+}
 
-    file.flush();
-    file.close();
+void UMPLog::Start(const QString& fileName) {
+    Start(fileName, LevelFromEnvironment());
+}
+
+void UMPLog::Start(const QString& fileName, UMPLogLevel level) {
+    Stop();
+    file_.setFileName(fileName);
+    if (!file_.open(QIODevice::WriteOnly | QIODevice::Append))
+        return;
+    // head_ carries over from an earlier run, so position head_ + i lives in its slot and not in slot i
+    auto head = head_.load(std::memory_order_relaxed);
+    for (std::size_t i = 0; i < kLogSlotCount; i++)
+        slots_[(head + i) & kLogSlotMask].sequence_.store(head + i, std::memory_order_relaxed);
+    tail_ = head;
+    running_ = true;
+    flushThread_ = std::thread(FlushLoop);
+    SetLevel(level);
+}
 
+void UMPLog::Stop() {
+    if (!running_)
+        return;
+    level_ = static_cast<int>(UMPLogLevel::kOff);
+    {
+        std::lock_guard<std::mutex> lock(wakeMutex_);
+        running_ = false;
+        wake_.notify_one();
+    }
+    flushThread_.join();
+    file_.close();
+}
 
+void UMPLog::SetLevel(UMPLogLevel level) {
+    if (running_)
+        level_ = static_cast<int>(level);
 }
 
-QString GlobalLogDef::log = "FLUSH";
+void UMPLog::Write(UMPLogLevel level, const QString& message) {
+    // everything that allocates happens before a slot is claimed, the flush thread stops at a claimed slot
+    auto text = message.toUtf8();
+    auto time = QDateTime::currentMSecsSinceEpoch();
+    auto position = head_.load(std::memory_order_relaxed);
+    LogSlot* slot;
+    while (true) {
+        slot = &slots_[position & kLogSlotMask];
+        auto sequence = slot->sequence_.load(std::memory_order_acquire);
+        if (sequence == position) {
+            if (head_.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                break;
+        } else if (sequence < position) {
+            // the flush thread is a whole ring behind
+            dropped_++;
+            return;
+        } else {
+            position = head_.load(std::memory_order_relaxed);
+        }
+    }
+    slot->time_ = time;
+    slot->level_ = level;
+    auto length = std::min(static_cast<std::size_t>(text.size()), kLogTextSize);
+    // a cut message ends on a whole utf-8 character
+    if (length < static_cast<std::size_t>(text.size())) {
+        while (length > 0 && (static_cast<unsigned char>(text[static_cast<int>(length)]) & 0xC0) == 0x80)
+            length--;
+    }
+    slot->length_ = static_cast<std::uint32_t>(length);
+    memcpy(slot->text_, text.constData(), slot->length_);
+    slot->sequence_.store(position + 1, std::memory_order_release);
+    // errors are written out right away in case the app goes down with them
+    if (level >= UMPLogLevel::kError) {
+        std::lock_guard<std::mutex> lock(wakeMutex_);
+        wake_.notify_one();
+    }
+}
@@ -1,11 +1,99 @@
 #include "mainwindow.h"
+#include "globalLog.h"
+#include "umpcrawler.h"
+#include "umpmodel.h"
+#include "umpquery.h"
 #include <QApplication>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QTextStream>
+
+#include <vector>
+
+// UnityMemPerf --query "<expr>" [--snapshot n] [--objects] file.uss
+// prints the query result to stdout without opening a window
+static int RunQuery(const QCommandLineParser& parser) {
+    QTextStream out(stdout);
+    QTextStream err(stderr);
+    if (parser.positionalArguments().size() != 1) {
+        err << "expected exactly one snapshot file" << "\n";
+        return 1;
+    }
+    QFile file(parser.positionalArguments()[0]);
+    if (!file.open(QIODevice::ReadOnly)) {
+        err << "can't open " << file.fileName() << "\n";
+        return 1;
+    }
+    QElapsedTimer time;
+    time.start();
+    std::vector<CrawledMemorySnapshot*> snapshots;
+    if (CrawledMemorySnapshot::ReadSnapshotFile(&file, snapshots) != 0) {
+        err << file.fileName() << " is not a snapshot file" << "\n";
+        return 1;
+    }
+    err << "loaded " << snapshots.size() << " snapshots in " << time.elapsed() << " ms" << "\n";
+    int only = -1;
+    if (parser.isSet("snapshot"))
+        only = parser.value("snapshot").toInt();
+    int status = 0;
+    for (std::size_t i = 0; i < snapshots.size(); i++) {
+        if (only >= 0 && static_cast<std::size_t>(only) != i)
+            continue;
+        auto snapshot = snapshots[i];
+        UMPQueryResult result;
+        QString error;
+        time.restart();
+        if (!UMPRunQuery(snapshot, parser.value("query"), result, error)) {
+            err << error << "\n";
+            status = 1;
+            break;
+        }
+        err << "queried " << snapshot->name_ << " in " << time.elapsed() << " ms" << "\n";
+        out << "# " << snapshot->name_ << ": " << result.matchCount_ << " objects, " << sizeToString(result.matchSize_) << "\n";
+        for (auto& group : result.groups_) {
+            out << group.key_ << "\t" << group.objects_.size() << "\t" << group.size_ << "\n";
+            if (!parser.isSet("objects"))
+                continue;
+            for (auto index : group.objects_) {
+                auto& managed = snapshot->managedObjects_[index];
+                out << "\t" << QString::number(managed.address_, 16) << "\t" << snapshot->typeCatalog_->TypeName(*managed.typeDescription_)
+                    << "\t" << managed.size_ << "\t" << managed.referencedBy_.size() << "\n";
+            }
+        }
+    }
+    for (auto snapshot : snapshots) {
+        CrawledMemorySnapshot::Free(snapshot);
+        delete snapshot;
+    }
+    return status;
+}
 
 int main(int argc, char *argv[])
 {
-    QApplication a(argc, argv);
-    MainWindow w;
-    w.show();
+    for (int i = 1; i < argc; i++) {
+        if (QString(argv[i]) != "--query")
+            continue;
+        QCoreApplication app(argc, argv);
+        QCommandLineParser parser;
+        parser.setApplicationDescription("Runs a query over the snapshots in a .uss file.");
+        parser.addHelpOption();
+        parser.addOption(QCommandLineOption("query", "Query expression, e.g. 'size > 1MB group by type'.", "expr"));
+        parser.addOption(QCommandLineOption("snapshot", "Only query the n-th snapshot in the file.", "n"));
+        parser.addOption(QCommandLineOption("objects", "List the objects of every group."));
+        parser.addPositionalArgument("file", "Snapshot file saved by UnityMemPerf.");
+        parser.process(app);
+        return RunQuery(parser);
+    }
 
-    return a.exec();
+    QApplication a(argc, argv);
+    UMPLog::Start("logfile.txt");
+    int status;
+    {
+        MainWindow w;
+        w.show();
+        status = a.exec();
+    }
+    UMPLog::Stop();
+    return status;
 }
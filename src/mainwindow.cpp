@@ -17,17 +17,28 @@
 #include <QTemporaryFile>
 #include <QFile>
 #include <QUndoStack>
+#include <QTabWidget>
+#include <QTabBar>
+#include <QListView>
+#include <QTreeView>
+#include <QScrollArea>
+#include <QInputDialog>
+#include <QElapsedTimer>
+#include <QtConcurrent/QtConcurrentRun>
 
 #include <algorithm>
 #include <unordered_map>
 #include <vector>
 
 #include "detailswidget.h"
+#include "umpanalyzer.h"
 #include "umpcrawler.h"
+#include "umpexport.h"
+#include "umpheapstrip.h"
 #include "umpmodel.h"
-
-#define APP_MAGIC 0xA1B9E9F7
-#define APP_VERSION 001
+#include "umpquery.h"
+#include "umptrace.h"
+#include "umptreemap.h"
 
 #include "globalLog.h"
 
@@ -41,10 +52,12 @@ public:
 
 struct SnapshotTabInfo {
     CrawledMemorySnapshot* snapshot_;
+    QTabWidget* pages_; // objects page first, then analysis pages
     QSplitter* spliter_;
     UMPTableProxyModel* snapshotModel_;
-    UMPTableProxyModel* instanceModel_;
+    UMPThingInMemoryModel* instanceModel_;
     QUndoStack* stack_;
+    UMPTrace trace_; // stage timings of a capture or diff made in this session
     bool replaying_ = false;
     void BeginReplay() { replaying_ = true; }
     void EndReplay() { replaying_ = false; }
@@ -96,6 +109,7 @@ MainWindow::MainWindow(QWidget *parent) :
     remoteProcess_ = new RemoteProcess(this);
     connect(remoteProcess_, &RemoteProcess::DataReceived, this, &MainWindow::RemoteDataReceived);
     connect(remoteProcess_, &RemoteProcess::ConnectionLost, this, &MainWindow::RemoteConnectionLost);
+    connect(&exportWatcher_, &QFutureWatcher<int>::finished, this, &MainWindow::OnExportFinished);
 
     LoadSettings();
 
@@ -109,6 +123,7 @@ MainWindow::MainWindow(QWidget *parent) :
 }
 
 MainWindow::~MainWindow() {
+    WaitForExport();
     delete ui;
 }
 
@@ -163,205 +178,24 @@ void MainWindow::SaveToFile(QFile *file) {
     stream << static_cast<quint32>(APP_MAGIC);
     stream << static_cast<quint32>(APP_VERSION);
     stream << static_cast<quint32>(snapShots_.size());
-    auto saveThing = [&](ThingInMemory* thing) {
-        stream << thing->index_ << thing->size_;
-        stream << static_cast<quint8>(thing->diff_) << thing->caption_;
-    };
     for (int i = 0; i < snapShots_.size(); i++) {
         auto& snapshot = snapShots_[ui->upperTabWidget->widget(i)].snapshot_;
-        stream << ui->upperTabWidget->tabText(i) << snapshot->isDiff_;
-        // typeDescriptions
-        stream << static_cast<quint32>(snapshot->typeDescriptions_.size());
-        for (auto& type : snapshot->typeDescriptions_) {
-            stream << static_cast<quint32>(type.flags_);
-            if (!type.IsArray()) {
-                stream << static_cast<quint32>(type.fields_.size());
-                for (auto& field : type.fields_) {
-                    stream << field.offset_ << field.typeIndex_ << field.name_ << field.isStatic_;
-                }
-                stream << type.staticsSize_;
-                if (type.staticsSize_ > 0)
-                    stream.writeRawData(reinterpret_cast<char*>(type.statics_), static_cast<int>(type.staticsSize_));
-            }
-            stream << type.baseOrElementTypeIndex_ << type.name_ << type.assemblyName_ <<
-                      type.typeInfoAddress_ << type.size_ << type.typeIndex_;
-        }
-        // gcHandles
-        stream << static_cast<quint32>(snapshot->gcHandles_.size());
-        for (auto& gcHandle : snapshot->gcHandles_) {
-            saveThing(&gcHandle);
-        }
-        // managed
-        stream << static_cast<quint32>(snapshot->managedObjects_.size());
-        for (auto& managed : snapshot->managedObjects_) {
-            saveThing(&managed);
-            stream << managed.address_;
-            stream << managed.typeDescription_->typeIndex_;
-        }
-        // statics
-        stream << static_cast<quint32>(snapshot->staticFields_.size());
-        for (auto& statics : snapshot->staticFields_) {
-            saveThing(&statics);
-            stream << statics.typeDescription_->typeIndex_;
-            stream << statics.nameHash_;
-        }
-        // refs refBys
-        stream << static_cast<quint32>(snapshot->allObjects_.size());
-        for (auto& thing : snapshot->allObjects_) {
-            stream << static_cast<quint32>(thing->references_.size());
-            for (auto& ref : thing->references_)
-                stream << ref->index_;
-            stream << static_cast<quint32>(thing->referencedBy_.size());
-            for (auto& refBy : thing->referencedBy_)
-                stream << refBy->index_;
-        }
-        // memory sections
-        stream << static_cast<quint32>(snapshot->managedHeap_.size());
-        for (auto& section : snapshot->managedHeap_) {
-            stream << section.sectionStartAddress_;
-            stream << section.sectionSize_;
-            if (section.sectionSize_ > 0)
-                stream.writeRawData(reinterpret_cast<char*>(section.sectionBytes_), static_cast<int>(section.sectionSize_));
-        }
-        // runtime
-        stream << snapshot->runtimeInformation_.pointerSize;
-        stream << snapshot->runtimeInformation_.objectHeaderSize;
-        stream << snapshot->runtimeInformation_.arrayHeaderSize;
-        stream << snapshot->runtimeInformation_.arrayBoundsOffsetInHeader;
-        stream << snapshot->runtimeInformation_.arraySizeOffsetInHeader;
-        stream << snapshot->runtimeInformation_.allocationGranularity;
+        CrawledMemorySnapshot::WriteSnapshot(stream, snapshot, ui->upperTabWidget->tabText(i));
     }
 }
 
 int MainWindow::LoadFromFile(QFile *file) {
-    QDataStream stream(file);
-    quint32 magic;
-    stream >> magic;
-    if (magic != APP_MAGIC)
-        return -1;
-    quint32 version;
-    stream >> version;
-    if (version != APP_VERSION)
+    std::vector<CrawledMemorySnapshot*> snapshots;
+    if (CrawledMemorySnapshot::ReadSnapshotFile(file, snapshots) != 0)
         return -1;
     CleanWorkSpace();
-    auto loadThing = [&](ThingInMemory* thing) {
-        quint8 flag;
-        stream >> thing->index_ >> thing->size_ >> flag >> thing->caption_;
-        thing->diff_ = static_cast<CrawledDiffFlags>(flag);
-    };
-    quint32 size;
-    stream >> size;
-    for (quint32 i = 0; i < size; i++) {
-        CrawledMemorySnapshot* snapshot = new CrawledMemorySnapshot();
-        stream >> snapshot->name_ >> snapshot->isDiff_;
-        // typeDescriptions
-        quint32 count;
-        stream >> count;
-        snapshot->typeDescriptions_.resize(count);
-        for (auto& type : snapshot->typeDescriptions_) {
-            quint32 flag;
-            stream >> flag;
-            type.flags_ = static_cast<Il2CppMetadataTypeFlags>(flag);
-            if (!type.IsArray()) {
-                stream >> flag;
-                type.fields_.resize(flag);
-                for (auto& field : type.fields_) {
-                    stream >> field.offset_ >> field.typeIndex_ >> field.name_ >> field.isStatic_;
-                }
-                stream >> type.staticsSize_;
-                if (type.staticsSize_ > 0) {
-                    type.statics_ = new quint8[type.staticsSize_];
-                    stream.readRawData(reinterpret_cast<char*>(type.statics_), static_cast<int>(type.staticsSize_));
-                }
-            }
-            stream >> type.baseOrElementTypeIndex_ >> type.name_ >> type.assemblyName_ >>
-                    type.typeInfoAddress_ >> type.size_ >> type.typeIndex_;
-        }
-        // gcHandles
-        stream >> count;
-        snapshot->gcHandles_.resize(count);
-        for (auto& gcHandle : snapshot->gcHandles_) {
-            loadThing(&gcHandle);
-        }
-        // managed
-        stream >> count;
-        snapshot->managedObjects_.resize(count);
-        for (auto& managed : snapshot->managedObjects_) {
-            loadThing(&managed);
-            stream >> managed.address_;
-            quint32 typeIndex;
-            stream >> typeIndex;
-            managed.typeDescription_ = &snapshot->typeDescriptions_[typeIndex];
-        }
-        // statics
-        stream >> count;
-        snapshot->staticFields_.resize(count);
-        for (auto& statics : snapshot->staticFields_) {
-            loadThing(&statics);
-            quint32 typeIndex;
-            stream >> typeIndex;
-            statics.typeDescription_ = &snapshot->typeDescriptions_[typeIndex];
-            stream >> statics.nameHash_;
-        }
-        // allObjects
-        snapshot->allObjects_.reserve(snapshot->gcHandles_.size() + snapshot->managedObjects_.size() + snapshot->staticFields_.size());
-        std::uint32_t index = 0;
-        for (auto& obj : snapshot->gcHandles_) {
-            obj.index_ = index++;
-            snapshot->allObjects_.push_back(&obj);
-        }
-        for (auto& obj : snapshot->staticFields_) {
-            obj.index_ = index++;
-            snapshot->allObjects_.push_back(&obj);
-        }
-        for (auto& obj : snapshot->managedObjects_) {
-            obj.index_ = index++;
-            snapshot->allObjects_.push_back(&obj);
-        }
-        // refs refBys
-        stream >> count;
-        for (auto& thing : snapshot->allObjects_) {
-            quint32 refCount;
-            stream >> refCount;
-            thing->references_.resize(refCount);
-            for (quint32 j = 0; j < refCount; j++) {
-                quint32 refIndex;
-                stream >> refIndex;
-                thing->references_[j] = snapshot->allObjects_[refIndex];
-            }
-            stream >> refCount;
-            thing->referencedBy_.resize(refCount);
-            for (quint32 j = 0; j < refCount; j++) {
-                quint32 refIndex;
-                stream >> refIndex;
-                thing->referencedBy_[j] = snapshot->allObjects_[refIndex];
-            }
-        }
-        // memory sections
-        stream >> count;
-        snapshot->managedHeap_.resize(count);
-        for (auto& section : snapshot->managedHeap_) {
-            stream >> section.sectionStartAddress_;
-            stream >> section.sectionSize_;
-            if (section.sectionSize_ > 0) {
-                section.sectionBytes_ = new quint8[section.sectionSize_];
-                stream.readRawData(reinterpret_cast<char*>(section.sectionBytes_), static_cast<int>(section.sectionSize_));
-            }
-        }
-        // runtime
-        stream >> snapshot->runtimeInformation_.pointerSize;
-        stream >> snapshot->runtimeInformation_.objectHeaderSize;
-        stream >> snapshot->runtimeInformation_.arrayHeaderSize;
-        stream >> snapshot->runtimeInformation_.arrayBoundsOffsetInHeader;
-        stream >> snapshot->runtimeInformation_.arraySizeOffsetInHeader;
-        stream >> snapshot->runtimeInformation_.allocationGranularity;
+    for (auto snapshot : snapshots)
         ShowSnapshot(snapshot);
-
-    }
     return 0;
 }
 
 void MainWindow::CleanWorkSpace() {
+    WaitForExport();
     while (ui->upperTabWidget->count() > 0) {
         ui->upperTabWidget->removeTab(0);
     }
@@ -425,36 +259,8 @@ void MainWindow::StartAppProcessErrorOccurred() {
     progressDialog_->close();
     Print("Error starting app: " + startAppProcess_->ErrorStr());
 }
-bool MainWindow::exportExecl(QString &fileName, QString &datas){
-        QString fullDirName = QDir::currentPath() ;
-        QString dirFile = fullDirName + "/" + fileName + ".csv";
-
-        dirFile = fileName;
-        Print(fileName);
-        QFile file(dirFile);
-        bool ret = file.open(QIODevice::Truncate | QIODevice::ReadWrite);
-        if(!ret)
-        {
-            qDebug() << "open failure";
-            return ret;
-        }
-
-        QTextStream stream(&file);
-        QString conTents =datas;
-        // 写入头
-        //conTents += "\n";
-
-        // 写内容
-
-        stream << conTents;
-
-        file.close();
-        return true;
-
-}
 //show memory  data
 void MainWindow::ShowSnapshot(CrawledMemorySnapshot* crawled) {
-    GlobalLogDef::log.append( "....");
     auto baseWidget = new QWidget();
     baseWidget->setLayout(new QHBoxLayout());
     auto getTableView = [](QWidget* parent) {
@@ -473,10 +279,23 @@ void MainWindow::ShowSnapshot(CrawledMemorySnapshot* crawled) {
     auto typeTable = getTableView(baseWidget);
     auto instanceTable = getTableView(baseWidget);
 
-    auto spliter = new QSplitter(baseWidget);
+    auto pages = new QTabWidget(baseWidget);
+    pages->setTabsClosable(true);
+    pages->setDocumentMode(true);
+    auto spliter = new QSplitter(pages);
     spliter->addWidget(typeTable);
     spliter->addWidget(instanceTable);
-    baseWidget->layout()->addWidget(spliter);
+    pages->addTab(spliter, "Objects");
+    pages->tabBar()->setTabButton(0, QTabBar::RightSide, nullptr);
+    pages->tabBar()->setTabButton(0, QTabBar::LeftSide, nullptr);
+    baseWidget->layout()->addWidget(pages);
+    connect(pages, &QTabWidget::tabCloseRequested, [pages](int index) {
+        if (index == 0)
+            return;
+        auto page = pages->widget(index);
+        pages->removeTab(index);
+        page->deleteLater();
+    });
 
     auto snapshotModel = new UMPTypeGroupModel(crawled, typeTable);
     auto snapshotProxyModel = new UMPTableProxyModel(snapshotModel, typeTable);
@@ -487,8 +306,7 @@ void MainWindow::ShowSnapshot(CrawledMemorySnapshot* crawled) {
 
 
     auto instanceModel = new UMPThingInMemoryModel(instanceTable);
-    auto instanceProxyModel = new UMPTableProxyModel(instanceModel, instanceTable);
-    instanceTable->setModel(instanceProxyModel);
+    instanceTable->setModel(instanceModel);
     instanceTable->horizontalHeader()->setSectionResizeMode(0, QHeaderView::ResizeMode::ResizeToContents);//QHeaderView::ResizeMode::Stretch
     instanceTable->horizontalHeader()->setSectionResizeMode(1, QHeaderView::ResizeMode::ResizeToContents);
     instanceTable->horizontalHeader()->setSectionResizeMode(2, QHeaderView::ResizeMode::ResizeToContents);
@@ -507,9 +325,8 @@ void MainWindow::ShowSnapshot(CrawledMemorySnapshot* crawled) {
             auto index = selected.indexes()[0];
             if (index.isValid()) {
                 auto row = snapshotProxyModel->mapToSource(index).row();
-                auto data = snapshotModel->getSubModel(row);
                 instanceTable->clearSelection();
-                instanceModel->reset(data, snapshotModel->getSnapshot()->isDiff_);
+                instanceModel->reset(snapshotModel, row, snapshotModel->getSnapshot()->isDiff_);
             }
         }
     });
@@ -518,8 +335,7 @@ void MainWindow::ShowSnapshot(CrawledMemorySnapshot* crawled) {
         if (selected.indexes().size() > 0) {
             auto index = selected.indexes()[0];
             if (index.isValid()) {
-                auto row = instanceProxyModel->mapToSource(index).row();
-                auto thing = instanceModel->thingAt(row);
+                auto thing = instanceModel->thingAt(index.row());
                 detailPanel->ShowThing(thing, thing->type());
                 if (thing) {
                     snapShots_[baseWidget].Push(thing->index_);
@@ -532,9 +348,10 @@ void MainWindow::ShowSnapshot(CrawledMemorySnapshot* crawled) {
     SnapshotTabInfo tabInfo;
     tabInfo.stack_ = new QUndoStack(baseWidget);
     tabInfo.snapshot_ = crawled;
+    tabInfo.pages_ = pages;
     tabInfo.spliter_ = spliter;
     tabInfo.snapshotModel_ = snapshotProxyModel;
-    tabInfo.instanceModel_ = instanceProxyModel;
+    tabInfo.instanceModel_ = instanceModel;
     snapShots_[baseWidget] = tabInfo;
 
     ui->upperTabWidget->addTab(baseWidget, crawled->name_);
@@ -542,29 +359,6 @@ void MainWindow::ShowSnapshot(CrawledMemorySnapshot* crawled) {
     ui->upperTabWidget->setTabToolTip(
                 ui->upperTabWidget->currentIndex(),
                 "Total: " + sizeToString(snapshotModel->getTotalSize()));
-
-
-    Print(GlobalLogDef::log);
-    Print("88888888888888888.");
-
-    QAbstractItemModel *model = typeTable->model ();
-    QModelIndex index = model->index(3,3);
-    QVariant data = model->data(index);
-    QString str = "";
-    str.append("No,Type,Count,Size\r\n");
-    for(int i=0 ;i<model->rowCount();i++  ){
-        for(int j = 0 ;j<model->columnCount() ;j++  ){
-            index = model->index(i,j);
-            str.append( model->data(index).toString() );
-            if(j != model->columnCount()-1  )str.append(",");
-        }
-        str.append("\r\n");
-    }
-    ui->consolePlainTextEdit->clear();
-    Print(crawled->name_);
-    Print(str);
-    _cacheCsvContent = str;
-    //exportExecl(crawled->name_, str);
 }
 
 void MainWindow::UpdateShowNextPrev() {
@@ -590,8 +384,15 @@ void MainWindow::RemoteDataReceived() {
     delete packedCrawlerData;
 
     crawled->name_ = "Snapshot_" + QTime::currentTime().toString("H_m_s");
-    ShowSnapshot(crawled);
-    Print("Snapshot Received And Unpacked.");
+    {
+        UMPScopedTimer timer("show");
+        ShowSnapshot(crawled);
+    }
+    auto& info = snapShots_[ui->upperTabWidget->currentWidget()];
+    info.trace_ = UMPTraceRecorder::EndCapture();
+    auto summary = UMPTraceSummary(info.trace_);
+    Print("Snapshot Received And Unpacked: " + summary);
+    UMPLOGI(crawled->name_ + ": " + summary);
 }
 
 void MainWindow::RemoteConnectionLost() {
@@ -631,28 +432,37 @@ void MainWindow::OnThingSelected(std::uint32_t index) {
     if (index >= info.snapshot_->allObjects_.size())
         return;
     auto& thing = info.snapshot_->allObjects_[index];
-    TypeDescription* type = nullptr;
+    const TypeDescription* type = nullptr;
     if (thing->type() == ThingType::MANAGED) {
         type = static_cast<ManagedObject*>(thing)->typeDescription_;
     } else if (thing->type() == ThingType::STATIC) {
         type = static_cast<StaticFields*>(thing)->typeDescription_;
+    } else if (thing->type() == ThingType::STATIC_FIELD) {
+        type = static_cast<StaticFieldRoot*>(thing)->typeDescription_;
     } else {
         return;
     }
-    auto typeTable = static_cast<QTableView*>(info.spliter_->widget(0));
-    auto typeGroupModel = static_cast<UMPTypeGroupModel*>(info.snapshotModel_->sourceModel());
-    auto selectTypeIndex = info.snapshotModel_->mapFromSource(typeGroupModel->index(static_cast<int>(type->typeIndex_), 0));
-    typeTable->selectRow(selectTypeIndex.row());
+    SelectType(type->typeIndex_);
     auto instanceTable = static_cast<QTableView*>(info.spliter_->widget(1));
-    auto thingModel = static_cast<UMPThingInMemoryModel*>(info.instanceModel_->sourceModel());
-    auto thingModelIndex = thingModel->indexOf(thing);
+    auto thingModelIndex = info.instanceModel_->indexOf(thing);
     if (thingModelIndex != -1) {
-        auto selectThingIndex = info.instanceModel_->mapFromSource(thingModel->index(thingModelIndex, 0));
-        instanceTable->selectRow(selectThingIndex.row());
+        instanceTable->selectRow(thingModelIndex);
+        instanceTable->scrollTo(info.instanceModel_->index(thingModelIndex, 0));
         return;
     }
 }
 
+void MainWindow::SelectType(std::uint32_t typeIndex, bool showObjectsPage) {
+    auto& info = snapShots_[ui->upperTabWidget->currentWidget()];
+    if (showObjectsPage)
+        info.pages_->setCurrentWidget(info.spliter_);
+    auto typeTable = static_cast<QTableView*>(info.spliter_->widget(0));
+    auto typeGroupModel = static_cast<UMPTypeGroupModel*>(info.snapshotModel_->sourceModel());
+    auto selectTypeIndex = info.snapshotModel_->mapFromSource(typeGroupModel->index(static_cast<int>(typeIndex), 0));
+    typeTable->selectRow(selectTypeIndex.row());
+    typeTable->scrollTo(selectTypeIndex);
+}
+
 void MainWindow::on_actionOpen_triggered() {
     QString fileName = QFileDialog::getOpenFileName(nullptr, tr("Open UnityMemPerf File"),
                                                     GetLastOpenDir(), tr("UnityMemPerf Files (*.uss)"));
@@ -695,7 +505,82 @@ void MainWindow::on_actionSave_triggered() {
         return;
     }
     tempFile.setAutoRemove(false);
-    exportExecl(csvFile.append(".csv"), _cacheCsvContent);
+    // the type table of the current tab goes next to it for spreadsheets
+    if (ui->upperTabWidget->count() > 0)
+        ExportTable(snapShots_[ui->upperTabWidget->currentWidget()].snapshot_, UMPExportTable::kTypes, csvFile + ".csv");
+}
+
+void MainWindow::on_actionExport_Table_triggered() {
+    if (ui->upperTabWidget->count() == 0)
+        return;
+    bool ok = false;
+    auto tableName = QInputDialog::getItem(this, "Export Table", "Table", QStringList() << "Types" << "Instances", 0, false, &ok);
+    if (!ok)
+        return;
+    auto table = tableName == "Types" ? UMPExportTable::kTypes : UMPExportTable::kInstances;
+    auto defaultName = QDir(GetLastOpenDir()).filePath(ui->upperTabWidget->tabText(ui->upperTabWidget->currentIndex()) + "_" + tableName.toLower());
+    QString filter;
+    QString fileName = QFileDialog::getSaveFileName(nullptr, tr("Export Table"), defaultName,
+                                                    tr("CSV Files (*.csv);;JSON Lines Files (*.jsonl);;Columnar Files (*.umpc)"), &filter);
+    if (fileName.isEmpty())
+        return;
+    if (QFileInfo(fileName).suffix().isEmpty()) {
+        auto format = filter.contains("jsonl") ? UMPExportFormat::kJsonLines :
+                      filter.contains("umpc") ? UMPExportFormat::kColumnar : UMPExportFormat::kCsv;
+        fileName += "." + UMPExportSuffix(format);
+    }
+    ExportTable(snapShots_[ui->upperTabWidget->currentWidget()].snapshot_, table, fileName);
+}
+
+void MainWindow::ExportTable(const CrawledMemorySnapshot* snapshot, UMPExportTable table, const QString& fileName) {
+    if (exportWatcher_.isRunning()) {
+        Print("Export of " + exportFileName_ + " is still running, try again later");
+        return;
+    }
+    auto format = UMPExportFormatOf(fileName);
+    exportFileName_ = fileName;
+    exportTimer_.start();
+    Print("Exporting " + fileName + " ...");
+    exportWatcher_.setFuture(QtConcurrent::run([snapshot, table, format, fileName]() {
+        QFile file(fileName);
+        if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+            return -1;
+        return UMPExportSnapshot(snapshot, table, format, &file);
+    }));
+}
+
+void MainWindow::WaitForExport() {
+    if (exportWatcher_.isRunning())
+        exportWatcher_.waitForFinished();
+}
+
+void MainWindow::OnExportFinished() {
+    if (exportWatcher_.result() != 0) {
+        Print("Error writing " + exportFileName_);
+        return;
+    }
+    Print(QString("Exported %1 in %2 ms").arg(exportFileName_).arg(exportTimer_.elapsed()));
+}
+
+void MainWindow::on_actionExport_Trace_triggered() {
+    if (ui->upperTabWidget->count() == 0)
+        return;
+    auto& info = snapShots_[ui->upperTabWidget->currentWidget()];
+    if (info.trace_.events_.empty()) {
+        QMessageBox::warning(this, "Warning", "Only snapshots captured or diffed in this session have timings!",
+                             QMessageBox::StandardButton::Ok);
+        return;
+    }
+    auto defaultName = QDir(GetLastOpenDir()).filePath(ui->upperTabWidget->tabText(ui->upperTabWidget->currentIndex()) + ".json");
+    QString fileName = QFileDialog::getSaveFileName(nullptr, tr("Export Chrome Trace"), defaultName, tr("Chrome Trace Files (*.json)"));
+    if (fileName.isEmpty())
+        return;
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        QMessageBox::warning(this, "Warning", "Can't create file!", QMessageBox::StandardButton::Ok);
+        return;
+    }
+    file.write(UMPTraceToChromeJson(info.trace_));
 }
 
 void MainWindow::on_actionExit_triggered() {
@@ -912,12 +797,14 @@ void MainWindow::on_launchPushButton_clicked() {
 
 void MainWindow::on_actionCapture_Snapshot_triggered() {
     if (remoteProcess_->IsConnected()) {
+        UMPTraceRecorder::BeginCapture("Capture_" + QTime::currentTime().toString("H_m_s"));
         remoteProcess_->Send(UMPMessageType::CAPTURE_SNAPSHOT);
         Print("Requesting Memory Snapshot ... ");
     }
 }
 
 void MainWindow::on_upperTabWidget_tabCloseRequested(int index) {
+    WaitForExport();
     auto widget = ui->upperTabWidget->widget(index);
     if (widget == firstDiffPage_)
         firstDiffPage_ = nullptr;
@@ -965,6 +852,330 @@ void MainWindow::on_actionMark_Second_triggered() {
     if (QMessageBox::information(
                 this, "Message", QString("Diff %1 with %2?").arg(firstTitle).arg(secondTitle),
                 QMessageBox::StandardButton::Yes | QMessageBox::StandardButton::No) == QMessageBox::StandardButton::Yes) {
-        ShowSnapshot(CrawledMemorySnapshot::Diff(snapShots_[firstDiffPage_].snapshot_, snapShots_[secondDiffPage].snapshot_));
+        UMPTraceRecorder::BeginCapture(QString("Diff %1 with %2").arg(firstTitle).arg(secondTitle));
+        auto diffed = CrawledMemorySnapshot::Diff(snapShots_[firstDiffPage_].snapshot_, snapShots_[secondDiffPage].snapshot_);
+        {
+            UMPScopedTimer timer("show");
+            ShowSnapshot(diffed);
+        }
+        auto& info = snapShots_[ui->upperTabWidget->currentWidget()];
+        info.trace_ = UMPTraceRecorder::EndCapture();
+        Print("Diffed: " + UMPTraceSummary(info.trace_));
+    }
+}
+
+void MainWindow::AddAnalysisPage(QWidget* page, const QString& title, const QString& toolTip) {
+    auto& info = snapShots_[ui->upperTabWidget->currentWidget()];
+    auto index = info.pages_->addTab(page, title);
+    info.pages_->setTabToolTip(index, toolTip);
+    info.pages_->setCurrentIndex(index);
+}
+
+void MainWindow::ShowDuplicateGroups(UMPDuplicateGroupModel* model, const QString& title, UMPDuplicateTypeModel* typeModel) {
+    auto page = new QSplitter(Qt::Vertical);
+    auto groupPage = new QSplitter();
+    auto groupTable = new QTableView(groupPage);
+    groupTable->setSortingEnabled(true);
+    groupTable->setSelectionMode(QAbstractItemView::SelectionMode::SingleSelection);
+    groupTable->setSelectionBehavior(QAbstractItemView::SelectRows);
+    groupTable->verticalHeader()->setEnabled(false);
+    groupTable->setWordWrap(false);
+    model->setParent(groupTable);
+    auto proxyModel = new UMPDuplicateGroupProxyModel(model, groupTable);
+    groupTable->setModel(proxyModel);
+    groupTable->horizontalHeader()->setSectionResizeMode(0, QHeaderView::ResizeMode::Stretch);
+    groupTable->horizontalHeader()->setSectionResizeMode(1, QHeaderView::ResizeMode::ResizeToContents);
+    groupTable->horizontalHeader()->setSectionResizeMode(2, QHeaderView::ResizeMode::ResizeToContents);
+    groupTable->horizontalHeader()->setSectionResizeMode(3, QHeaderView::ResizeMode::ResizeToContents);
+    // most wasted first, same order the analyzer returns
+    groupTable->horizontalHeader()->setSortIndicator(3, Qt::DescendingOrder);
+    auto instanceList = new QListView(groupPage);
+    instanceList->setUniformItemSizes(true);
+    auto instanceModel = new UMPManagedListModel(instanceList);
+    instanceList->setModel(instanceModel);
+    groupPage->addWidget(groupTable);
+    groupPage->addWidget(instanceList);
+    groupPage->setStretchFactor(0, 3);
+    groupPage->setStretchFactor(1, 1);
+    if (typeModel != nullptr) {
+        // picking a type narrows the groups to it, clearing the selection shows all of them again
+        auto typeTable = new QTableView(page);
+        typeTable->setSortingEnabled(true);
+        typeTable->setSelectionMode(QAbstractItemView::SelectionMode::SingleSelection);
+        typeTable->setSelectionBehavior(QAbstractItemView::SelectRows);
+        typeTable->verticalHeader()->setEnabled(false);
+        typeModel->setParent(typeTable);
+        auto typeProxyModel = new UMPTableProxyModel(typeModel, typeTable);
+        typeTable->setModel(typeProxyModel);
+        typeTable->horizontalHeader()->setSectionResizeMode(0, QHeaderView::ResizeMode::Stretch);
+        typeTable->horizontalHeader()->setSortIndicator(3, Qt::DescendingOrder);
+        page->addWidget(typeTable);
+        connect(typeTable->selectionModel(), &QItemSelectionModel::selectionChanged, [=](const QItemSelection &selected, const QItemSelection &) {
+            if (selected.indexes().size() > 0 && selected.indexes()[0].isValid()) {
+                proxyModel->setTypeFilter(typeModel->typeAt(typeProxyModel->mapToSource(selected.indexes()[0]).row()));
+            } else {
+                proxyModel->setTypeFilter(nullptr);
+            }
+            instanceModel->reset(model->getSnapshot(), nullptr);
+        });
+    }
+    page->addWidget(groupPage);
+    connect(groupTable->selectionModel(), &QItemSelectionModel::selectionChanged, [=](const QItemSelection &selected, const QItemSelection &) {
+        if (selected.indexes().size() > 0) {
+            auto index = selected.indexes()[0];
+            if (index.isValid())
+                instanceModel->reset(model->getSnapshot(), &model->groupAt(proxyModel->mapToSource(index).row()).objects_);
+        }
+    });
+    connect(instanceList, &QListView::doubleClicked, [=](const QModelIndex &index) {
+        auto data = index.data(Qt::UserRole);
+        if (data.isValid())
+            OnThingSelected(data.toUInt());
+    });
+    AddAnalysisPage(page, title, QString("Wasted: %1 in %2 groups").arg(sizeToString(model->getWastedSize())).arg(model->rowCount()));
+}
+
+void MainWindow::on_actionDuplicate_Strings_triggered() {
+    auto widget = ui->upperTabWidget->currentWidget();
+    if (widget == nullptr || !snapShots_.contains(widget))
+        return;
+    auto snapshot = snapShots_[widget].snapshot_;
+    std::vector<UMPDuplicateGroup> groups;
+    UMPFindDuplicateStrings(snapshot, groups);
+    ShowDuplicateGroups(new UMPDuplicateGroupModel(snapshot, std::move(groups), nullptr), "Duplicate strings");
+}
+
+void MainWindow::on_actionDuplicate_Arrays_triggered() {
+    auto widget = ui->upperTabWidget->currentWidget();
+    if (widget == nullptr || !snapShots_.contains(widget))
+        return;
+    auto snapshot = snapShots_[widget].snapshot_;
+    std::vector<UMPDuplicateGroup> groups;
+    UMPFindDuplicateArrays(snapshot, groups);
+    std::vector<UMPDuplicateTypeSummary> summaries;
+    UMPSummarizeDuplicatesByType(snapshot, groups, summaries);
+    auto typeModel = new UMPDuplicateTypeModel(snapshot, std::move(summaries), nullptr);
+    ShowDuplicateGroups(new UMPDuplicateGroupModel(snapshot, std::move(groups), nullptr), "Duplicate arrays", typeModel);
+}
+
+// results get a page of their own instead of filtering the snapshot's type and instance tables: those are
+// spans over the objects UMPTypeGroupModel groups once per snapshot, and a query's groups (by assembly,
+// by namespace) don't line up with them
+void MainWindow::ShowQueryResult(UMPQueryGroupModel* model, const QString& query) {
+    auto page = new QSplitter();
+    auto groupTable = new QTableView(page);
+    groupTable->setSortingEnabled(true);
+    groupTable->setSelectionMode(QAbstractItemView::SelectionMode::SingleSelection);
+    groupTable->setSelectionBehavior(QAbstractItemView::SelectRows);
+    groupTable->verticalHeader()->setEnabled(false);
+    groupTable->setWordWrap(false);
+    model->setParent(groupTable);
+    auto proxyModel = new UMPTableProxyModel(model, groupTable);
+    groupTable->setModel(proxyModel);
+    groupTable->horizontalHeader()->setSectionResizeMode(0, QHeaderView::ResizeMode::Stretch);
+    groupTable->horizontalHeader()->setSectionResizeMode(1, QHeaderView::ResizeMode::ResizeToContents);
+    groupTable->horizontalHeader()->setSectionResizeMode(2, QHeaderView::ResizeMode::ResizeToContents);
+    groupTable->horizontalHeader()->setSortIndicator(2, Qt::DescendingOrder);
+    auto instanceList = new QListView(page);
+    instanceList->setUniformItemSizes(true);
+    auto instanceModel = new UMPManagedListModel(instanceList);
+    instanceList->setModel(instanceModel);
+    page->addWidget(groupTable);
+    page->addWidget(instanceList);
+    page->setStretchFactor(0, 2);
+    page->setStretchFactor(1, 1);
+    connect(groupTable->selectionModel(), &QItemSelectionModel::selectionChanged, [=](const QItemSelection &selected, const QItemSelection &) {
+        if (selected.indexes().size() > 0) {
+            auto index = selected.indexes()[0];
+            if (index.isValid())
+                instanceModel->reset(model->getSnapshot(), &model->groupAt(proxyModel->mapToSource(index).row()).objects_);
+        }
+    });
+    connect(instanceList, &QListView::doubleClicked, [=](const QModelIndex &index) {
+        auto data = index.data(Qt::UserRole);
+        if (data.isValid())
+            OnThingSelected(data.toUInt());
+    });
+    // an ungrouped query has a single group, show its objects right away
+    if (model->rowCount() == 1)
+        groupTable->selectRow(0);
+    auto& result = model->getResult();
+    AddAnalysisPage(page, query, QString("%1 objects, %2").arg(static_cast<quint64>(result.matchCount_)).arg(sizeToString(result.matchSize_)));
+}
+
+void MainWindow::on_actionQuery_triggered() {
+    auto widget = ui->upperTabWidget->currentWidget();
+    if (widget == nullptr || !snapShots_.contains(widget))
+        return;
+    bool ok = false;
+    auto query = QInputDialog::getText(this, "Query", "e.g. type ~ \"*Texture*\" and size > 1MB and refcount == 0 group by assembly",
+                                       QLineEdit::Normal, lastQuery_, &ok);
+    if (!ok)
+        return;
+    lastQuery_ = query;
+    auto snapshot = snapShots_[widget].snapshot_;
+    UMPQueryResult result;
+    QString error;
+    QElapsedTimer time;
+    time.start();
+    if (!UMPRunQuery(snapshot, query, result, error)) {
+        QMessageBox::warning(this, "Query", error);
+        return;
     }
+    Print(QString("query '%1': %2 objects in %3 ms").arg(query).arg(static_cast<quint64>(result.matchCount_)).arg(time.elapsed()));
+    ShowQueryResult(new UMPQueryGroupModel(snapshot, std::move(result), nullptr), query.isEmpty() ? "All objects" : query);
+}
+
+void MainWindow::on_actionAssembly_Rollup_triggered() {
+    auto widget = ui->upperTabWidget->currentWidget();
+    if (widget == nullptr || !snapShots_.contains(widget))
+        return;
+    std::vector<UMPRollupNode> nodes;
+    UMPBuildRollup(snapShots_[widget].snapshot_, nodes);
+    auto tree = new QTreeView();
+    tree->setSortingEnabled(true);
+    tree->setSelectionMode(QAbstractItemView::SelectionMode::SingleSelection);
+    tree->setSelectionBehavior(QAbstractItemView::SelectRows);
+    tree->setUniformRowHeights(true);
+    auto model = new UMPRollupModel(std::move(nodes), tree);
+    auto proxyModel = new UMPTableProxyModel(model, tree);
+    tree->setModel(proxyModel);
+    tree->header()->setSectionResizeMode(0, QHeaderView::ResizeMode::Stretch);
+    tree->header()->setSectionResizeMode(1, QHeaderView::ResizeMode::ResizeToContents);
+    tree->header()->setSectionResizeMode(2, QHeaderView::ResizeMode::ResizeToContents);
+    tree->header()->setSectionResizeMode(3, QHeaderView::ResizeMode::ResizeToContents);
+    tree->header()->setStretchLastSection(false);
+    tree->sortByColumn(3, Qt::DescendingOrder);
+    // a type row jumps to the type in the objects page
+    connect(tree, &QTreeView::doubleClicked, [=](const QModelIndex &index) {
+        auto& node = model->nodeAt(proxyModel->mapToSource(index));
+        if (node.level_ == UMPRollupLevel::kType)
+            SelectType(node.typeIndex_);
+    });
+    auto& totals = model->getTotals();
+    AddAnalysisPage(tree, "Assemblies", QString("%1 objects, %2 shallow").arg(totals.count_).arg(sizeToString(totals.shallowSize_)));
+}
+
+void MainWindow::on_actionTreemap_triggered() {
+    auto widget = ui->upperTabWidget->currentWidget();
+    if (widget == nullptr || !snapShots_.contains(widget))
+        return;
+    auto& info = snapShots_[widget];
+    auto typeGroupModel = static_cast<UMPTypeGroupModel*>(info.snapshotModel_->sourceModel());
+    auto treemap = new UMPTreemapWidget(typeGroupModel);
+    // picking a type keeps the treemap up, the type table follows along behind it
+    connect(treemap, &UMPTreemapWidget::TypeSelected, [this](std::uint32_t typeIndex) {
+        SelectType(typeIndex, false);
+    });
+    connect(treemap, &UMPTreemapWidget::ThingSelected, this, &MainWindow::OnThingSelected);
+    AddAnalysisPage(treemap, "Treemap", "Double click a type to see its instances, backspace or right click to go back");
+}
+
+void MainWindow::on_actionHeap_Fragmentation_triggered() {
+    auto widget = ui->upperTabWidget->currentWidget();
+    if (widget == nullptr || !snapShots_.contains(widget))
+        return;
+    auto snapshot = snapShots_[widget].snapshot_;
+    UMPFragmentationReport report;
+    UMPAnalyzeFragmentation(snapshot, report);
+    auto page = new QSplitter();
+    auto tables = new QSplitter(Qt::Vertical, page);
+    auto getTableView = [](QWidget* parent) {
+        auto view = new QTableView(parent);
+        view->setSortingEnabled(true);
+        view->setSelectionMode(QAbstractItemView::SelectionMode::SingleSelection);
+        view->setSelectionBehavior(QAbstractItemView::SelectRows);
+        view->verticalHeader()->setEnabled(false);
+        view->setWordWrap(false);
+        return view;
+    };
+    auto sectionTable = getTableView(tables);
+    auto sectionModel = new UMPHeapSectionModel(std::move(report), sectionTable);
+    auto sectionProxyModel = new UMPTableProxyModel(sectionModel, sectionTable);
+    sectionTable->setModel(sectionProxyModel);
+    sectionTable->horizontalHeader()->setSectionResizeMode(QHeaderView::ResizeMode::ResizeToContents);
+    auto holeTable = getTableView(tables);
+    auto holeModel = new UMPHoleHistogramModel(&sectionModel->getReport(), holeTable);
+    holeTable->setModel(new UMPTableProxyModel(holeModel, holeTable));
+    holeTable->horizontalHeader()->setSectionResizeMode(QHeaderView::ResizeMode::ResizeToContents);
+    tables->addWidget(sectionTable);
+    tables->addWidget(holeTable);
+    tables->setStretchFactor(0, 3);
+    tables->setStretchFactor(1, 1);
+    auto strip = new UMPHeapStripWidget(snapshot, &sectionModel->getReport());
+    auto stripArea = new QScrollArea(page);
+    stripArea->setWidget(strip);
+    stripArea->setWidgetResizable(true);
+    page->addWidget(tables);
+    page->addWidget(stripArea);
+    connect(sectionTable->selectionModel(), &QItemSelectionModel::selectionChanged, [=](const QItemSelection &selected, const QItemSelection &) {
+        if (selected.indexes().size() > 0 && selected.indexes()[0].isValid()) {
+            auto row = sectionProxyModel->mapToSource(selected.indexes()[0]).row();
+            strip->SetCurrentSection(row);
+            stripArea->ensureVisible(0, row * strip->height() / std::max(1, sectionModel->rowCount()));
+        }
+    });
+    connect(strip, &UMPHeapStripWidget::ThingSelected, this, &MainWindow::OnThingSelected);
+    auto& totals = sectionModel->getReport();
+    auto occupancy = totals.heapSize_ > 0 ? 100.0 * static_cast<double>(totals.liveSize_) / static_cast<double>(totals.heapSize_) : 0.0;
+    AddAnalysisPage(page, "Heap", QString("%1 of %2 live (%3%), largest hole %4")
+                    .arg(sizeToString(static_cast<qint64>(totals.liveSize_))).arg(sizeToString(static_cast<qint64>(totals.heapSize_)))
+                    .arg(occupancy, 0, 'f', 1).arg(sizeToString(static_cast<qint64>(totals.largestHole_))));
+}
+
+void MainWindow::on_actionUnreachable_Objects_triggered() {
+    auto widget = ui->upperTabWidget->currentWidget();
+    if (widget == nullptr || !snapShots_.contains(widget))
+        return;
+    auto snapshot = snapShots_[widget].snapshot_;
+    UMPHeapWalkReport report;
+    UMPWalkHeap(snapshot, report);
+    auto table = new QTableView();
+    table->setSortingEnabled(true);
+    table->setSelectionMode(QAbstractItemView::SelectionMode::SingleSelection);
+    table->setSelectionBehavior(QAbstractItemView::SelectRows);
+    table->verticalHeader()->setEnabled(false);
+    table->setWordWrap(false);
+    auto model = new UMPUnreachableTypeModel(snapshot, std::move(report), table);
+    table->setModel(new UMPTableProxyModel(model, table));
+    table->horizontalHeader()->setSectionResizeMode(0, QHeaderView::ResizeMode::Stretch);
+    table->horizontalHeader()->setSectionResizeMode(1, QHeaderView::ResizeMode::ResizeToContents);
+    table->horizontalHeader()->setSectionResizeMode(2, QHeaderView::ResizeMode::ResizeToContents);
+    table->horizontalHeader()->setSortIndicator(2, Qt::DescendingOrder);
+    auto& totals = model->getReport();
+    AddAnalysisPage(table, "Unreachable", QString("%1 unreachable objects, %2 (reachable: %3 objects, %4)")
+                    .arg(static_cast<quint64>(totals.unreachableCount_)).arg(sizeToString(static_cast<qint64>(totals.unreachableSize_)))
+                    .arg(static_cast<quint64>(totals.reachableCount_)).arg(sizeToString(static_cast<qint64>(totals.reachableSize_))));
+}
+
+void MainWindow::on_actionRoots_triggered() {
+    auto widget = ui->upperTabWidget->currentWidget();
+    if (widget == nullptr || !snapShots_.contains(widget))
+        return;
+    auto snapshot = snapShots_[widget].snapshot_;
+    UMPRootReport report;
+    UMPBuildRootReport(snapshot, report);
+    auto table = new QTableView();
+    table->setSortingEnabled(true);
+    table->setSelectionMode(QAbstractItemView::SelectionMode::SingleSelection);
+    table->setSelectionBehavior(QAbstractItemView::SelectRows);
+    table->verticalHeader()->setEnabled(false);
+    table->setWordWrap(false);
+    auto model = new UMPRootModel(snapshot, std::move(report), table);
+    auto proxyModel = new UMPTableProxyModel(model, table);
+    table->setModel(proxyModel);
+    table->horizontalHeader()->setSectionResizeMode(0, QHeaderView::ResizeMode::Stretch);
+    for (int column = 1; column < model->columnCount(); column++)
+        table->horizontalHeader()->setSectionResizeMode(column, QHeaderView::ResizeMode::ResizeToContents);
+    table->horizontalHeader()->setSortIndicator(4, Qt::DescendingOrder);
+    // a gchandle jumps to the object it holds
+    connect(table, &QTableView::doubleClicked, [=](const QModelIndex &index) {
+        auto thing = model->thingToShow(proxyModel->mapToSource(index).row());
+        if (thing != kNoManagedObject)
+            OnThingSelected(thing);
+    });
+    auto& totals = model->getReport();
+    AddAnalysisPage(table, "Roots", QString("%1 roots, %2 objects (%3) shared between roots")
+                    .arg(static_cast<quint64>(totals.roots_.size()))
+                    .arg(static_cast<quint64>(totals.sharedCount_)).arg(sizeToString(totals.sharedSize_)));
 }
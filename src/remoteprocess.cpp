@@ -1,6 +1,8 @@
 #include "remoteprocess.h"
 
+#include "globalLog.h"
 #include "umpmemory.h"
+#include "umptrace.h"
 
 #include <QtEndian>
 #include <QTcpSocket>
@@ -8,7 +10,6 @@
 #include <QDataStream>
 #include <QRegularExpression>
 #include <QProcess>
-#include <QDebug>
 
 void Il2CppFreeMemorySnapshot(Il2CppManagedMemorySnapshot* snapshot) {
     if (snapshot->heap.sectionCount > 0) {
@@ -36,22 +37,54 @@ void Il2CppFreeMemorySnapshot(Il2CppManagedMemorySnapshot* snapshot) {
         for (uint32_t i = 0; i < snapshot->metadata.typeCount; i++) {
             auto& type = snapshot->metadata.types[i];
             if ((type.flags & kArray) == 0) {
-                for (uint32_t j = 0; j < type.fieldCount; j++) {
-                    auto& field = type.fields[j];
-                    delete[] field.name;
-                }
                 delete[] type.fields;
                 delete[] type.statics;
             }
-            delete[] type.name;
-            delete[] type.assemblyName;
         }
         delete[] snapshot->metadata.types;
+        delete[] snapshot->metadata.strings;
         snapshot->metadata.types = nullptr;
+        snapshot->metadata.strings = nullptr;
         snapshot->metadata.typeCount = 0;
     }
 }
 
+static void AddStage(const char* name, std::int64_t begin, std::int64_t end, std::uint64_t bytes) {
+    UMPTraceEvent event;
+    event.name_ = name;
+    event.thread_ = UMPTraceRecorder::CurrentThread();
+    event.start_ = begin;
+    event.duration_ = end - begin;
+    if (bytes > 0)
+        event.counters_.emplace_back("bytes", bytes);
+    UMPTraceRecorder::Add(std::move(event));
+}
+
+// the agent's stages are timed from the moment it got the request, the trip of the request itself is left out
+static void ReadAgentTimings(bufferreader& reader, std::int64_t requestTime) {
+    if (reader.atEnd())
+        return;
+    std::uint32_t magic = 0, count = 0;
+    reader >> magic;
+    if (magic != kSnapshotTimingsMagicBytes)
+        return;
+    reader >> count;
+    for (std::uint32_t i = 0; i < count && !reader.atEnd(); i++) {
+        char* name = nullptr;
+        std::uint64_t start = 0, duration = 0, bytes = 0;
+        reader >> name >> start >> duration >> bytes;
+        UMPTraceEvent event;
+        event.name_ = name != nullptr ? name : "";
+        delete[] name;
+        event.process_ = UMPTraceProcess::AGENT;
+        event.start_ = requestTime + static_cast<std::int64_t>(start);
+        event.duration_ = static_cast<std::int64_t>(duration);
+        if (bytes > 0)
+            event.counters_.emplace_back("bytes", bytes);
+        UMPTraceRecorder::Add(std::move(event));
+    }
+}
+
 #define BUFFER_SIZE 65535
 
 RemoteProcess::RemoteProcess(QObject* parent)
@@ -98,22 +131,29 @@ void RemoteProcess::Disconnect() {
 
 void RemoteProcess::Send(UMPMessageType type) {
     auto typeData = static_cast<std::uint32_t>(type);
+    requestTime_ = UMPTraceRecorder::Now();
     socket_->write(reinterpret_cast<const char*>(&typeData), 4);
 }
 
 void RemoteProcess::Interpret(const QByteArray& bytes) {
     auto packetSize = bytes.size();
+    AddStage("wait", requestTime_, packetTime_, 0);
+    AddStage("receive", packetTime_, UMPTraceRecorder::Now(), static_cast<std::uint64_t>(packetSize));
     if (!DecodeData(bytes.data(), static_cast<std::size_t>(packetSize))) {
-        qDebug() << "Decode failed";
+        UMPLOGE("Decode failed");
         Il2CppFreeMemorySnapshot(snapShot_);
+        // no snapshot will come of it, drop the stages so the next capture starts clean
+        UMPTraceRecorder::EndCapture();
         return;
     }
-    qDebug() << "Snapshot heaps: " << snapShot_->heap.sectionCount << " stacks " << snapShot_->stacks.stackCount << " types " <<
-                snapShot_->metadata.typeCount << " gcHandles " << snapShot_->gcHandles.trackedObjectCount;
+    UMPLOGI(QString("Snapshot heaps: %1 stacks %2 types %3 gcHandles %4").arg(snapShot_->heap.sectionCount)
+            .arg(snapShot_->stacks.stackCount).arg(snapShot_->metadata.typeCount).arg(snapShot_->gcHandles.trackedObjectCount));
     emit DataReceived();
 }
 
 bool RemoteProcess::DecodeData(const char* data, size_t size) {
+    UMPScopedTimer timer("decode");
+    timer.AddCounter("bytes", size);
     Il2CppFreeMemorySnapshot(snapShot_);
     if (size < 8)
         return false;
@@ -121,11 +161,11 @@ bool RemoteProcess::DecodeData(const char* data, size_t size) {
     std::uint32_t magic, version;
     reader >> magic >> version;
     if (magic != kSnapshotMagicBytes) {
-        qDebug() << "Invalide MagicBytes!" << magic << kSnapshotMagicBytes;
+        UMPLOGE(QString("Invalid magic bytes %1, expected %2").arg(magic, 0, 16).arg(kSnapshotMagicBytes, 0, 16));
         return false;
     }
     if (version > kSnapshotFormatVersion) {
-        qDebug() << "Version Missmatch!";
+        UMPLOGE(QString("Snapshot format %1 is newer than %2").arg(version).arg(kSnapshotFormatVersion));
         return false;
     }
     while (!reader.atEnd()) {
@@ -149,6 +189,9 @@ bool RemoteProcess::DecodeData(const char* data, size_t size) {
                 reader.read(reinterpret_cast<char*>(section.sectionBytes), section.sectionSize);
             }
         } else if (magic == kSnapshotMetadataMagicBytes) {
+            // names are read into one block, pointers into it are set once it stops growing
+            std::vector<char> strings;
+            std::vector<std::uint32_t> nameOffsets;
             reader >> snapShot_->metadata.typeCount;
             snapShot_->metadata.types = new Il2CppMetadataType[snapShot_->metadata.typeCount];
             for (std::uint32_t i = 0; i < snapShot_->metadata.typeCount; i++) {
@@ -161,7 +204,9 @@ bool RemoteProcess::DecodeData(const char* data, size_t size) {
                     type.fields = new Il2CppMetadataField[type.fieldCount];
                     for (uint32_t j = 0; j < type.fieldCount; j++) {
                         auto& field = type.fields[j];
-                        reader >> field.offset >> field.typeIndex >> field.name >> field.isStatic;
+                        reader >> field.offset >> field.typeIndex;
+                        nameOffsets.push_back(reader.readString(strings));
+                        reader >> field.isStatic;
                     }
                     reader >> type.staticsSize;
                     type.statics = new std::uint8_t[type.staticsSize];
@@ -172,7 +217,19 @@ bool RemoteProcess::DecodeData(const char* data, size_t size) {
                     type.fields = nullptr;
                     type.fieldCount = 0;
                 }
-                reader >> type.name >> type.assemblyName >> type.typeInfoAddress >> type.size;
+                nameOffsets.push_back(reader.readString(strings));
+                nameOffsets.push_back(reader.readString(strings));
+                reader >> type.typeInfoAddress >> type.size;
+            }
+            snapShot_->metadata.strings = new char[strings.size()];
+            memcpy(snapShot_->metadata.strings, strings.data(), strings.size());
+            auto nameOffset = nameOffsets.begin();
+            for (std::uint32_t i = 0; i < snapShot_->metadata.typeCount; i++) {
+                auto& type = snapShot_->metadata.types[i];
+                for (uint32_t j = 0; j < type.fieldCount; j++)
+                    type.fields[j].name = snapShot_->metadata.strings + *nameOffset++;
+                type.name = snapShot_->metadata.strings + *nameOffset++;
+                type.assemblyName = snapShot_->metadata.strings + *nameOffset++;
             }
         } else if (magic == kSnapshotGCHandlesMagicBytes) {
             reader >> snapShot_->gcHandles.trackedObjectCount;
@@ -185,9 +242,10 @@ bool RemoteProcess::DecodeData(const char* data, size_t size) {
                     snapShot_->runtimeInformation.arrayHeaderSize >> snapShot_->runtimeInformation.arrayBoundsOffsetInHeader >>
                     snapShot_->runtimeInformation.arraySizeOffsetInHeader >> snapShot_->runtimeInformation.allocationGranularity;
         } else if (magic == kSnapshotTailMagicBytes) {
+            ReadAgentTimings(reader, requestTime_);
             break;
         } else {
-            qDebug() << "Unknown Section!";
+            UMPLOGE(QString("Unknown section %1").arg(magic, 0, 16));
             return false;
         }
     }
@@ -203,6 +261,7 @@ void RemoteProcess::OnDataReceived() {
     while (remainBytes > 0) {
         if (packetSize_ == 0) {
             packetSize_ = *reinterpret_cast<quint32*>(buffer_ + bufferPos);
+            packetTime_ = UMPTraceRecorder::Now();
 //            qDebug() << "receiving: " <<  packetSize_;
             remainBytes -= 4;
             bufferPos = size - remainBytes;
@@ -245,5 +304,7 @@ void RemoteProcess::OnConnected() {
 void RemoteProcess::OnDisconnected() {
     connectingServer_ = false;
     serverConnected_ = false;
+    // a capture in flight is lost with the connection
+    UMPTraceRecorder::EndCapture();
     emit ConnectionLost();
 }
@@ -0,0 +1,566 @@
+#include "umpanalyzer.h"
+
+#include <QMap>
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+#include "umpcrawler.h"
+#include "umpparallel.h"
+
+const std::uint64_t kHashPrime1 = 0x9E3779B185EBCA87ULL;
+const std::uint64_t kHashPrime2 = 0xC2B2AE3D27D4EB4FULL;
+
+inline std::uint64_t ReadWord(const std::uint8_t* data) {
+    std::uint64_t word;
+    memcpy(&word, data, sizeof(word));
+    return word;
+}
+
+inline std::uint64_t MixLane(std::uint64_t lane, std::uint64_t word) {
+    lane ^= word * kHashPrime2;
+    lane = (lane << 31) | (lane >> 33);
+    return lane * kHashPrime1;
+}
+
+std::uint64_t UMPHashBytes(const std::uint8_t* data, std::size_t size) {
+    std::uint64_t lanes[4] = { kHashPrime1, kHashPrime2, ~kHashPrime1, ~kHashPrime2 };
+    std::size_t i = 0;
+    for (; i + 32 <= size; i += 32) {
+        for (int lane = 0; lane < 4; lane++)
+            lanes[lane] = MixLane(lanes[lane], ReadWord(data + i + lane * 8));
+    }
+    auto hash = static_cast<std::uint64_t>(size) * kHashPrime1;
+    for (int lane = 0; lane < 4; lane++)
+        hash = MixLane(hash, lanes[lane]);
+    for (; i + 8 <= size; i += 8)
+        hash = MixLane(hash, ReadWord(data + i));
+    if (i < size) {
+        std::uint64_t tail = 0;
+        memcpy(&tail, data + i, size - i);
+        hash = MixLane(hash, tail);
+    }
+    // murmur3 finalizer
+    hash ^= hash >> 33;
+    hash *= 0xFF51AFD7ED558CCDULL;
+    hash ^= hash >> 33;
+    hash *= 0xC4CEB9FE1A85EC53ULL;
+    hash ^= hash >> 33;
+    return hash;
+}
+
+struct Payload {
+    const std::uint8_t* data_ = nullptr;
+    std::size_t size_ = 0;
+    // equal bytes of different types (byte[8], int[2], long[1]) aren't duplicates of each other
+    std::uint32_t typeIndex_ = 0;
+    // read from the heap, managedObjects_ sizes are growth in a diff
+    std::int64_t objectSize_ = 0;
+};
+
+// size of the object at bo by the crawler's rules, 0 if the header doesn't describe a believable object
+static std::uint64_t HeapObjectSize(const CrawledMemorySnapshot* snapshot, const BytesAndOffset& bo, const TypeDescription& type) {
+    auto& runtime = snapshot->runtimeInformation_;
+    std::uint64_t size = 0;
+    if (type.IsArray()) {
+        std::int64_t length = 0;
+        auto bounds = bo.Add(runtime.arrayBoundsOffsetInHeader).ReadPointer();
+        if (bounds == 0) {
+            length = bo.Add(runtime.arraySizeOffsetInHeader).ReadInt32();
+        } else {
+            // garbage may point anywhere, only follow bounds that are inside the heap
+            auto cursor = CrawledMemorySnapshot::FindInHeap(snapshot, bounds);
+            auto boundsEnd = CrawledMemorySnapshot::FindInHeap(snapshot, bounds + static_cast<std::uint64_t>(type.ArrayRank()) * 8 - 1);
+            if (!cursor.IsValid() || boundsEnd.bytes_ != cursor.bytes_)
+                return 0;
+            length = 1;
+            for (int i = 0; i < type.ArrayRank() && length >= 0 && length <= std::numeric_limits<std::int32_t>::max(); i++) {
+                length *= cursor.ReadInt32();
+                cursor = cursor.Add(8);
+            }
+        }
+        if (length < 0 || length > std::numeric_limits<std::int32_t>::max())
+            return 0;
+        auto& elementType = snapshot->typeCatalog_->types_[type.baseOrElementTypeIndex_];
+        auto elementSize = elementType.IsValueType() ? static_cast<std::uint64_t>(elementType.size_) : runtime.pointerSize;
+        size = runtime.arrayHeaderSize + elementSize * static_cast<std::uint64_t>(length);
+    } else if (type.primitiveKind_ == PrimitiveKind::kString) {
+        auto length = bo.Add(runtime.objectHeaderSize).ReadInt32();
+        if (length < 0)
+            return 0;
+        size = runtime.objectHeaderSize + 4 + 2 * (static_cast<std::uint64_t>(length) + 1);
+    } else {
+        if (type.size_ < static_cast<std::int64_t>(runtime.objectHeaderSize))
+            return 0;
+        size = static_cast<std::uint64_t>(type.size_);
+    }
+    auto granularity = runtime.allocationGranularity;
+    return granularity > 1 ? (size + granularity - 1) / granularity * granularity : size;
+}
+
+// dataSize bytes at dataOffset into the object at bo, empty if they run past the object or its heap section
+static Payload PayloadInHeap(const CrawledMemorySnapshot* snapshot, const BytesAndOffset& bo, const ManagedObject& managed,
+                             std::uint64_t dataOffset, std::uint64_t dataSize) {
+    Payload payload;
+    auto objectSize = HeapObjectSize(snapshot, bo, *managed.typeDescription_);
+    if (objectSize == 0 || dataOffset + dataSize > objectSize)
+        return payload;
+    auto dataEnd = CrawledMemorySnapshot::FindInHeap(snapshot, managed.address_ + dataOffset + dataSize - 1);
+    if (dataEnd.bytes_ != bo.bytes_)
+        return payload;
+    auto data = bo.Add(dataOffset);
+    payload.data_ = data.bytes_ + data.offset_;
+    payload.size_ = static_cast<std::size_t>(dataSize);
+    payload.typeIndex_ = managed.typeDescription_->typeIndex_;
+    payload.objectSize_ = static_cast<std::int64_t>(objectSize);
+    return payload;
+}
+
+// hash every candidate's payload in parallel, sort by hash and split equal hashes by exact content
+template<typename PayloadOf>
+void FindDuplicates(const CrawledMemorySnapshot* snapshot, const std::vector<std::uint32_t>& candidates,
+                    PayloadOf payloadOf, std::vector<UMPDuplicateGroup>& outGroups) {
+    auto count = candidates.size();
+    std::vector<Payload> payloads(count);
+    std::vector<std::uint64_t> hashes(count);
+    UMPParallelChunks(count, [&](std::size_t, std::size_t begin, std::size_t end) {
+        for (std::size_t i = begin; i < end; i++) {
+            payloads[i] = payloadOf(candidates[i]);
+            if (payloads[i].data_ != nullptr)
+                hashes[i] = MixLane(UMPHashBytes(payloads[i].data_, payloads[i].size_), payloads[i].typeIndex_);
+        }
+    });
+    std::vector<std::uint32_t> order;
+    order.reserve(count);
+    for (std::size_t i = 0; i < count; i++) {
+        if (payloads[i].data_ != nullptr)
+            order.push_back(static_cast<std::uint32_t>(i));
+    }
+    UMPParallelSort(order, [&](std::uint32_t a, std::uint32_t b) {
+        return hashes[a] != hashes[b] ? hashes[a] < hashes[b] : a < b;
+    });
+    std::vector<UMPDuplicateGroup> runGroups;
+    std::vector<std::uint32_t> representatives;
+    for (std::size_t begin = 0; begin < order.size();) {
+        auto end = begin + 1;
+        while (end < order.size() && hashes[order[end]] == hashes[order[begin]])
+            end++;
+        if (end - begin > 1) {
+            runGroups.clear();
+            representatives.clear();
+            for (auto i = begin; i < end; i++) {
+                auto& payload = payloads[order[i]];
+                std::size_t group = 0;
+                for (; group < representatives.size(); group++) {
+                    auto& other = payloads[representatives[group]];
+                    if (other.typeIndex_ == payload.typeIndex_ && other.size_ == payload.size_ &&
+                        memcmp(other.data_, payload.data_, payload.size_) == 0)
+                        break;
+                }
+                if (group == representatives.size()) {
+                    representatives.push_back(order[i]);
+                    runGroups.push_back(UMPDuplicateGroup());
+                }
+                runGroups[group].objects_.push_back(candidates[order[i]]);
+            }
+            for (std::size_t i = 0; i < runGroups.size(); i++) {
+                auto& group = runGroups[i];
+                if (group.objects_.size() < 2)
+                    continue;
+                group.instanceSize_ = payloads[representatives[i]].objectSize_;
+                group.wastedSize_ = group.instanceSize_ * static_cast<std::int64_t>(group.objects_.size() - 1);
+                outGroups.push_back(std::move(group));
+            }
+        }
+        begin = end;
+    }
+    std::sort(outGroups.begin(), outGroups.end(), [](const UMPDuplicateGroup& a, const UMPDuplicateGroup& b) {
+        return a.wastedSize_ > b.wastedSize_;
+    });
+}
+
+void UMPFindDuplicateStrings(const CrawledMemorySnapshot* snapshot, std::vector<UMPDuplicateGroup>& outGroups) {
+    outGroups.clear();
+    std::vector<std::uint32_t> strings;
+    for (std::size_t i = 0; i < snapshot->managedObjects_.size(); i++) {
+        if (snapshot->managedObjects_[i].typeDescription_->primitiveKind_ == PrimitiveKind::kString)
+            strings.push_back(static_cast<std::uint32_t>(i));
+    }
+    auto headerSize = snapshot->runtimeInformation_.objectHeaderSize;
+    FindDuplicates(snapshot, strings, [&](std::uint32_t index) {
+        auto& managed = snapshot->managedObjects_[index];
+        auto bo = CrawledMemorySnapshot::FindInHeap(snapshot, managed.address_);
+        if (!bo.IsValid())
+            return Payload();
+        auto length = bo.Add(headerSize).ReadInt32();
+        if (length < 0)
+            return Payload();
+        // utf-16 characters follow the length
+        return PayloadInHeap(snapshot, bo, managed, headerSize + 4, static_cast<std::uint64_t>(length) * 2);
+    }, outGroups);
+}
+
+void UMPFindDuplicateArrays(const CrawledMemorySnapshot* snapshot, std::vector<UMPDuplicateGroup>& outGroups) {
+    outGroups.clear();
+    std::vector<std::uint32_t> arrays;
+    for (std::size_t i = 0; i < snapshot->managedObjects_.size(); i++) {
+        auto type = snapshot->managedObjects_[i].typeDescription_;
+        if (type->IsArray() && snapshot->typeCatalog_->types_[type->baseOrElementTypeIndex_].IsValueType())
+            arrays.push_back(static_cast<std::uint32_t>(i));
+    }
+    auto headerSize = snapshot->runtimeInformation_.arrayHeaderSize;
+    FindDuplicates(snapshot, arrays, [&](std::uint32_t index) {
+        auto& managed = snapshot->managedObjects_[index];
+        auto bo = CrawledMemorySnapshot::FindInHeap(snapshot, managed.address_);
+        if (!bo.IsValid())
+            return Payload();
+        auto length = CrawledMemorySnapshot::ReadArrayLength(snapshot, managed.address_, managed.typeDescription_);
+        auto elementSize = snapshot->typeCatalog_->types_[managed.typeDescription_->baseOrElementTypeIndex_].size_;
+        if (length < 0 || elementSize < 0)
+            return Payload();
+        return PayloadInHeap(snapshot, bo, managed, headerSize,
+                             static_cast<std::uint64_t>(length) * static_cast<std::uint64_t>(elementSize));
+    }, outGroups);
+}
+
+void UMPSummarizeDuplicatesByType(const CrawledMemorySnapshot* snapshot, const std::vector<UMPDuplicateGroup>& groups,
+                                  std::vector<UMPDuplicateTypeSummary>& outSummaries) {
+    outSummaries.clear();
+    std::vector<std::uint32_t> summaryOfType(snapshot->typeCatalog_->types_.size(), std::numeric_limits<std::uint32_t>::max());
+    for (auto& group : groups) {
+        auto typeIndex = snapshot->managedObjects_[group.objects_[0]].typeDescription_->typeIndex_;
+        auto& summaryIndex = summaryOfType[typeIndex];
+        if (summaryIndex == std::numeric_limits<std::uint32_t>::max()) {
+            summaryIndex = static_cast<std::uint32_t>(outSummaries.size());
+            UMPDuplicateTypeSummary summary;
+            summary.typeIndex_ = typeIndex;
+            outSummaries.push_back(summary);
+        }
+        auto& summary = outSummaries[summaryIndex];
+        summary.groupCount_++;
+        summary.copyCount_ += static_cast<std::uint32_t>(group.objects_.size() - 1);
+        summary.wastedSize_ += group.wastedSize_;
+    }
+    std::sort(outSummaries.begin(), outSummaries.end(), [](const UMPDuplicateTypeSummary& a, const UMPDuplicateTypeSummary& b) {
+        return a.wastedSize_ > b.wastedSize_;
+    });
+}
+
+QString UMPNamespaceOf(const QString& typeName) {
+    auto end = typeName.size();
+    for (int i = 0; i < typeName.size(); i++) {
+        if (typeName[i] == '<' || typeName[i] == '[') {
+            end = i;
+            break;
+        }
+    }
+    auto dot = typeName.lastIndexOf('.', end - 1);
+    return dot > 0 ? typeName.left(dot) : QString();
+}
+
+void UMPBuildRollup(const CrawledMemorySnapshot* snapshot, std::vector<UMPRollupNode>& outNodes) {
+    outNodes.clear();
+    auto typeCount = snapshot->typeCatalog_->types_.size();
+    // per type totals
+    std::vector<std::uint32_t> counts(typeCount, 0);
+    std::vector<std::int64_t> sizes(typeCount, 0);
+    for (auto& statics : snapshot->staticFields_) {
+        counts[statics.typeDescription_->typeIndex_]++;
+        sizes[statics.typeDescription_->typeIndex_] += statics.size_;
+    }
+    for (auto& root : snapshot->staticFieldRoots_) {
+        counts[root.typeDescription_->typeIndex_]++;
+        sizes[root.typeDescription_->typeIndex_] += root.size_;
+    }
+    for (auto& managed : snapshot->managedObjects_) {
+        counts[managed.typeDescription_->typeIndex_]++;
+        sizes[managed.typeDescription_->typeIndex_] += managed.size_;
+    }
+    // tree of the types that have anything, totals added on the way up
+    outNodes.push_back(UMPRollupNode());
+    outNodes[0].name_ = snapshot->name_;
+    QMap<QString, std::uint32_t> assemblies;
+    QMap<QString, std::uint32_t> namespaces; // by assembly + '/' + namespace
+    std::vector<std::uint32_t> nodeOfType(typeCount, 0);
+    auto addNode = [&outNodes](std::uint32_t parent, UMPRollupLevel level, const QString& name) {
+        auto index = static_cast<std::uint32_t>(outNodes.size());
+        outNodes.push_back(UMPRollupNode());
+        outNodes.back().name_ = name;
+        outNodes.back().level_ = level;
+        outNodes.back().parent_ = parent;
+        outNodes[parent].children_.push_back(index);
+        return index;
+    };
+    for (std::size_t i = 0; i < typeCount; i++) {
+        if (counts[i] == 0)
+            continue;
+        auto& type = snapshot->typeCatalog_->types_[i];
+        auto assemblyName = snapshot->typeCatalog_->AssemblyName(type);
+        auto typeName = snapshot->typeCatalog_->TypeName(type);
+        auto assemblyIt = assemblies.find(assemblyName);
+        if (assemblyIt == assemblies.end())
+            assemblyIt = assemblies.insert(assemblyName, addNode(0, UMPRollupLevel::kAssembly, assemblyName));
+        auto ns = UMPNamespaceOf(typeName);
+        auto namespaceKey = assemblyName + '/' + ns;
+        auto namespaceIt = namespaces.find(namespaceKey);
+        if (namespaceIt == namespaces.end())
+            namespaceIt = namespaces.insert(namespaceKey, addNode(assemblyIt.value(), UMPRollupLevel::kNamespace, ns.isEmpty() ? "<global>" : ns));
+        auto typeNode = addNode(namespaceIt.value(), UMPRollupLevel::kType, typeName);
+        outNodes[typeNode].typeIndex_ = static_cast<std::uint32_t>(i);
+        nodeOfType[i] = typeNode;
+        for (auto node = typeNode;; node = outNodes[node].parent_) {
+            outNodes[node].count_ += counts[i];
+            outNodes[node].shallowSize_ += sizes[i];
+            if (node == 0)
+                break;
+        }
+    }
+    // retained sizes, depth first over the dominator tree while counting how many objects of every node are
+    // on the current path, an object only adds its retained size to the nodes it is the topmost member of
+    auto thingCount = snapshot->allObjects_.size();
+    std::vector<std::uint32_t> childOffsets(thingCount + 1, 0);
+    for (std::size_t i = 0; i < thingCount; i++) {
+        auto dominator = snapshot->immediateDominators_[i];
+        if (dominator != kNoDominator)
+            childOffsets[dominator + 1]++;
+    }
+    for (std::size_t i = 0; i < thingCount; i++)
+        childOffsets[i + 1] += childOffsets[i];
+    std::vector<std::uint32_t> children(childOffsets[thingCount]);
+    {
+        auto cursor = childOffsets;
+        for (std::size_t i = 0; i < thingCount; i++) {
+            auto dominator = snapshot->immediateDominators_[i];
+            if (dominator != kNoDominator)
+                children[cursor[dominator]++] = static_cast<std::uint32_t>(i);
+        }
+    }
+    auto typeNodeOf = [&](std::uint32_t index) -> std::uint32_t {
+        auto thing = snapshot->allObjects_[index];
+        if (thing->type() == ThingType::MANAGED)
+            return nodeOfType[static_cast<const ManagedObject*>(thing)->typeDescription_->typeIndex_];
+        if (thing->type() == ThingType::STATIC)
+            return nodeOfType[static_cast<const StaticFields*>(thing)->typeDescription_->typeIndex_];
+        if (thing->type() == ThingType::STATIC_FIELD)
+            return nodeOfType[static_cast<const StaticFieldRoot*>(thing)->typeDescription_->typeIndex_];
+        return 0; // gchandles and stacks only count toward the snapshot total
+    };
+    std::vector<std::uint32_t> onPath(outNodes.size(), 0);
+    auto enter = [&](std::uint32_t index, int delta) {
+        auto node = typeNodeOf(index);
+        for (;; node = outNodes[node].parent_) {
+            if (delta > 0 && onPath[node]++ == 0)
+                outNodes[node].retainedSize_ += snapshot->retainedSizes_[index];
+            else if (delta < 0)
+                onPath[node]--;
+            if (node == 0)
+                break;
+        }
+    };
+    std::vector<std::pair<std::uint32_t, std::uint32_t>> stack; // (thing, next child)
+    for (std::size_t i = 0; i < thingCount; i++) {
+        if (snapshot->immediateDominators_[i] != kNoDominator)
+            continue;
+        stack.push_back(std::make_pair(static_cast<std::uint32_t>(i), childOffsets[i]));
+        enter(static_cast<std::uint32_t>(i), 1);
+        while (!stack.empty()) {
+            auto& top = stack.back();
+            if (top.second < childOffsets[top.first + 1]) {
+                auto child = children[top.second++];
+                stack.push_back(std::make_pair(child, childOffsets[child]));
+                enter(child, 1);
+                continue;
+            }
+            enter(top.first, -1);
+            stack.pop_back();
+        }
+    }
+    for (auto& node : outNodes) {
+        std::sort(node.children_.begin(), node.children_.end(), [&outNodes](std::uint32_t a, std::uint32_t b) {
+            return outNodes[a].retainedSize_ > outNodes[b].retainedSize_;
+        });
+    }
+}
+
+static void AddHole(UMPFragmentationReport& report, UMPSectionOccupancy& section, std::uint64_t size) {
+    if (size == 0)
+        return;
+    section.holeCount_++;
+    section.freeSize_ += size;
+    section.largestHole_ = std::max(section.largestHole_, size);
+    std::size_t bucket = 0;
+    while (bucket + 1 < kHoleBuckets && (size >> (bucket + 1)) != 0)
+        bucket++;
+    report.holeCounts_[bucket]++;
+    report.holeSizes_[bucket] += size;
+}
+
+// spreads [begin, end) of live bytes over the heat strip cells it covers
+static void AddLiveRange(UMPSectionOccupancy& section, std::uint64_t begin, std::uint64_t end) {
+    auto cellSize = static_cast<double>(section.size_) / kHeatStripCells;
+    auto first = static_cast<std::size_t>((begin - section.start_) / cellSize);
+    auto last = std::min(kHeatStripCells - 1, static_cast<std::size_t>((end - 1 - section.start_) / cellSize));
+    for (auto cell = first; cell <= last; cell++) {
+        auto cellBegin = section.start_ + static_cast<std::uint64_t>(cell * cellSize);
+        auto cellEnd = cell + 1 == kHeatStripCells ? section.start_ + section.size_ : section.start_ + static_cast<std::uint64_t>((cell + 1) * cellSize);
+        auto coveredBegin = std::max(begin, cellBegin);
+        auto coveredEnd = std::min(end, cellEnd);
+        if (coveredEnd > coveredBegin)
+            section.cells_[cell] += static_cast<float>(static_cast<double>(coveredEnd - coveredBegin) / static_cast<double>(cellEnd - cellBegin));
+    }
+}
+
+void UMPAnalyzeFragmentation(const CrawledMemorySnapshot* snapshot, UMPFragmentationReport& outReport) {
+    outReport = UMPFragmentationReport();
+    std::fill(outReport.holeCounts_, outReport.holeCounts_ + kHoleBuckets, 0);
+    std::fill(outReport.holeSizes_, outReport.holeSizes_ + kHoleBuckets, 0);
+    auto& heap = snapshot->managedHeap_;
+    auto& addresses = snapshot->sortedAddresses_;
+    std::size_t object = 0;
+    for (std::size_t i = 0; i < heap.size(); i++) {
+        UMPSectionOccupancy section;
+        section.section_ = static_cast<std::uint32_t>(i);
+        section.start_ = heap[i].sectionStartAddress_;
+        section.size_ = heap[i].sectionSize_;
+        std::fill(section.cells_, section.cells_ + kHeatStripCells, 0.0f);
+        auto end = section.start_ + section.size_;
+        // objects below the section belong to none
+        while (object < addresses.size() && addresses[object] < section.start_)
+            object++;
+        auto cursor = section.start_;
+        for (; object < addresses.size() && addresses[object] < end; object++) {
+            auto& managed = snapshot->managedObjects_[snapshot->sortedObjects_[object]];
+            if (managed.size_ <= 0)
+                continue;
+            auto objectBegin = std::max(cursor, managed.address_);
+            auto objectEnd = std::min(end, managed.address_ + static_cast<std::uint64_t>(managed.size_));
+            section.objectCount_++;
+            if (objectEnd <= objectBegin)
+                continue;
+            AddHole(outReport, section, objectBegin - cursor);
+            section.liveSize_ += objectEnd - objectBegin;
+            AddLiveRange(section, objectBegin, objectEnd);
+            cursor = objectEnd;
+        }
+        AddHole(outReport, section, end - cursor);
+        outReport.heapSize_ += section.size_;
+        outReport.liveSize_ += section.liveSize_;
+        outReport.largestHole_ = std::max(outReport.largestHole_, section.largestHole_);
+        outReport.sections_.push_back(section);
+    }
+}
+
+void UMPWalkHeap(const CrawledMemorySnapshot* snapshot, UMPHeapWalkReport& outReport) {
+    outReport = UMPHeapWalkReport();
+    auto& runtime = snapshot->runtimeInformation_;
+    auto typeCount = snapshot->typeCatalog_->types_.size();
+    // class pointer -> type, value types never start a heap object
+    std::vector<std::pair<std::uint64_t, std::uint32_t>> classes;
+    for (auto& type : snapshot->typeCatalog_->types_) {
+        if (!type.IsValueType())
+            classes.push_back(std::make_pair(snapshot->typeInfoAddresses_[type.typeIndex_], type.typeIndex_));
+    }
+    std::sort(classes.begin(), classes.end());
+    auto step = std::max<std::uint64_t>(std::max(runtime.allocationGranularity, runtime.pointerSize), 1);
+    auto& heap = snapshot->managedHeap_;
+    auto& addresses = snapshot->sortedAddresses_;
+    auto chunkCount = std::max<std::size_t>(1, std::min(heap.size(), UMPThreadCount()));
+    std::vector<std::uint32_t> counts(chunkCount * typeCount, 0);
+    std::vector<std::uint64_t> sizes(chunkCount * typeCount, 0);
+    std::vector<UMPHeapWalkReport> chunkTotals(chunkCount);
+    UMPParallelChunks(heap.size(), chunkCount, [&](std::size_t chunk, std::size_t begin, std::size_t end) {
+        auto chunkCounts = counts.data() + chunk * typeCount;
+        auto chunkSizes = sizes.data() + chunk * typeCount;
+        auto& totals = chunkTotals[chunk];
+        for (auto i = begin; i < end; i++) {
+            auto& section = heap[i];
+            BytesAndOffset bo;
+            bo.bytes_ = section.sectionBytes_;
+            bo.offset_ = 0;
+            bo.pointerSize_ = runtime.pointerSize;
+            std::uint64_t sectionEnd = section.sectionSize_;
+            auto next = static_cast<std::size_t>(std::lower_bound(addresses.begin(), addresses.end(), section.sectionStartAddress_) - addresses.begin());
+            std::uint64_t cursor = 0;
+            while (cursor + runtime.objectHeaderSize <= sectionEnd) {
+                auto address = section.sectionStartAddress_ + cursor;
+                while (next < addresses.size() && addresses[next] < address)
+                    next++;
+                // the crawler already knows what starts here
+                auto nextReachable = next < addresses.size() ? addresses[next] - section.sectionStartAddress_ : sectionEnd;
+                if (next < addresses.size() && addresses[next] == address) {
+                    auto& managed = snapshot->managedObjects_[snapshot->sortedObjects_[next]];
+                    totals.reachableCount_++;
+                    totals.reachableSize_ += static_cast<std::uint64_t>(std::max<std::int64_t>(managed.size_, 0));
+                    cursor += std::max<std::uint64_t>(step, static_cast<std::uint64_t>(std::max<std::int64_t>(managed.size_, 0)));
+                    continue;
+                }
+                bo.offset_ = cursor;
+                // reachable headers carry the crawler's mark in the low bit
+                auto klass = bo.ReadPointer() & ~static_cast<std::uint64_t>(1);
+                auto it = std::lower_bound(classes.begin(), classes.end(), std::make_pair(klass, std::uint32_t(0)));
+                // the largest header has to fit before any size rule reads from it
+                if (klass != 0 && it != classes.end() && it->first == klass && cursor + runtime.arrayHeaderSize <= sectionEnd) {
+                    auto size = HeapObjectSize(snapshot, bo, snapshot->typeCatalog_->types_[it->second]);
+                    if (size > 0 && cursor + size <= std::min(sectionEnd, nextReachable)) {
+                        chunkCounts[it->second]++;
+                        chunkSizes[it->second] += size;
+                        totals.unreachableCount_++;
+                        totals.unreachableSize_ += size;
+                        cursor += size;
+                        continue;
+                    }
+                }
+                cursor += step;
+            }
+        }
+    });
+    for (auto& totals : chunkTotals) {
+        outReport.reachableCount_ += totals.reachableCount_;
+        outReport.reachableSize_ += totals.reachableSize_;
+        outReport.unreachableCount_ += totals.unreachableCount_;
+        outReport.unreachableSize_ += totals.unreachableSize_;
+    }
+    for (std::size_t type = 0; type < typeCount; type++) {
+        UMPUnreachableTypeSummary summary;
+        summary.typeIndex_ = static_cast<std::uint32_t>(type);
+        for (std::size_t chunk = 0; chunk < chunkCount; chunk++) {
+            summary.count_ += counts[chunk * typeCount + type];
+            summary.size_ += sizes[chunk * typeCount + type];
+        }
+        if (summary.count_ > 0)
+            outReport.types_.push_back(summary);
+    }
+    std::sort(outReport.types_.begin(), outReport.types_.end(), [](const UMPUnreachableTypeSummary& a, const UMPUnreachableTypeSummary& b) {
+        return a.size_ > b.size_;
+    });
+}
+
+void UMPBuildRootReport(const CrawledMemorySnapshot* snapshot, UMPRootReport& outReport) {
+    outReport = UMPRootReport();
+    auto& dominators = snapshot->immediateDominators_;
+    std::vector<std::uint32_t> counts(snapshot->allObjects_.size(), 0);
+    for (auto index : snapshot->dominatorOrder_)
+        counts[index]++;
+    // every thing comes before its immediate dominator, so its count is final when it is passed up
+    for (auto index : snapshot->dominatorOrder_) {
+        if (dominators[index] != kNoDominator)
+            counts[dominators[index]] += counts[index];
+    }
+    for (auto thing : snapshot->allObjects_) {
+        auto index = thing->index_;
+        if (CrawledMemorySnapshot::IsRoot(thing)) {
+            UMPRootSummary summary;
+            summary.index_ = index;
+            summary.retainedCount_ = counts[index];
+            summary.retainedSize_ = snapshot->retainedSizes_[index];
+            outReport.roots_.push_back(summary);
+        } else if (dominators[index] == kNoDominator && snapshot->rootDistances_[index] != kUnreachableDistance) {
+            outReport.sharedCount_ += counts[index];
+            outReport.sharedSize_ += snapshot->retainedSizes_[index];
+        }
+    }
+    std::sort(outReport.roots_.begin(), outReport.roots_.end(), [](const UMPRootSummary& a, const UMPRootSummary& b) {
+        return a.retainedSize_ > b.retainedSize_;
+    });
+}
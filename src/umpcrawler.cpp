@@ -2,17 +2,36 @@
 
 #include <QTime>
 #include <QDebug>
+#include <QIODevice>
 
+#include <algorithm>
+#include <functional>
+#include <mutex>
+#include <queue>
+
+#include "umpparallel.h"
+#include "umptrace.h"
+
+enum ReferenceScan : std::uint8_t {
+    kReferenceScanUnknown = 0,
+    kReferenceScanPending,
+    kReferenceScanNone,
+    kReferenceScanSome,
+};
+
+// sections are sorted by Crawler::Crawl before any lookup. the crawl can't use the snapshot's object index
+// (sortedAddresses_): that index lists the objects the crawl finds, so it only exists once crawling is done.
+// pointers are resolved to heap bytes by the same UMPFindSection search the snapshot's FindInHeap uses
 BytesAndOffset FindInHeap(Il2CppManagedMemorySnapshot* snapshot, std::uint64_t addr) {
     BytesAndOffset ba;
-    for (std::uint32_t i = 0; i < snapshot->heap.sectionCount; i++) {
-        auto section = snapshot->heap.sections[i];
-        if (addr >= section.sectionStartAddress && addr < (section.sectionStartAddress + static_cast<std::uint64_t>(section.sectionSize))) {
-            ba.bytes_ = section.sectionBytes;
-            ba.offset_ = addr - section.sectionStartAddress;
-            ba.pointerSize_ = snapshot->runtimeInformation.pointerSize;
-            break;
-        }
+    auto i = UMPFindSection(snapshot->heap.sections, snapshot->heap.sectionCount, addr,
+                            [](const Il2CppManagedMemorySection& section) { return section.sectionStartAddress; },
+                            [](const Il2CppManagedMemorySection& section) { return section.sectionSize; });
+    if (i < snapshot->heap.sectionCount) {
+        auto& section = snapshot->heap.sections[i];
+        ba.bytes_ = section.sectionBytes;
+        ba.offset_ = addr - section.sectionStartAddress;
+        ba.pointerSize_ = snapshot->runtimeInformation.pointerSize;
     }
     return ba;
 }
@@ -32,51 +51,201 @@ int ReadArrayLength(Il2CppManagedMemorySnapshot* snapshot, std::uint64_t address
     return length;
 }
 
-int ReadArrayObjectSizeInBytes(Il2CppManagedMemorySnapshot* snapshot, std::uint64_t address, Il2CppMetadataType* arrayType,
-                               const std::vector<Il2CppMetadataType*>& typeDescriptions) {
+std::uint64_t RoundToAllocationGranularity(std::uint64_t size, std::uint32_t granularity) {
+    if (granularity <= 1)
+        return size;
+    return (size + granularity - 1) / granularity * granularity;
+}
+
+std::uint64_t ReadArrayObjectSizeInBytes(Il2CppManagedMemorySnapshot* snapshot, std::uint64_t address, Il2CppMetadataType* arrayType, std::uint32_t elementSize) {
     auto arrayLength = ReadArrayLength(snapshot, address, arrayType);
-    auto elementType = typeDescriptions[arrayType->baseOrElementTypeIndex];
-    auto elementSize = ((elementType->flags & Il2CppMetadataTypeFlags::kValueType) != 0) ? elementType->size : snapshot->runtimeInformation.pointerSize;
-    return static_cast<int>(snapshot->runtimeInformation.arrayHeaderSize + elementSize * static_cast<unsigned int>(arrayLength));
+    if (arrayLength < 0)
+        arrayLength = 0;
+    return snapshot->runtimeInformation.arrayHeaderSize + static_cast<std::uint64_t>(elementSize) * static_cast<std::uint64_t>(arrayLength);
 }
 
-int ReadStringObjectSizeInBytes(BytesAndOffset& bo, Il2CppManagedMemorySnapshot* snapshot) {
-    auto lengthPointer = bo.Add(snapshot->runtimeInformation.objectHeaderSize);
-    auto length = lengthPointer.ReadInt32();
-    return static_cast<std::int32_t>(snapshot->runtimeInformation.objectHeaderSize) + 1 + (length + 2) + 2;
+// header, int32 length, then length utf-16 characters and a terminating zero
+std::uint64_t ReadStringObjectSizeInBytes(BytesAndOffset& bo, Il2CppManagedMemorySnapshot* snapshot) {
+    auto length = bo.Add(snapshot->runtimeInformation.objectHeaderSize).ReadInt32();
+    if (length < 0)
+        length = 0;
+    return snapshot->runtimeInformation.objectHeaderSize + 4 + 2 * (static_cast<std::uint64_t>(length) + 1);
 }
 
 void Crawler::Crawl(PackedCrawlerData& result, Il2CppManagedMemorySnapshot* snapshot) {
+    UMPScopedTimer timer("crawl");
     std::vector<PackedManagedObject> managedObjects;
     std::vector<Connection> connections;
+    std::vector<std::uint32_t> connectionFields;
+    std::uint32_t fieldIdBase = 0;
+    fieldPaths_.clear();
+    fieldPathIndices_.clear();
+    std::sort(snapshot->heap.sections, snapshot->heap.sections + snapshot->heap.sectionCount,
+              [](const Il2CppManagedMemorySection& a, const Il2CppManagedMemorySection& b) {
+        return a.sectionStartAddress < b.sectionStartAddress;
+    });
     for (std::uint32_t i = 0; i < snapshot->metadata.typeCount; i++) {
         auto type = &snapshot->metadata.types[i];
         type->typeIndex = i;
         typeInfoToTypeDescription_.emplace(type->typeInfoAddress, type);
         typeDescriptions_.push_back(type);
+        primitiveKinds_.push_back(PrimitiveKindOf(QString(type->name)));
+        objectKinds_.push_back(CrawledObjectKind::kPlain);
+        if ((type->flags & Il2CppMetadataTypeFlags::kArray) != 0)
+            objectKinds_.back() = CrawledObjectKind::kArray;
+        else if (primitiveKinds_.back() == PrimitiveKind::kString)
+            objectKinds_.back() = CrawledObjectKind::kString;
+        fieldIdBases_.push_back(fieldIdBase);
+        fieldIdBase += type->fieldCount;
+    }
+    referenceScans_.assign(snapshot->metadata.typeCount, kReferenceScanUnknown);
+    // element sizes need every type registered first
+    elementSizes_.assign(snapshot->metadata.typeCount, 0);
+    for (std::uint32_t i = 0; i < snapshot->metadata.typeCount; i++) {
+        if (objectKinds_[i] != CrawledObjectKind::kArray)
+            continue;
+        auto elementType = typeDescriptions_[typeDescriptions_[i]->baseOrElementTypeIndex];
+        elementSizes_[i] = (elementType->flags & Il2CppMetadataTypeFlags::kValueType) != 0 ?
+                    static_cast<std::uint32_t>(elementType->size) : snapshot->runtimeInformation.pointerSize;
+    }
+    // static fields that can hold references become roots of their own
+    result.staticFieldRoots_.clear();
+    for (std::size_t i = 0; i < result.typesWithStaticFields_.size(); i++) {
+        auto typeDescription = result.typesWithStaticFields_[i];
+        for (std::uint32_t j = 0; j < typeDescription->fieldCount; j++) {
+            auto field = &typeDescription->fields[j];
+            // field.offset is Uint in unity source-code
+            if (!field->isStatic || field->offset == static_cast<std::uint32_t>(-1))
+                continue;
+            auto fieldType = typeDescriptions_[field->typeIndex];
+            if ((fieldType->flags & Il2CppMetadataTypeFlags::kValueType) != 0 &&
+                    (fieldType == typeDescription || HasNoReferences(fieldType)))
+                continue;
+            PackedStaticFieldRoot root;
+            root.holder_ = static_cast<std::uint32_t>(i);
+            root.fieldIndex_ = j;
+            root.fieldId_ = fieldIdBases_[typeDescription->typeIndex] + j;
+            result.staticFieldRoots_.push_back(root);
+        }
     }
+    result.startIndices_.staticFieldRootCount_ = static_cast<std::uint32_t>(result.staticFieldRoots_.size());
+    std::vector<std::vector<std::uint64_t>> stackReferences;
+    FindStackReferences(snapshot, stackReferences);
+    UMPScopedTimer rootsTimer("crawl roots");
     // crawl pointers
     for (std::uint32_t i = 0; i < snapshot->gcHandles.trackedObjectCount; i++) {
         auto gcHandle = snapshot->gcHandles.pointersToObjects[i];
-        CrawlPointer(snapshot, result.startIndices_, gcHandle, result.startIndices_.OfFirstGCHandle() + i, connections, managedObjects);
+        CrawlPointer(snapshot, result.startIndices_, gcHandle, result.startIndices_.OfFirstGCHandle() + i, kFieldIdNone,
+                     connections, connectionFields, managedObjects);
     }
-    // crawl raw object data
-    for (std::size_t i = 0; i < result.typesWithStaticFields_.size(); i++) {
-        auto typeDescription = result.typesWithStaticFields_[i];
+    // crawl static fields, a reference field has no name of its own past the root's
+    for (std::size_t i = 0; i < result.staticFieldRoots_.size(); i++) {
+        auto& root = result.staticFieldRoots_[i];
+        auto typeDescription = result.typesWithStaticFields_[root.holder_];
+        auto field = &typeDescription->fields[root.fieldIndex_];
+        auto fieldType = typeDescriptions_[field->typeIndex];
+        auto indexOfFrom = result.startIndices_.OfFirstStaticFieldRoot() + static_cast<std::uint32_t>(i);
         BytesAndOffset ba;
         ba.bytes_ = typeDescription->statics;
-        ba.offset_ = 0;
+        ba.offset_ = field->offset;
         ba.pointerSize_ = snapshot->runtimeInformation.pointerSize;
-        CrawlRawObjectData(snapshot, result.startIndices_, ba, typeDescription,
-                           true, result.startIndices_.OfFirstStaticFields() + static_cast<std::uint32_t>(i), connections, managedObjects);
+        if ((fieldType->flags & Il2CppMetadataTypeFlags::kValueType) != 0)
+            CrawlRawObjectData(snapshot, result.startIndices_, ba, fieldType, false, indexOfFrom, kFieldIdNone,
+                               connections, connectionFields, managedObjects);
+        else
+            CrawlPointer(snapshot, result.startIndices_, ba.ReadPointer(), indexOfFrom, kFieldIdNone, connections, connectionFields, managedObjects);
     }
+    // crawl stacks
+    for (std::size_t i = 0; i < stackReferences.size(); i++) {
+        for (auto pointer : stackReferences[i]) {
+            CrawlPointer(snapshot, result.startIndices_, pointer, result.startIndices_.OfFirstStack() + static_cast<std::uint32_t>(i), kFieldIdNone,
+                         connections, connectionFields, managedObjects);
+        }
+    }
+    rootsTimer.AddCounter("objects", managedObjects.size());
+    rootsTimer.AddCounter("connections", connections.size());
     result.managedObjects_ = std::move(managedObjects);
     result.connections_ = std::move(connections);
+    result.connectionFields_ = std::move(connectionFields);
+    result.fieldPaths_ = std::move(fieldPaths_);
     result.typeDescriptions_ = std::move(typeDescriptions_);
 }
 
-void Crawler::CrawlPointer(Il2CppManagedMemorySnapshot* snapshot, StartIndices startIndices, std::uint64_t pointer, std::uint32_t indexOfFrom,
-                           std::vector<Connection>& outConnections, std::vector<PackedManagedObject>& outManagedObjects) {
+// words of a stack inside [heapBegin, heapBegin + heapSpan) and aligned like an object, tested a block at a time
+// into a bit mask without branches so the compiler can vectorize the range check over millions of words
+template<typename Word>
+static void FindHeapRangeWords(const std::uint8_t* bytes, std::uint64_t size, std::uint64_t heapBegin, std::uint64_t heapSpan,
+                               std::vector<std::uint64_t>& outWords) {
+    const std::size_t kBlockWords = 64;
+    const std::uint64_t alignMask = sizeof(Word) - 1;
+    Word words[kBlockWords];
+    auto count = static_cast<std::size_t>(size / sizeof(Word));
+    for (std::size_t block = 0; block < count; block += kBlockWords) {
+        auto n = std::min(kBlockWords, count - block);
+        memcpy(words, bytes + block * sizeof(Word), n * sizeof(Word));
+        std::uint64_t mask = 0;
+        for (std::size_t j = 0; j < n; j++) {
+            auto word = static_cast<std::uint64_t>(words[j]);
+            mask |= static_cast<std::uint64_t>((word - heapBegin < heapSpan) & ((word & alignMask) == 0)) << j;
+        }
+        for (std::size_t j = 0; mask != 0; j++, mask >>= 1) {
+            if ((mask & 1) != 0)
+                outWords.push_back(words[j]);
+        }
+    }
+}
+
+void Crawler::FindStackReferences(Il2CppManagedMemorySnapshot* snapshot, std::vector<std::vector<std::uint64_t>>& outReferences) {
+    UMPScopedTimer timer("scan stacks");
+    auto stackCount = static_cast<std::size_t>(snapshot->stacks.stackCount);
+    outReferences.assign(stackCount, std::vector<std::uint64_t>());
+    auto& heap = snapshot->heap;
+    if (heap.sectionCount == 0)
+        return;
+    auto heapBegin = heap.sections[0].sectionStartAddress;
+    auto& last = heap.sections[heap.sectionCount - 1];
+    auto heapSpan = last.sectionStartAddress + last.sectionSize - heapBegin;
+    auto pointerSize = snapshot->runtimeInformation.pointerSize;
+    std::uint64_t totalWords = 0;
+    for (std::size_t i = 0; i < stackCount; i++)
+        totalWords += snapshot->stacks.stacks[i].sectionSize / pointerSize;
+    // stacks are scanned in parallel, the lookups below only read the heap and the type table
+    UMPParallelChunks(stackCount, UMPChunkCount(static_cast<std::size_t>(totalWords)), [&](std::size_t, std::size_t begin, std::size_t end) {
+        std::vector<std::uint64_t> words;
+        for (auto i = begin; i < end; i++) {
+            auto& stack = snapshot->stacks.stacks[i];
+            words.clear();
+            if (pointerSize == 4)
+                FindHeapRangeWords<std::uint32_t>(stack.sectionBytes, stack.sectionSize, heapBegin, heapSpan, words);
+            else
+                FindHeapRangeWords<std::uint64_t>(stack.sectionBytes, stack.sectionSize, heapBegin, heapSpan, words);
+            // the range only rules out most words, a candidate has to start an object: room for a header
+            // in its section and a known type info in the first word. interior pointers aren't followed
+            auto& references = outReferences[i];
+            for (auto word : words) {
+                auto section = UMPFindSection(heap.sections, heap.sectionCount, word,
+                                              [](const Il2CppManagedMemorySection& s) { return s.sectionStartAddress; },
+                                              [](const Il2CppManagedMemorySection& s) { return s.sectionSize; });
+                if (section == heap.sectionCount)
+                    continue;
+                auto offset = word - heap.sections[section].sectionStartAddress;
+                if (offset + 2 * pointerSize > heap.sections[section].sectionSize)
+                    continue;
+                BytesAndOffset bo;
+                bo.bytes_ = heap.sections[section].sectionBytes;
+                bo.offset_ = offset;
+                bo.pointerSize_ = pointerSize;
+                if (typeInfoToTypeDescription_.find(bo.ReadPointer()) != typeInfoToTypeDescription_.end())
+                    references.push_back(word);
+            }
+            std::sort(references.begin(), references.end());
+            references.erase(std::unique(references.begin(), references.end()), references.end());
+        }
+    });
+}
+
+void Crawler::CrawlPointer(Il2CppManagedMemorySnapshot* snapshot, StartIndices startIndices, std::uint64_t pointer, std::uint32_t indexOfFrom, std::uint32_t fieldId,
+                           std::vector<Connection>& outConnections, std::vector<std::uint32_t>& outConnectionFields, std::vector<PackedManagedObject>& outManagedObjects) {
     auto bo = FindInHeap(snapshot, pointer);
     if (!bo.IsValid())
         return;
@@ -86,25 +255,34 @@ void Crawler::CrawlPointer(Il2CppManagedMemorySnapshot* snapshot, StartIndices s
 
     ParseObjectHeader(startIndices, snapshot, pointer, typeInfoAddress, indexOfObject, wasAlreadyCrawled, outManagedObjects);
     outConnections.push_back(Connection(indexOfFrom, indexOfObject));
+    outConnectionFields.push_back(fieldId);
 
     if (wasAlreadyCrawled)
         return;
 
     auto typeDescription = typeInfoToTypeDescription_[typeInfoAddress];
     if ((typeDescription->flags & Il2CppMetadataTypeFlags::kArray) == 0) {
+        if (HasNoReferences(typeDescription))
+            return;
         auto bo2 = bo.Add(snapshot->runtimeInformation.objectHeaderSize);
-        CrawlRawObjectData(snapshot, startIndices, bo2, typeDescription, false, indexOfObject, outConnections, outManagedObjects);
+        CrawlRawObjectData(snapshot, startIndices, bo2, typeDescription, false, indexOfObject, kFieldIdNone,
+                           outConnections, outConnectionFields, outManagedObjects);
         return;
     }
-    auto arrayLen = ReadArrayLength(snapshot, pointer, typeDescription);
     auto elementType = typeDescriptions_[typeDescription->baseOrElementTypeIndex];
+    // byte[], int[], Vector3[] and the like can't reference anything
+    if ((elementType->flags & Il2CppMetadataTypeFlags::kValueType) != 0 && HasNoReferences(elementType))
+        return;
+    auto arrayLen = ReadArrayLength(snapshot, pointer, typeDescription);
     auto cursor = bo.Add(snapshot->runtimeInformation.arrayHeaderSize);
     for (int i = 0; i != arrayLen; i++) {
         if ((elementType->flags & Il2CppMetadataTypeFlags::kValueType) != 0) {
-            CrawlRawObjectData(snapshot, startIndices, cursor, elementType, false, indexOfObject, outConnections, outManagedObjects);
+            CrawlRawObjectData(snapshot, startIndices, cursor, elementType, false, indexOfObject, kFieldIdArrayElement,
+                               outConnections, outConnectionFields, outManagedObjects);
             cursor = cursor.Add(elementType->size);
         } else {
-            CrawlPointer(snapshot, startIndices, cursor.ReadPointer(), indexOfObject, outConnections, outManagedObjects);
+            CrawlPointer(snapshot, startIndices, cursor.ReadPointer(), indexOfObject, kFieldIdArrayElement | static_cast<std::uint32_t>(i),
+                         outConnections, outConnectionFields, outManagedObjects);
             cursor = cursor.NextPointer();
         }
     }
@@ -136,8 +314,8 @@ void Crawler::ParseObjectHeader(StartIndices& startIndices, Il2CppManagedMemoryS
     return;
 }
 
-void AllFieldsOf(Il2CppMetadataType* typeDescription, std::vector<Il2CppMetadataType*>& typeDescriptions,
-                 FieldFindOptions options, std::vector<Il2CppMetadataField*>& outFields) {
+void AllFieldsOf(Il2CppMetadataType* typeDescription, std::vector<Il2CppMetadataType*>& typeDescriptions, const std::vector<std::uint32_t>& fieldIdBases,
+                 FieldFindOptions options, std::vector<Il2CppMetadataField*>& outFields, std::vector<std::uint32_t>& outFieldIds) {
     std::vector<Il2CppMetadataType*> targetTypes = { typeDescription };
     while (!targetTypes.empty()) {
         auto curType = targetTypes.back();
@@ -151,18 +329,37 @@ void AllFieldsOf(Il2CppMetadataType* typeDescription, std::vector<Il2CppMetadata
         }
         for (std::uint32_t i = 0; i < curType->fieldCount; i++) {
             auto field = &curType->fields[i];
-            if ((field->isStatic && options == FieldFindOptions::OnlyStatic) || (!field->isStatic && options == FieldFindOptions::OnlyInstance))
+            if ((field->isStatic && options == FieldFindOptions::OnlyStatic) || (!field->isStatic && options == FieldFindOptions::OnlyInstance)) {
                 outFields.push_back(field);
+                outFieldIds.push_back(fieldIdBases[curType->typeIndex] + i);
+            }
         }
     }
 }
 
+std::uint32_t Crawler::FieldPathOf(std::uint32_t parent, std::uint32_t fieldId) {
+    if (parent == kFieldIdNone)
+        return fieldId;
+    auto key = (static_cast<std::uint64_t>(parent) << 32) | fieldId;
+    auto it = fieldPathIndices_.find(key);
+    if (it != fieldPathIndices_.end())
+        return kFieldIdPath | it->second;
+    auto index = static_cast<std::uint32_t>(fieldPaths_.size());
+    fieldPaths_.push_back({ parent, fieldId });
+    fieldPathIndices_.emplace(key, index);
+    return kFieldIdPath | index;
+}
+
 void Crawler::CrawlRawObjectData(Il2CppManagedMemorySnapshot* snapshot, StartIndices startIndices, BytesAndOffset bytesAndOffset,
-                        Il2CppMetadataType* typeDescription, bool useStaticFields, std::uint32_t indexOfFrom,
-                        std::vector<Connection>& outConnections, std::vector<PackedManagedObject>& outManagedObjects) {
+                        Il2CppMetadataType* typeDescription, bool useStaticFields, std::uint32_t indexOfFrom, std::uint32_t fieldPath,
+                        std::vector<Connection>& outConnections, std::vector<std::uint32_t>& outConnectionFields,
+                        std::vector<PackedManagedObject>& outManagedObjects) {
     std::vector<Il2CppMetadataField*> fields;
-    AllFieldsOf(typeDescription, typeDescriptions_, useStaticFields ? FieldFindOptions::OnlyStatic : FieldFindOptions::OnlyInstance, fields);
-    for (auto& field : fields) {
+    std::vector<std::uint32_t> fieldIds;
+    AllFieldsOf(typeDescription, typeDescriptions_, fieldIdBases_,
+                useStaticFields ? FieldFindOptions::OnlyStatic : FieldFindOptions::OnlyInstance, fields, fieldIds);
+    for (std::size_t i = 0; i < fields.size(); i++) {
+        auto field = fields[i];
         if (field->typeIndex == typeDescription->typeIndex && (typeDescription->flags & Il2CppMetadataTypeFlags::kValueType) != 0)
             continue;
         // field.offset is Uint in unity source-code
@@ -171,29 +368,199 @@ void Crawler::CrawlRawObjectData(Il2CppManagedMemorySnapshot* snapshot, StartInd
         auto fieldType = typeDescriptions_[field->typeIndex];
         auto fieldLocation = bytesAndOffset.Add(field->offset - (useStaticFields ? 0 : snapshot->runtimeInformation.objectHeaderSize));
         if ((fieldType->flags & Il2CppMetadataTypeFlags::kValueType) != 0) {
-            CrawlRawObjectData(snapshot, startIndices, fieldLocation, fieldType, false, indexOfFrom, outConnections, outManagedObjects);
+            if (HasNoReferences(fieldType))
+                continue;
+            CrawlRawObjectData(snapshot, startIndices, fieldLocation, fieldType, false, indexOfFrom, FieldPathOf(fieldPath, fieldIds[i]),
+                               outConnections, outConnectionFields, outManagedObjects);
             continue;
         }
         // temporary workaround for a bug in 5.3b4 and earlier where we would get literals returned as fields with offset 0. soon we'll be able to remove this code.
         if (fieldLocation.pointerSize_ == 4 || fieldLocation.pointerSize_ == 8) {
-            CrawlPointer(snapshot, startIndices, fieldLocation.ReadPointer(), indexOfFrom, outConnections, outManagedObjects);
+            CrawlPointer(snapshot, startIndices, fieldLocation.ReadPointer(), indexOfFrom, FieldPathOf(fieldPath, fieldIds[i]),
+                         outConnections, outConnectionFields, outManagedObjects);
         }
     }
 }
 
 int Crawler::SizeOfObjectInBytes(Il2CppMetadataType* typeDescription, BytesAndOffset bo, Il2CppManagedMemorySnapshot* snapshot, std::uint64_t address) {
+    std::uint64_t size;
+    switch (objectKinds_[typeDescription->typeIndex]) {
+    case CrawledObjectKind::kArray:
+        size = ReadArrayObjectSizeInBytes(snapshot, address, typeDescription, elementSizes_[typeDescription->typeIndex]);
+        break;
+    case CrawledObjectKind::kString:
+        size = ReadStringObjectSizeInBytes(bo, snapshot);
+        break;
+    default:
+        size = static_cast<std::uint64_t>(typeDescription->size);
+        break;
+    }
+    size = RoundToAllocationGranularity(size, snapshot->runtimeInformation.allocationGranularity);
+    return static_cast<int>(std::min<std::uint64_t>(size, static_cast<std::uint64_t>(std::numeric_limits<int>::max())));
+}
+
+PrimitiveKind PrimitiveKindOf(const QString& typeName) {
+    static const struct {
+        const char* name;
+        PrimitiveKind kind;
+    } kPrimitives[] = {
+        { "System.Boolean", PrimitiveKind::kBoolean },
+        { "System.Char", PrimitiveKind::kChar },
+        { "System.SByte", PrimitiveKind::kSByte },
+        { "System.Byte", PrimitiveKind::kByte },
+        { "System.Int16", PrimitiveKind::kInt16 },
+        { "System.UInt16", PrimitiveKind::kUInt16 },
+        { "System.Int32", PrimitiveKind::kInt32 },
+        { "System.UInt32", PrimitiveKind::kUInt32 },
+        { "System.Int64", PrimitiveKind::kInt64 },
+        { "System.UInt64", PrimitiveKind::kUInt64 },
+        { "System.Single", PrimitiveKind::kSingle },
+        { "System.Double", PrimitiveKind::kDouble },
+        { "System.IntPtr", PrimitiveKind::kIntPtr },
+        { "System.UIntPtr", PrimitiveKind::kUIntPtr },
+        { "System.String", PrimitiveKind::kString },
+    };
+    if (!typeName.startsWith("System."))
+        return PrimitiveKind::kNone;
+    for (auto& primitive : kPrimitives) {
+        if (typeName == primitive.name)
+            return primitive.kind;
+    }
+    return PrimitiveKind::kNone;
+}
+
+template<typename T>
+static void HashValue(std::uint64_t& hash, const T& value) {
+    hash = UMPHashBytes(&value, sizeof(T), hash);
+}
+
+static bool SameTypes(const std::vector<TypeDescription>& a, const std::vector<TypeDescription>& b) {
+    if (a.size() != b.size())
+        return false;
+    for (std::size_t i = 0; i < a.size(); i++) {
+        auto& typeA = a[i];
+        auto& typeB = b[i];
+        if (typeA.flags_ != typeB.flags_ || typeA.baseOrElementTypeIndex_ != typeB.baseOrElementTypeIndex_ ||
+                typeA.size_ != typeB.size_ || typeA.typeIndex_ != typeB.typeIndex_ ||
+                typeA.fields_.size() != typeB.fields_.size() || typeA.nameId_ != typeB.nameId_ ||
+                typeA.assemblyNameId_ != typeB.assemblyNameId_)
+            return false;
+        for (std::size_t j = 0; j < typeA.fields_.size(); j++) {
+            auto& fieldA = typeA.fields_[j];
+            auto& fieldB = typeB.fields_[j];
+            if (fieldA.offset_ != fieldB.offset_ || fieldA.typeIndex_ != fieldB.typeIndex_ ||
+                    fieldA.isStatic_ != fieldB.isStatic_ || fieldA.nameId_ != fieldB.nameId_)
+                return false;
+        }
+    }
+    return true;
+}
+
+// catalogs in use by some snapshot, the last snapshot of a build takes its catalog with it
+static std::mutex catalogsMutex_;
+static std::unordered_multimap<std::uint64_t, std::weak_ptr<const UMPTypeCatalog>> catalogs_;
+
+std::uint64_t UMPTypeCatalog::HashOf(const std::vector<TypeDescription>& types, const UMPStringPool& strings) {
+    // names are in the pool, types only point into it
+    auto hash = strings.Hash();
+    HashValue(hash, types.size());
+    for (auto& type : types) {
+        HashValue(hash, type.flags_);
+        HashValue(hash, type.baseOrElementTypeIndex_);
+        HashValue(hash, type.size_);
+        HashValue(hash, type.typeIndex_);
+        HashValue(hash, type.nameId_);
+        HashValue(hash, type.assemblyNameId_);
+        HashValue(hash, type.fields_.size());
+        for (auto& field : type.fields_) {
+            HashValue(hash, field.offset_);
+            HashValue(hash, field.typeIndex_);
+            HashValue(hash, field.isStatic_);
+            HashValue(hash, field.nameId_);
+        }
+    }
+    return hash;
+}
+
+std::shared_ptr<const UMPTypeCatalog> UMPTypeCatalog::Intern(std::vector<TypeDescription>&& types, UMPStringPool&& strings) {
+    auto hash = HashOf(types, strings);
+    std::lock_guard<std::mutex> lock(catalogsMutex_);
+    for (auto it = catalogs_.begin(); it != catalogs_.end();) {
+        if (it->second.expired())
+            it = catalogs_.erase(it);
+        else
+            ++it;
+    }
+    // a hash match is compared in full, two builds must never share names by accident
+    auto range = catalogs_.equal_range(hash);
+    for (auto it = range.first; it != range.second; ++it) {
+        auto catalog = it->second.lock();
+        if (catalog != nullptr && catalog->strings_ == strings && SameTypes(catalog->types_, types))
+            return catalog;
+    }
+    auto catalog = std::make_shared<UMPTypeCatalog>();
+    catalog->types_ = std::move(types);
+    catalog->strings_ = std::move(strings);
+    catalog->hash_ = hash;
+    for (auto& type : catalog->types_)
+        type.primitiveKind_ = PrimitiveKindOf(catalog->TypeName(type));
+    catalog->fieldIdBases_.resize(catalog->types_.size());
+    std::uint32_t fieldIdBase = 0;
+    for (std::size_t i = 0; i < catalog->types_.size(); i++) {
+        catalog->fieldIdBases_[i] = fieldIdBase;
+        fieldIdBase += static_cast<std::uint32_t>(catalog->types_[i].fields_.size());
+    }
+    catalogs_.emplace(hash, catalog);
+    return catalog;
+}
+
+bool Crawler::HasNoReferences(Il2CppMetadataType* typeDescription) {
+    auto& scan = referenceScans_[typeDescription->typeIndex];
+    if (scan == kReferenceScanNone || scan == kReferenceScanSome)
+        return scan == kReferenceScanNone;
+    // a type reached again while its own fields are being scanned is assumed to hold references
+    if (scan == kReferenceScanPending)
+        return false;
     if ((typeDescription->flags & Il2CppMetadataTypeFlags::kArray) != 0) {
-        return ReadArrayObjectSizeInBytes(snapshot, address, typeDescription, typeDescriptions_);
+        scan = kReferenceScanSome;
+        return false;
     }
-    if (QString(typeDescription->name) == "System.String") {
-        return ReadStringObjectSizeInBytes(bo, snapshot);
+    auto kind = primitiveKinds_[typeDescription->typeIndex];
+    if (kind != PrimitiveKind::kNone) {
+        // strings only hold their length and characters
+        scan = kReferenceScanNone;
+        return true;
     }
-    return static_cast<int>(typeDescription->size);
+    scan = kReferenceScanPending;
+    std::vector<Il2CppMetadataField*> fields;
+    std::vector<std::uint32_t> fieldIds;
+    AllFieldsOf(typeDescription, typeDescriptions_, fieldIdBases_, FieldFindOptions::OnlyInstance, fields, fieldIds);
+    bool noReferences = true;
+    for (auto field : fields) {
+        if (field->offset == static_cast<std::uint32_t>(-1))
+            continue;
+        auto fieldType = typeDescriptions_[field->typeIndex];
+        // a class can point at itself (linked lists), only a value type can't contain itself
+        if ((fieldType->flags & Il2CppMetadataTypeFlags::kValueType) == 0) {
+            noReferences = false;
+            break;
+        }
+        if (field->typeIndex == typeDescription->typeIndex)
+            continue;
+        if (!HasNoReferences(fieldType)) {
+            noReferences = false;
+            break;
+        }
+    }
+    scan = noReferences ? kReferenceScanNone : kReferenceScanSome;
+    return noReferences;
 }
 
 void CrawledMemorySnapshot::Unpack(CrawledMemorySnapshot& result, Il2CppManagedMemorySnapshot* snapshot, PackedCrawlerData& packedCrawlerData) {
+    UMPScopedTimer timer("unpack");
     result.runtimeInformation_ = snapshot->runtimeInformation;
     // managed heap
+    std::uint64_t heapBytes = 0;
     result.managedHeap_.resize(snapshot->heap.sectionCount);
     for (std::size_t i = 0; i < snapshot->heap.sectionCount; i++) {
         auto section = &snapshot->heap.sections[i];
@@ -202,34 +569,56 @@ void CrawledMemorySnapshot::Unpack(CrawledMemorySnapshot& result, Il2CppManagedM
         newSection->sectionStartAddress_ = section->sectionStartAddress;
         newSection->sectionBytes_ = new std::uint8_t[section->sectionSize];
         memcpy(newSection->sectionBytes_, section->sectionBytes, section->sectionSize);
+        heapBytes += section->sectionSize;
+    }
+    timer.AddCounter("heap bytes", heapBytes);
+    timer.AddCounter("objects", packedCrawlerData.managedObjects_.size());
+    // convert typeDescriptions, statics and class pointers stay with the snapshot
+    auto typeCount = packedCrawlerData.typeDescriptions_.size();
+    std::vector<TypeDescription> types(typeCount);
+    UMPStringPool strings;
+    auto addName = [&strings](const char* name) {
+        return name != nullptr ? strings.Add(name) : 0;
+    };
+    result.typeInfoAddresses_.resize(typeCount);
+    result.staticsOffsets_.assign(typeCount + 1, 0);
+    for (std::size_t i = 0; i < typeCount; i++) {
+        auto from = packedCrawlerData.typeDescriptions_[i];
+        auto staticsSize = (from->flags & Il2CppMetadataTypeFlags::kArray) == 0 ? from->staticsSize : 0;
+        result.staticsOffsets_[i + 1] = result.staticsOffsets_[i] + staticsSize;
     }
-    // convert typeDescriptions
-    result.typeDescriptions_.resize(packedCrawlerData.typeDescriptions_.size());
-    for (std::size_t i = 0; i < packedCrawlerData.typeDescriptions_.size(); i++) {
+    if (result.staticsOffsets_[typeCount] > 0)
+        result.staticsBytes_ = new std::uint8_t[result.staticsOffsets_[typeCount]];
+    for (std::size_t i = 0; i < typeCount; i++) {
         auto& from = packedCrawlerData.typeDescriptions_[i];
-        auto& to = result.typeDescriptions_[i];
+        auto& to = types[i];
         to.flags_ = from->flags;
         if ((to.flags_ & Il2CppMetadataTypeFlags::kArray) == 0) {
             to.fields_.resize(from->fieldCount);
             for (std::uint32_t j = 0; j < from->fieldCount; j++) {
                 auto& fromField = from->fields[j];
                 auto& toField = to.fields_[j];
-                toField.name_ = QString::fromLocal8Bit(fromField.name);
+                toField.nameId_ = addName(fromField.name);
                 toField.offset_ = fromField.offset;
                 toField.isStatic_ = fromField.isStatic;
                 toField.typeIndex_ = fromField.typeIndex;
             }
-            to.statics_ = new std::uint8_t[from->staticsSize];
-            to.staticsSize_ = from->staticsSize;
-            memcpy(to.statics_, from->statics, from->staticsSize);
+            if (from->staticsSize > 0)
+                memcpy(result.staticsBytes_ + result.staticsOffsets_[i], from->statics, from->staticsSize);
         }
         to.baseOrElementTypeIndex_ = from->baseOrElementTypeIndex;
-        to.name_ = QString::fromLocal8Bit(from->name);
-        to.assemblyName_ = QString::fromLocal8Bit(from->assemblyName);
-        to.typeInfoAddress_ = from->typeInfoAddress;
+        to.nameId_ = addName(from->name);
+        to.assemblyNameId_ = addName(from->assemblyName);
+        result.typeInfoAddresses_[i] = from->typeInfoAddress;
         to.size_ = from->size;
         to.typeIndex_ = from->typeIndex;
     }
+    result.typeCatalog_ = UMPTypeCatalog::Intern(std::move(types), std::move(strings));
+    auto& catalogTypes = result.typeCatalog_->types_;
+    // one QString per type, captions share them
+    std::vector<QString> typeNames(typeCount);
+    for (std::size_t i = 0; i < typeCount; i++)
+        typeNames[i] = result.typeCatalog_->TypeName(catalogTypes[i]);
     // unpack gchandle
     for (std::uint32_t i = 0; i < snapshot->gcHandles.trackedObjectCount; i++) {
         GCHandle handle;
@@ -240,22 +629,45 @@ void CrawledMemorySnapshot::Unpack(CrawledMemorySnapshot& result, Il2CppManagedM
     // unpack statics
     for (auto type : packedCrawlerData.typesWithStaticFields_) {
         StaticFields field;
-        field.typeDescription_ = &result.typeDescriptions_[type->typeIndex];
+        field.typeDescription_ = &catalogTypes[type->typeIndex];
         field.caption_ = QString("static field of ") + type->name;
         field.size_ = type->staticsSize;
         result.staticFields_.push_back(field);
     }
+    // unpack static field roots, sized from the type table
+    for (auto& packed : packedCrawlerData.staticFieldRoots_) {
+        auto type = packedCrawlerData.typesWithStaticFields_[packed.holder_];
+        auto& field = type->fields[packed.fieldIndex_];
+        auto fieldType = packedCrawlerData.typeDescriptions_[field.typeIndex];
+        StaticFieldRoot root;
+        root.typeDescription_ = &catalogTypes[type->typeIndex];
+        root.fieldId_ = packed.fieldId_;
+        root.caption_ = typeNames[type->typeIndex] + "." + QString::fromUtf8(field.name);
+        root.size_ = (fieldType->flags & Il2CppMetadataTypeFlags::kValueType) != 0 ? fieldType->size : snapshot->runtimeInformation.pointerSize;
+        auto& holder = result.staticFields_[packed.holder_];
+        root.size_ = std::min(root.size_, holder.size_);
+        holder.size_ -= root.size_;
+        result.staticFieldRoots_.push_back(root);
+    }
+    // unpack stacks
+    for (std::uint32_t i = 0; i < snapshot->stacks.stackCount; i++) {
+        StackRoot stack;
+        stack.stackAddress_ = snapshot->stacks.stacks[i].sectionStartAddress;
+        stack.caption_ = QString("stack %1").arg(stack.stackAddress_, 0, 16);
+        result.stackRoots_.push_back(stack);
+    }
     // unpack managed
     for (auto& managed : packedCrawlerData.managedObjects_) {
         ManagedObject mo;
         mo.address_ = managed.address_;
         mo.size_ = managed.size_;
-        mo.typeDescription_ = &result.typeDescriptions_[managed.typeIndex_];
-        mo.caption_ = mo.typeDescription_->name_;
+        mo.typeDescription_ = &catalogTypes[managed.typeIndex_];
+        mo.caption_ = typeNames[managed.typeIndex_];
         result.managedObjects_.push_back(mo);
     }
     // combine
-    result.allObjects_.reserve(result.gcHandles_.size() + result.staticFields_.size() + result.managedObjects_.size());
+    result.allObjects_.reserve(result.gcHandles_.size() + result.staticFields_.size() + result.staticFieldRoots_.size() +
+                               result.stackRoots_.size() + result.managedObjects_.size());
     std::uint32_t index = 0;
     for (auto& obj : result.gcHandles_) {
         obj.index_ = index++;
@@ -263,40 +675,455 @@ void CrawledMemorySnapshot::Unpack(CrawledMemorySnapshot& result, Il2CppManagedM
     }
     for (auto& obj : result.staticFields_) {
         obj.index_ = index++;
-        obj.nameHash_ = qHash(obj.typeDescription_->assemblyName_ + obj.caption_);
+        obj.nameHash_ = qHash(result.typeCatalog_->AssemblyName(*obj.typeDescription_) + obj.caption_);
+        result.allObjects_.push_back(&obj);
+    }
+    for (auto& obj : result.staticFieldRoots_) {
+        obj.index_ = index++;
+        obj.nameHash_ = qHash(result.typeCatalog_->AssemblyName(*obj.typeDescription_) + obj.caption_);
+        result.allObjects_.push_back(&obj);
+    }
+    for (auto& obj : result.stackRoots_) {
+        obj.index_ = index++;
         result.allObjects_.push_back(&obj);
     }
     for (auto& obj : result.managedObjects_) {
         obj.index_ = index++;
         result.allObjects_.push_back(&obj);
     }
-    // connections
-    std::vector<std::vector<ThingInMemory*>> referencesLists(result.allObjects_.size());
-    std::vector<std::vector<ThingInMemory*>> referencedByLists(result.allObjects_.size());
+    // connections, the field ids are grouped by referrer so a thing's references index them directly
+    result.fieldPaths_ = std::move(packedCrawlerData.fieldPaths_);
+    auto& starts = result.referenceFieldStarts_;
+    auto& byStarts = result.referencedByStarts_;
+    starts.assign(result.allObjects_.size() + 1, 0);
+    byStarts.assign(result.allObjects_.size() + 1, 0);
     for (auto& connection : packedCrawlerData.connections_) {
-        referencesLists[connection.from_].push_back(result.allObjects_[connection.to_]);
-        referencedByLists[connection.to_].push_back(result.allObjects_[connection.from_]);
+        starts[connection.from_ + 1]++;
+        byStarts[connection.to_ + 1]++;
+    }
+    for (std::size_t i = 0; i < result.allObjects_.size(); i++) {
+        result.allObjects_[i]->references_.reserve(starts[i + 1]);
+        result.allObjects_[i]->referencedBy_.reserve(byStarts[i + 1]);
+        starts[i + 1] += starts[i];
+        byStarts[i + 1] += byStarts[i];
+    }
+    result.referenceFields_.resize(packedCrawlerData.connections_.size());
+    result.referencedBySlots_.resize(packedCrawlerData.connections_.size());
+    for (std::size_t i = 0; i < packedCrawlerData.connections_.size(); i++) {
+        auto& connection = packedCrawlerData.connections_[i];
+        auto from = result.allObjects_[connection.from_];
+        auto to = result.allObjects_[connection.to_];
+        auto slot = starts[connection.from_] + static_cast<std::uint32_t>(from->references_.size());
+        result.referenceFields_[slot] = packedCrawlerData.connectionFields_[i];
+        result.referencedBySlots_[byStarts[connection.to_] + to->referencedBy_.size()] = slot;
+        from->references_.push_back(to);
+        to->referencedBy_.push_back(from);
+    }
+    // like a gchandle a stack root is sized by the slots holding its references
+    for (auto& obj : result.stackRoots_)
+        obj.size_ = static_cast<std::int64_t>(obj.references_.size()) * snapshot->runtimeInformation.pointerSize;
+    BuildIndices(&result);
+}
+
+void CrawledMemorySnapshot::BuildIndices(CrawledMemorySnapshot* snapshot) {
+    UMPScopedTimer timer("indices");
+    std::sort(snapshot->managedHeap_.begin(), snapshot->managedHeap_.end(),
+              [](const CrawledManagedMemorySection& a, const CrawledManagedMemorySection& b) {
+        return a.sectionStartAddress_ < b.sectionStartAddress_;
+    });
+    // address index
+    auto objectCount = snapshot->managedObjects_.size();
+    auto& sortedObjects = snapshot->sortedObjects_;
+    sortedObjects.resize(objectCount);
+    for (std::size_t i = 0; i < objectCount; i++)
+        sortedObjects[i] = static_cast<std::uint32_t>(i);
+    UMPParallelSort(sortedObjects, [snapshot](std::uint32_t a, std::uint32_t b) {
+        return snapshot->managedObjects_[a].address_ < snapshot->managedObjects_[b].address_;
+    });
+    snapshot->sortedAddresses_.resize(objectCount);
+    for (std::size_t i = 0; i < objectCount; i++)
+        snapshot->sortedAddresses_[i] = snapshot->managedObjects_[sortedObjects[i]].address_;
+    // root distances, breadth first from every root at once
+    {
+        UMPScopedTimer distancesTimer("root distances");
+        auto& distances = snapshot->rootDistances_;
+        distances.assign(snapshot->allObjects_.size(), kUnreachableDistance);
+        std::vector<std::uint32_t> queue;
+        queue.reserve(snapshot->allObjects_.size());
+        for (auto thing : snapshot->allObjects_) {
+            if (IsRoot(thing)) {
+                distances[thing->index_] = 0;
+                queue.push_back(thing->index_);
+            }
+        }
+        for (std::size_t head = 0; head < queue.size(); head++) {
+            auto thing = snapshot->allObjects_[queue[head]];
+            auto distance = distances[thing->index_] + 1;
+            for (auto ref : thing->references_) {
+                if (distances[ref->index_] == kUnreachableDistance) {
+                    distances[ref->index_] = distance;
+                    queue.push_back(ref->index_);
+                }
+            }
+        }
+        distancesTimer.AddCounter("reachable", queue.size());
+    }
+    // gchandle targets, a handle references nothing but its object
+    auto firstManaged = snapshot->allObjects_.size() - objectCount;
+    for (auto& handle : snapshot->gcHandles_) {
+        handle.target_ = handle.references_.empty() ? kNoManagedObject
+                                                    : static_cast<std::uint32_t>(handle.references_[0]->index_ - firstManaged);
+    }
+    BuildDominators(snapshot);
+    BuildRetainedSizes(snapshot);
+}
+
+// Cooper, Harvey & Kennedy's iterative dominator algorithm over a virtual root that references every real root,
+// nodes are numbered in depth-first postorder so a dominator always has a higher number than what it dominates
+void CrawledMemorySnapshot::BuildDominators(CrawledMemorySnapshot* snapshot) {
+    UMPScopedTimer timer("dominators");
+    const std::uint32_t kUnvisited = std::numeric_limits<std::uint32_t>::max();
+    auto& things = snapshot->allObjects_;
+    std::vector<std::uint32_t> postorderOf(things.size(), kUnvisited);
+    auto& order = snapshot->dominatorOrder_;
+    order.clear();
+    order.reserve(things.size());
+    // (thing, next reference to follow), a sentinel marks things pushed but not yet entered
+    std::vector<std::pair<std::uint32_t, std::uint32_t>> stack;
+    for (auto root : things) {
+        if (!IsRoot(root) || postorderOf[root->index_] != kUnvisited)
+            continue;
+        postorderOf[root->index_] = kUnvisited - 1;
+        stack.push_back(std::make_pair(root->index_, 0u));
+        while (!stack.empty()) {
+            auto& top = stack.back();
+            auto thing = things[top.first];
+            if (top.second < thing->references_.size()) {
+                auto ref = thing->references_[top.second++];
+                if (postorderOf[ref->index_] == kUnvisited) {
+                    postorderOf[ref->index_] = kUnvisited - 1;
+                    stack.push_back(std::make_pair(ref->index_, 0u));
+                }
+                continue;
+            }
+            postorderOf[top.first] = static_cast<std::uint32_t>(order.size());
+            order.push_back(top.first);
+            stack.pop_back();
+        }
+    }
+    auto virtualRoot = static_cast<std::uint32_t>(order.size());
+    // predecessors in postorder numbers, flat so the passes below don't chase pointers, roots only have the virtual root
+    std::vector<std::uint32_t> predOffsets(virtualRoot + 1, 0);
+    for (std::uint32_t node = 0; node < virtualRoot; node++) {
+        auto thing = things[order[node]];
+        predOffsets[node + 1] = predOffsets[node] + (IsRoot(thing) ? 1 : static_cast<std::uint32_t>(thing->referencedBy_.size()));
+    }
+    std::vector<std::uint32_t> preds(predOffsets[virtualRoot]);
+    for (std::uint32_t node = 0; node < virtualRoot; node++) {
+        auto thing = things[order[node]];
+        auto out = preds.begin() + predOffsets[node];
+        if (IsRoot(thing)) {
+            *out = virtualRoot;
+            continue;
+        }
+        for (auto refBy : thing->referencedBy_)
+            *out++ = postorderOf[refBy->index_];
+    }
+    std::vector<std::uint32_t> doms(virtualRoot + 1, kUnvisited);
+    doms[virtualRoot] = virtualRoot;
+    auto intersect = [&](std::uint32_t a, std::uint32_t b) {
+        while (a != b) {
+            while (a < b)
+                a = doms[a];
+            while (b < a)
+                b = doms[b];
+        }
+        return a;
+    };
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (auto node = virtualRoot; node-- > 0;) {
+            auto idom = kUnvisited;
+            for (auto i = predOffsets[node]; i < predOffsets[node + 1]; i++) {
+                auto pred = preds[i];
+                // unreachable referrers were never numbered
+                if (pred >= kUnvisited - 1 || doms[pred] == kUnvisited)
+                    continue;
+                idom = idom == kUnvisited ? pred : intersect(pred, idom);
+            }
+            if (doms[node] != idom) {
+                doms[node] = idom;
+                changed = true;
+            }
+        }
+    }
+    auto& dominators = snapshot->immediateDominators_;
+    dominators.assign(things.size(), kNoDominator);
+    for (std::uint32_t node = 0; node < virtualRoot; node++) {
+        if (doms[node] != virtualRoot)
+            dominators[order[node]] = order[doms[node]];
+    }
+}
+
+void CrawledMemorySnapshot::BuildRetainedSizes(CrawledMemorySnapshot* snapshot) {
+    UMPScopedTimer timer("retained sizes");
+    auto& retained = snapshot->retainedSizes_;
+    retained.resize(snapshot->allObjects_.size());
+    for (auto thing : snapshot->allObjects_)
+        retained[thing->index_] = thing->size_;
+    for (auto index : snapshot->dominatorOrder_) {
+        auto dominator = snapshot->immediateDominators_[index];
+        if (dominator != kNoDominator)
+            retained[dominator] += retained[index];
+    }
+}
+
+bool CrawledMemorySnapshot::IsRoot(const ThingInMemory* thing) {
+    switch (thing->type()) {
+    case ThingType::GCHANDLE:
+    case ThingType::STATIC:
+    case ThingType::STATIC_FIELD:
+    case ThingType::STACK:
+        return true;
+    default:
+        return false;
+    }
+}
+
+// upper bound of partial paths popped per query, keeps the panel responsive on pathological graphs
+const std::size_t kMaxPathExpansions = 20000;
+
+void CrawledMemorySnapshot::FindPathsToRoot(const CrawledMemorySnapshot* snapshot, const ThingInMemory* thing, std::size_t maxPaths,
+                                            std::vector<std::vector<const ThingInMemory*>>& outPaths) {
+    const auto& distances = snapshot->rootDistances_;
+    if (thing == nullptr || thing->index_ >= distances.size() || distances[thing->index_] == kUnreachableDistance)
+        return;
+    // best-first search walking referencedBy, rootDistances is an exact lower bound of the remaining length
+    // so paths are completed in order of length
+    struct PathNode {
+        const ThingInMemory* thing_;
+        std::uint32_t parent_;
+        std::uint32_t length_;
+    };
+    typedef std::pair<std::uint32_t, std::uint32_t> OpenEntry; // (estimated length, node)
+    std::vector<PathNode> nodes;
+    std::priority_queue<OpenEntry, std::vector<OpenEntry>, std::greater<OpenEntry>> open;
+    nodes.push_back({ thing, std::numeric_limits<std::uint32_t>::max(), 0 });
+    open.push(OpenEntry(distances[thing->index_], 0));
+    std::vector<const ThingInMemory*> referrers;
+    std::size_t expansions = 0;
+    while (!open.empty() && outPaths.size() < maxPaths && expansions++ < kMaxPathExpansions) {
+        auto nodeIndex = open.top().second;
+        open.pop();
+        auto node = nodes[nodeIndex];
+        if (IsRoot(node.thing_)) {
+            // parents lead back to the queried thing, so this walk is already root first
+            outPaths.push_back(std::vector<const ThingInMemory*>());
+            auto& path = outPaths.back();
+            for (auto cur = nodeIndex; cur != std::numeric_limits<std::uint32_t>::max(); cur = nodes[cur].parent_)
+                path.push_back(nodes[cur].thing_);
+            continue;
+        }
+        referrers.clear();
+        for (auto refBy : node.thing_->referencedBy_) {
+            if (distances[refBy->index_] == kUnreachableDistance)
+                continue;
+            bool onPath = false;
+            for (auto cur = nodeIndex; cur != std::numeric_limits<std::uint32_t>::max() && !onPath; cur = nodes[cur].parent_)
+                onPath = nodes[cur].thing_ == refBy;
+            if (!onPath)
+                referrers.push_back(refBy);
+        }
+        auto closer = [&](const ThingInMemory* a, const ThingInMemory* b) {
+            auto da = distances[a->index_], db = distances[b->index_];
+            return da != db ? da < db : a->index_ < b->index_;
+        };
+        std::sort(referrers.begin(), referrers.end(), closer);
+        referrers.erase(std::unique(referrers.begin(), referrers.end()), referrers.end());
+        // no more than maxPaths completions can come out of a single node
+        if (referrers.size() > maxPaths)
+            referrers.resize(maxPaths);
+        for (auto refBy : referrers) {
+            auto length = node.length_ + 1;
+            nodes.push_back({ refBy, nodeIndex, length });
+            open.push(OpenEntry(length + distances[refBy->index_], static_cast<std::uint32_t>(nodes.size() - 1)));
+        }
+    }
+}
+
+// field of a plain field id, nullptr for the tagged ones
+static const FieldDescription* FieldOfId(const CrawledMemorySnapshot* snapshot, std::uint32_t fieldId) {
+    if ((fieldId & (kFieldIdArrayElement | kFieldIdPath)) != 0)
+        return nullptr;
+    auto& bases = snapshot->typeCatalog_->fieldIdBases_;
+    auto it = std::upper_bound(bases.begin(), bases.end(), fieldId);
+    if (it == bases.begin())
+        return nullptr;
+    auto& type = snapshot->typeCatalog_->types_[static_cast<std::size_t>(it - bases.begin() - 1)];
+    auto fieldIndex = fieldId - *(it - 1);
+    if (fieldIndex >= type.fields_.size())
+        return nullptr;
+    return &type.fields_[fieldIndex];
+}
+
+// offset of the field a path ends in from the start of a struct array element, false if the path doesn't start at one
+static bool ElementFieldOffset(const CrawledMemorySnapshot* snapshot, std::uint32_t fieldId, std::uint64_t& outOffset) {
+    if ((fieldId & kFieldIdArrayElement) != 0 || (fieldId & kFieldIdPath) == 0)
+        return false;
+    auto pathIndex = fieldId & ~kFieldIdPath;
+    if (pathIndex >= snapshot->fieldPaths_.size())
+        return false;
+    auto& path = snapshot->fieldPaths_[pathIndex];
+    auto field = FieldOfId(snapshot, path.fieldId_);
+    if (field == nullptr)
+        return false;
+    std::uint64_t parentOffset = 0;
+    if (path.parent_ != kFieldIdArrayElement && !ElementFieldOffset(snapshot, path.parent_, parentOffset))
+        return false;
+    // struct field offsets count the object header of a boxed instance
+    outOffset = parentOffset + field->offset_ - snapshot->runtimeInformation_.objectHeaderSize;
+    return true;
+}
+
+QString CrawledMemorySnapshot::FieldName(const CrawledMemorySnapshot* snapshot, std::uint32_t fieldId) {
+    if (fieldId == kFieldIdNone)
+        return QString();
+    if ((fieldId & kFieldIdArrayElement) != 0)
+        return QString("[%1]").arg(fieldId & ~kFieldIdArrayElement);
+    if ((fieldId & kFieldIdPath) != 0) {
+        auto pathIndex = fieldId & ~kFieldIdPath;
+        if (pathIndex >= snapshot->fieldPaths_.size())
+            return QString();
+        auto& path = snapshot->fieldPaths_[pathIndex];
+        return (path.parent_ == kFieldIdArrayElement ? QString("[]") : FieldName(snapshot, path.parent_)) + FieldName(snapshot, path.fieldId_);
+    }
+    auto field = FieldOfId(snapshot, fieldId);
+    if (field == nullptr)
+        return QString();
+    return "." + snapshot->typeCatalog_->FieldName(*field);
+}
+
+QString CrawledMemorySnapshot::EdgeName(const CrawledMemorySnapshot* snapshot, const ThingInMemory* from, const ThingInMemory* to, std::uint32_t fieldId) {
+    auto name = FieldName(snapshot, fieldId);
+    std::uint64_t offset;
+    if (from->type() != ThingType::MANAGED || to->type() != ThingType::MANAGED || !ElementFieldOffset(snapshot, fieldId, offset))
+        return name;
+    // the first element holding the target, the same object twice in one array can't be told apart
+    auto array = static_cast<const ManagedObject*>(from);
+    auto target = static_cast<const ManagedObject*>(to)->address_;
+    auto& elementType = snapshot->typeCatalog_->types_[array->typeDescription_->baseOrElementTypeIndex_];
+    auto length = ReadArrayLength(snapshot, array->address_, array->typeDescription_);
+    auto elementSize = static_cast<std::uint64_t>(elementType.size_);
+    auto elements = FindInHeap(snapshot, array->address_ + snapshot->runtimeInformation_.arrayHeaderSize);
+    if (length <= 0 || elementSize == 0 || !elements.IsValid() ||
+            FindInHeap(snapshot, array->address_ + snapshot->runtimeInformation_.arrayHeaderSize + elementSize * static_cast<std::uint64_t>(length) - 1).bytes_ != elements.bytes_)
+        return name;
+    for (int i = 0; i < length; i++) {
+        if (elements.Add(static_cast<std::uint32_t>(elementSize * static_cast<std::uint64_t>(i) + offset)).ReadPointer() == target)
+            return QString("[%1]").arg(i) + name.mid(2);
     }
-    for (std::size_t i = 0; i != result.allObjects_.size(); i++) {
-        result.allObjects_[i]->references_ = std::move(referencesLists[i]);
-        result.allObjects_[i]->referencedBy_ = std::move(referencedByLists[i]);
+    return name;
+}
+
+std::uint32_t CrawledMemorySnapshot::ReferenceField(const CrawledMemorySnapshot* snapshot, const ThingInMemory* thing, std::size_t i) {
+    if (thing->index_ + 1 >= snapshot->referenceFieldStarts_.size())
+        return kFieldIdNone;
+    return snapshot->referenceFields_[snapshot->referenceFieldStarts_[thing->index_] + i];
+}
+
+std::uint32_t CrawledMemorySnapshot::ReferencedByField(const CrawledMemorySnapshot* snapshot, const ThingInMemory* thing, std::size_t i) {
+    if (thing->index_ + 1 >= snapshot->referencedByStarts_.size())
+        return kFieldIdNone;
+    auto slot = snapshot->referencedBySlots_[snapshot->referencedByStarts_[thing->index_] + i];
+    return slot < snapshot->referenceFields_.size() ? snapshot->referenceFields_[slot] : kFieldIdNone;
+}
+
+// referencedBySlots_ of a snapshot read from a file. both edge lists are in connection order, so the n-th edge
+// from a referrer in referencedBy_ is that referrer's n-th edge to the thing: sorting both sides by
+// (to, from, position) lines every back edge up with its slot
+static void BuildReferencedBySlots(CrawledMemorySnapshot* snapshot) {
+    struct EdgeKey {
+        std::uint32_t to_;
+        std::uint32_t from_;
+        std::uint32_t position_;
+        bool operator<(const EdgeKey& other) const {
+            if (to_ != other.to_)
+                return to_ < other.to_;
+            return from_ != other.from_ ? from_ < other.from_ : position_ < other.position_;
+        }
+    };
+    auto& things = snapshot->allObjects_;
+    auto& byStarts = snapshot->referencedByStarts_;
+    byStarts.assign(things.size() + 1, 0);
+    for (std::size_t i = 0; i < things.size(); i++)
+        byStarts[i + 1] = byStarts[i] + static_cast<std::uint32_t>(things[i]->referencedBy_.size());
+    std::vector<EdgeKey> forward;
+    std::vector<EdgeKey> back;
+    forward.reserve(snapshot->referenceFields_.size());
+    back.reserve(byStarts.back());
+    for (auto thing : things) {
+        for (std::size_t j = 0; j < thing->references_.size(); j++)
+            forward.push_back({ thing->references_[j]->index_, thing->index_, snapshot->referenceFieldStarts_[thing->index_] + static_cast<std::uint32_t>(j) });
+        for (std::size_t j = 0; j < thing->referencedBy_.size(); j++)
+            back.push_back({ thing->index_, thing->referencedBy_[j]->index_, byStarts[thing->index_] + static_cast<std::uint32_t>(j) });
     }
+    std::sort(forward.begin(), forward.end());
+    std::sort(back.begin(), back.end());
+    snapshot->referencedBySlots_.assign(back.size(), 0);
+    for (std::size_t k = 0; k < back.size() && k < forward.size(); k++)
+        snapshot->referencedBySlots_[back[k].position_] = forward[k].position_;
+}
+
+QString CrawledMemorySnapshot::ReferenceName(const CrawledMemorySnapshot* snapshot, const ThingInMemory* from, const ThingInMemory* to) {
+    for (std::size_t i = 0; i < from->references_.size(); i++) {
+        if (from->references_[i] == to)
+            return EdgeName(snapshot, from, to, ReferenceField(snapshot, from, i));
+    }
+    return QString();
 }
 
 BytesAndOffset CrawledMemorySnapshot::FindInHeap(const CrawledMemorySnapshot* snapshot, std::uint64_t addr) {
     BytesAndOffset ba;
-    for (std::size_t i = 0; i < snapshot->managedHeap_.size(); i++) {
-        auto section = snapshot->managedHeap_[i];
-        if (addr >= section.sectionStartAddress_ && addr < (section.sectionStartAddress_ + static_cast<std::uint64_t>(section.sectionSize_))) {
-            ba.bytes_ = section.sectionBytes_;
-            ba.offset_ = addr - section.sectionStartAddress_;
-            ba.pointerSize_ = snapshot->runtimeInformation_.pointerSize;
-            break;
-        }
+    auto i = UMPFindSection(snapshot->managedHeap_.data(), snapshot->managedHeap_.size(), addr,
+                            [](const CrawledManagedMemorySection& section) { return section.sectionStartAddress_; },
+                            [](const CrawledManagedMemorySection& section) { return section.sectionSize_; });
+    if (i < snapshot->managedHeap_.size()) {
+        auto& section = snapshot->managedHeap_[i];
+        ba.bytes_ = section.sectionBytes_;
+        ba.offset_ = addr - section.sectionStartAddress_;
+        ba.pointerSize_ = snapshot->runtimeInformation_.pointerSize;
     }
     return ba;
 }
 
+BytesAndOffset CrawledMemorySnapshot::StaticsOf(const CrawledMemorySnapshot* snapshot, std::uint32_t typeIndex) {
+    BytesAndOffset ba;
+    auto& offsets = snapshot->staticsOffsets_;
+    if (static_cast<std::size_t>(typeIndex) + 1 < offsets.size() && offsets[typeIndex] < offsets[typeIndex + 1]) {
+        ba.bytes_ = snapshot->staticsBytes_;
+        ba.offset_ = offsets[typeIndex];
+        ba.pointerSize_ = snapshot->runtimeInformation_.pointerSize;
+    }
+    return ba;
+}
+
+std::uint32_t CrawledMemorySnapshot::FindObjectAt(const CrawledMemorySnapshot* snapshot, std::uint64_t address, bool allowInterior) {
+    auto& addresses = snapshot->sortedAddresses_;
+    auto count = addresses.size();
+    auto i = UMPLowerBound(addresses.data(), count, address, [](std::uint64_t value) { return value; });
+    if (i < count && addresses[i] == address)
+        return snapshot->sortedObjects_[i];
+    if (!allowInterior || i == 0)
+        return kNoManagedObject;
+    auto index = snapshot->sortedObjects_[i - 1];
+    auto& managed = snapshot->managedObjects_[index];
+    // diffed objects carry a size delta, only trust positive sizes
+    if (managed.size_ > 0 && address < managed.address_ + static_cast<std::uint64_t>(managed.size_))
+        return index;
+    return kNoManagedObject;
+}
+
 QString CrawledMemorySnapshot::ReadString(const CrawledMemorySnapshot* snapshot, const BytesAndOffset& bo) {
     if (!bo.IsValid())
         return QString();
@@ -306,7 +1133,7 @@ QString CrawledMemorySnapshot::ReadString(const CrawledMemorySnapshot* snapshot,
     return QString::fromUtf16(reinterpret_cast<std::uint16_t*>(firstChar.bytes_ + firstChar.offset_), length);
 }
 
-int CrawledMemorySnapshot::ReadArrayLength(const CrawledMemorySnapshot* snapshot, std::uint64_t address, TypeDescription* arrayType) {
+int CrawledMemorySnapshot::ReadArrayLength(const CrawledMemorySnapshot* snapshot, std::uint64_t address, const TypeDescription* arrayType) {
     auto bo = FindInHeap(snapshot, address);
     auto bounds = bo.Add(snapshot->runtimeInformation_.arrayBoundsOffsetInHeader).ReadPointer();
     if (bounds == 0)
@@ -321,6 +1148,26 @@ int CrawledMemorySnapshot::ReadArrayLength(const CrawledMemorySnapshot* snapshot
     return length;
 }
 
+void CrawledMemorySnapshot::ReadArrayBounds(const CrawledMemorySnapshot* snapshot, std::uint64_t address, const TypeDescription* arrayType,
+                                            std::vector<int>& outLengths, std::vector<int>& outLowerBounds) {
+    outLengths.clear();
+    outLowerBounds.clear();
+    auto bo = FindInHeap(snapshot, address);
+    auto bounds = bo.Add(snapshot->runtimeInformation_.arrayBoundsOffsetInHeader).ReadPointer();
+    if (bounds == 0) {
+        outLengths.push_back(bo.Add(snapshot->runtimeInformation_.arraySizeOffsetInHeader).ReadInt32());
+        outLowerBounds.push_back(0);
+        return;
+    }
+    // same bounds layout as ReadArrayLength
+    auto cursor = FindInHeap(snapshot, bounds);
+    for (int i = 0; i < arrayType->ArrayRank(); i++) {
+        outLengths.push_back(cursor.ReadInt32());
+        outLowerBounds.push_back(cursor.Add(4).ReadInt32());
+        cursor = cursor.Add(8);
+    }
+}
+
 void CrawledMemorySnapshot::AllFieldsOf(const CrawledMemorySnapshot* snapshot, const TypeDescription* typeDescription,
                                         FieldFindOptions options, std::vector<const FieldDescription*>& outFields) {
     std::vector<const TypeDescription*> targetTypes = { typeDescription };
@@ -331,7 +1178,7 @@ void CrawledMemorySnapshot::AllFieldsOf(const CrawledMemorySnapshot* snapshot, c
             continue;
         // baseOrElementTypeIndex is Uint in unity source-code
         if (options != FieldFindOptions::OnlyStatic && curType->baseOrElementTypeIndex_ != static_cast<std::uint32_t>(-1)) {
-            auto baseTypeDescription = &snapshot->typeDescriptions_[curType->baseOrElementTypeIndex_];
+            auto baseTypeDescription = &snapshot->typeCatalog_->types_[curType->baseOrElementTypeIndex_];
             targetTypes.push_back(baseTypeDescription);
         }
         for (std::size_t i = 0; i < curType->fields_.size(); i++) {
@@ -342,6 +1189,293 @@ void CrawledMemorySnapshot::AllFieldsOf(const CrawledMemorySnapshot* snapshot, c
     }
 }
 
+void CrawledMemorySnapshot::WriteSnapshot(QDataStream& stream, const CrawledMemorySnapshot* snapshot, const QString& name) {
+    auto saveThing = [&](const ThingInMemory* thing) {
+        stream << thing->index_ << thing->size_;
+        stream << static_cast<quint8>(thing->diff_) << thing->caption_;
+    };
+    stream << name << snapshot->isDiff_;
+    // typeDescriptions
+    auto& catalog = *snapshot->typeCatalog_;
+    auto& types = catalog.types_;
+    stream << static_cast<quint32>(types.size());
+    for (auto& type : types) {
+        stream << static_cast<quint32>(type.flags_);
+        if (!type.IsArray()) {
+            stream << static_cast<quint32>(type.fields_.size());
+            for (auto& field : type.fields_) {
+                stream << field.offset_ << field.typeIndex_ << catalog.FieldName(field) << field.isStatic_;
+            }
+            auto statics = StaticsOf(snapshot, type.typeIndex_);
+            auto staticsSize = snapshot->staticsOffsets_[type.typeIndex_ + 1] - snapshot->staticsOffsets_[type.typeIndex_];
+            stream << staticsSize;
+            if (staticsSize > 0)
+                stream.writeRawData(reinterpret_cast<const char*>(statics.bytes_ + statics.offset_), static_cast<int>(staticsSize));
+        }
+        stream << type.baseOrElementTypeIndex_ << catalog.TypeName(type) << catalog.AssemblyName(type) <<
+                  snapshot->typeInfoAddresses_[type.typeIndex_] << type.size_ << type.typeIndex_;
+    }
+    // gcHandles
+    stream << static_cast<quint32>(snapshot->gcHandles_.size());
+    for (auto& gcHandle : snapshot->gcHandles_) {
+        saveThing(&gcHandle);
+    }
+    // managed
+    stream << static_cast<quint32>(snapshot->managedObjects_.size());
+    for (auto& managed : snapshot->managedObjects_) {
+        saveThing(&managed);
+        stream << managed.address_;
+        stream << managed.typeDescription_->typeIndex_;
+    }
+    // statics
+    stream << static_cast<quint32>(snapshot->staticFields_.size());
+    for (auto& statics : snapshot->staticFields_) {
+        saveThing(&statics);
+        stream << statics.typeDescription_->typeIndex_;
+        stream << statics.nameHash_;
+    }
+    // static field roots
+    stream << static_cast<quint32>(snapshot->staticFieldRoots_.size());
+    for (auto& root : snapshot->staticFieldRoots_) {
+        saveThing(&root);
+        stream << root.typeDescription_->typeIndex_;
+        stream << root.fieldId_;
+        stream << root.nameHash_;
+    }
+    // stacks
+    stream << static_cast<quint32>(snapshot->stackRoots_.size());
+    for (auto& stack : snapshot->stackRoots_) {
+        saveThing(&stack);
+        stream << stack.stackAddress_;
+    }
+    // refs refBys, field ids only with the refs
+    stream << static_cast<quint32>(snapshot->allObjects_.size());
+    for (auto& thing : snapshot->allObjects_) {
+        stream << static_cast<quint32>(thing->references_.size());
+        for (std::size_t j = 0; j < thing->references_.size(); j++)
+            stream << thing->references_[j]->index_ << ReferenceField(snapshot, thing, j);
+        stream << static_cast<quint32>(thing->referencedBy_.size());
+        for (std::size_t j = 0; j < thing->referencedBy_.size(); j++)
+            stream << thing->referencedBy_[j]->index_;
+    }
+    // field paths
+    stream << static_cast<quint32>(snapshot->fieldPaths_.size());
+    for (auto& path : snapshot->fieldPaths_)
+        stream << path.parent_ << path.fieldId_;
+    // memory sections
+    stream << static_cast<quint32>(snapshot->managedHeap_.size());
+    for (auto& section : snapshot->managedHeap_) {
+        stream << section.sectionStartAddress_;
+        stream << section.sectionSize_;
+        if (section.sectionSize_ > 0)
+            stream.writeRawData(reinterpret_cast<const char*>(section.sectionBytes_), static_cast<int>(section.sectionSize_));
+    }
+    // runtime
+    stream << snapshot->runtimeInformation_.pointerSize;
+    stream << snapshot->runtimeInformation_.objectHeaderSize;
+    stream << snapshot->runtimeInformation_.arrayHeaderSize;
+    stream << snapshot->runtimeInformation_.arrayBoundsOffsetInHeader;
+    stream << snapshot->runtimeInformation_.arraySizeOffsetInHeader;
+    stream << snapshot->runtimeInformation_.allocationGranularity;
+}
+
+CrawledMemorySnapshot* CrawledMemorySnapshot::ReadSnapshot(QDataStream& stream, quint32 version) {
+    auto loadThing = [&](ThingInMemory* thing) {
+        quint8 flag;
+        stream >> thing->index_ >> thing->size_ >> flag >> thing->caption_;
+        thing->diff_ = static_cast<CrawledDiffFlags>(flag);
+    };
+    CrawledMemorySnapshot* snapshot = new CrawledMemorySnapshot();
+    stream >> snapshot->name_ >> snapshot->isDiff_;
+    // typeDescriptions
+    quint32 count;
+    stream >> count;
+    std::vector<TypeDescription> types(count);
+    UMPStringPool strings;
+    QString name, assemblyName;
+    std::vector<quint8> staticsBytes;
+    snapshot->staticsOffsets_.assign(count + 1, 0);
+    snapshot->typeInfoAddresses_.resize(count);
+    for (quint32 i = 0; i < count; i++) {
+        auto& type = types[i];
+        quint32 flag;
+        stream >> flag;
+        type.flags_ = static_cast<Il2CppMetadataTypeFlags>(flag);
+        if (!type.IsArray()) {
+            stream >> flag;
+            type.fields_.resize(flag);
+            for (auto& field : type.fields_) {
+                stream >> field.offset_ >> field.typeIndex_ >> name >> field.isStatic_;
+                field.nameId_ = strings.Add(name);
+            }
+            quint32 staticsSize;
+            stream >> staticsSize;
+            if (staticsSize > 0) {
+                staticsBytes.resize(staticsBytes.size() + staticsSize);
+                stream.readRawData(reinterpret_cast<char*>(staticsBytes.data() + staticsBytes.size() - staticsSize), static_cast<int>(staticsSize));
+            }
+        }
+        snapshot->staticsOffsets_[i + 1] = static_cast<std::uint32_t>(staticsBytes.size());
+        stream >> type.baseOrElementTypeIndex_ >> name >> assemblyName >>
+                snapshot->typeInfoAddresses_[i] >> type.size_ >> type.typeIndex_;
+        type.nameId_ = strings.Add(name);
+        type.assemblyNameId_ = strings.Add(assemblyName);
+    }
+    if (!staticsBytes.empty()) {
+        snapshot->staticsBytes_ = new std::uint8_t[staticsBytes.size()];
+        memcpy(snapshot->staticsBytes_, staticsBytes.data(), staticsBytes.size());
+    }
+    snapshot->typeCatalog_ = UMPTypeCatalog::Intern(std::move(types), std::move(strings));
+    auto& catalogTypes = snapshot->typeCatalog_->types_;
+    // gcHandles
+    stream >> count;
+    snapshot->gcHandles_.resize(count);
+    for (auto& gcHandle : snapshot->gcHandles_) {
+        loadThing(&gcHandle);
+    }
+    // managed
+    stream >> count;
+    snapshot->managedObjects_.resize(count);
+    for (auto& managed : snapshot->managedObjects_) {
+        loadThing(&managed);
+        stream >> managed.address_;
+        quint32 typeIndex;
+        stream >> typeIndex;
+        managed.typeDescription_ = &catalogTypes[typeIndex];
+    }
+    // statics
+    stream >> count;
+    snapshot->staticFields_.resize(count);
+    for (auto& statics : snapshot->staticFields_) {
+        loadThing(&statics);
+        quint32 typeIndex;
+        stream >> typeIndex;
+        statics.typeDescription_ = &catalogTypes[typeIndex];
+        stream >> statics.nameHash_;
+    }
+    // static field roots
+    if (version >= APP_VERSION_STATIC_FIELD_ROOTS) {
+        stream >> count;
+        snapshot->staticFieldRoots_.resize(count);
+        for (auto& root : snapshot->staticFieldRoots_) {
+            loadThing(&root);
+            quint32 typeIndex;
+            stream >> typeIndex;
+            root.typeDescription_ = &catalogTypes[typeIndex];
+            stream >> root.fieldId_;
+            stream >> root.nameHash_;
+        }
+    }
+    // stacks
+    if (version >= APP_VERSION_STACK_ROOTS) {
+        stream >> count;
+        snapshot->stackRoots_.resize(count);
+        for (auto& stack : snapshot->stackRoots_) {
+            loadThing(&stack);
+            stream >> stack.stackAddress_;
+        }
+    }
+    // allObjects
+    snapshot->allObjects_.reserve(snapshot->gcHandles_.size() + snapshot->managedObjects_.size() + snapshot->staticFields_.size() +
+                                  snapshot->staticFieldRoots_.size() + snapshot->stackRoots_.size());
+    std::uint32_t index = 0;
+    for (auto& obj : snapshot->gcHandles_) {
+        obj.index_ = index++;
+        snapshot->allObjects_.push_back(&obj);
+    }
+    for (auto& obj : snapshot->staticFields_) {
+        obj.index_ = index++;
+        snapshot->allObjects_.push_back(&obj);
+    }
+    for (auto& obj : snapshot->staticFieldRoots_) {
+        obj.index_ = index++;
+        snapshot->allObjects_.push_back(&obj);
+    }
+    for (auto& obj : snapshot->stackRoots_) {
+        obj.index_ = index++;
+        snapshot->allObjects_.push_back(&obj);
+    }
+    for (auto& obj : snapshot->managedObjects_) {
+        obj.index_ = index++;
+        snapshot->allObjects_.push_back(&obj);
+    }
+    // refs refBys
+    stream >> count;
+    snapshot->referenceFieldStarts_.assign(snapshot->allObjects_.size() + 1, 0);
+    for (auto& thing : snapshot->allObjects_) {
+        quint32 refCount;
+        stream >> refCount;
+        thing->references_.resize(refCount);
+        for (quint32 j = 0; j < refCount; j++) {
+            quint32 refIndex;
+            quint32 fieldId = kFieldIdNone;
+            stream >> refIndex;
+            thing->references_[j] = snapshot->allObjects_[refIndex];
+            if (version >= APP_VERSION_FIELD_IDS)
+                stream >> fieldId;
+            snapshot->referenceFields_.push_back(fieldId);
+        }
+        snapshot->referenceFieldStarts_[thing->index_ + 1] = static_cast<std::uint32_t>(snapshot->referenceFields_.size());
+        stream >> refCount;
+        thing->referencedBy_.resize(refCount);
+        for (quint32 j = 0; j < refCount; j++) {
+            quint32 refIndex;
+            stream >> refIndex;
+            thing->referencedBy_[j] = snapshot->allObjects_[refIndex];
+            // older files repeat the field id on this side
+            if (version >= APP_VERSION_FIELD_IDS && version < APP_VERSION_FIELD_PATHS) {
+                quint32 fieldId;
+                stream >> fieldId;
+            }
+        }
+    }
+    BuildReferencedBySlots(snapshot);
+    // field paths
+    if (version >= APP_VERSION_FIELD_PATHS) {
+        stream >> count;
+        snapshot->fieldPaths_.resize(count);
+        for (auto& path : snapshot->fieldPaths_)
+            stream >> path.parent_ >> path.fieldId_;
+    }
+    // memory sections
+    stream >> count;
+    snapshot->managedHeap_.resize(count);
+    for (auto& section : snapshot->managedHeap_) {
+        stream >> section.sectionStartAddress_;
+        stream >> section.sectionSize_;
+        if (section.sectionSize_ > 0) {
+            section.sectionBytes_ = new quint8[section.sectionSize_];
+            stream.readRawData(reinterpret_cast<char*>(section.sectionBytes_), static_cast<int>(section.sectionSize_));
+        }
+    }
+    // runtime
+    stream >> snapshot->runtimeInformation_.pointerSize;
+    stream >> snapshot->runtimeInformation_.objectHeaderSize;
+    stream >> snapshot->runtimeInformation_.arrayHeaderSize;
+    stream >> snapshot->runtimeInformation_.arrayBoundsOffsetInHeader;
+    stream >> snapshot->runtimeInformation_.arraySizeOffsetInHeader;
+    stream >> snapshot->runtimeInformation_.allocationGranularity;
+    BuildIndices(snapshot);
+    return snapshot;
+}
+
+int CrawledMemorySnapshot::ReadSnapshotFile(QIODevice* device, std::vector<CrawledMemorySnapshot*>& outSnapshots) {
+    QDataStream stream(device);
+    quint32 magic;
+    stream >> magic;
+    if (magic != APP_MAGIC)
+        return -1;
+    quint32 version;
+    stream >> version;
+    if (version > APP_VERSION)
+        return -1;
+    quint32 size;
+    stream >> size;
+    for (quint32 i = 0; i < size; i++)
+        outSnapshots.push_back(ReadSnapshot(stream, version));
+    return 0;
+}
+
 CrawledMemorySnapshot* CrawledMemorySnapshot::Clone(const CrawledMemorySnapshot* src) {
     auto clone = new CrawledMemorySnapshot();
     clone->runtimeInformation_ = src->runtimeInformation_;
@@ -355,10 +1489,14 @@ CrawledMemorySnapshot* CrawledMemorySnapshot::Clone(const CrawledMemorySnapshot*
         newSection->sectionBytes_ = new std::uint8_t[section->sectionSize_];
         memcpy(newSection->sectionBytes_, section->sectionBytes_, section->sectionSize_);
     }
-    // typeDescriptions
-    clone->typeDescriptions_.reserve(src->typeDescriptions_.size());
-    for (auto& type : src->typeDescriptions_)
-        clone->typeDescriptions_.push_back(TypeDescription(type));
+    // types are shared, only the statics are copied
+    clone->typeCatalog_ = src->typeCatalog_;
+    clone->staticsOffsets_ = src->staticsOffsets_;
+    clone->typeInfoAddresses_ = src->typeInfoAddresses_;
+    if (src->staticsBytes_ != nullptr) {
+        clone->staticsBytes_ = new std::uint8_t[src->staticsOffsets_.back()];
+        memcpy(clone->staticsBytes_, src->staticsBytes_, src->staticsOffsets_.back());
+    }
     // gchandle
     clone->gcHandles_.reserve(src->gcHandles_.size());
     for (auto& gchandle : src->gcHandles_) {
@@ -369,15 +1507,30 @@ CrawledMemorySnapshot* CrawledMemorySnapshot::Clone(const CrawledMemorySnapshot*
     for (auto& staticFields : src->staticFields_) {
         clone->staticFields_.push_back(StaticFields(staticFields));
         auto& newStaticFields = clone->staticFields_.back();
-        newStaticFields.typeDescription_ = &clone->typeDescriptions_[staticFields.typeDescription_->typeIndex_];
+        newStaticFields.typeDescription_ = staticFields.typeDescription_;
         newStaticFields.nameHash_ = staticFields.nameHash_;
     }
+    // static field roots
+    clone->staticFieldRoots_.reserve(src->staticFieldRoots_.size());
+    for (auto& root : src->staticFieldRoots_) {
+        clone->staticFieldRoots_.push_back(StaticFieldRoot(root));
+        auto& newRoot = clone->staticFieldRoots_.back();
+        newRoot.typeDescription_ = root.typeDescription_;
+        newRoot.fieldId_ = root.fieldId_;
+        newRoot.nameHash_ = root.nameHash_;
+    }
+    // stacks
+    clone->stackRoots_.reserve(src->stackRoots_.size());
+    for (auto& stack : src->stackRoots_) {
+        clone->stackRoots_.push_back(StackRoot(stack));
+        clone->stackRoots_.back().stackAddress_ = stack.stackAddress_;
+    }
     clone->managedObjects_.reserve(src->managedObjects_.size());
     for (auto& managed : src->managedObjects_) {
         clone->managedObjects_.push_back(ManagedObject(managed));
         auto& newManaged = clone->managedObjects_.back();
         newManaged.address_ = managed.address_;
-        newManaged.typeDescription_ = &clone->typeDescriptions_[managed.typeDescription_->typeIndex_];
+        newManaged.typeDescription_ = managed.typeDescription_;
     }
     // combine
     clone->allObjects_.reserve(src->allObjects_.size());
@@ -390,11 +1543,24 @@ CrawledMemorySnapshot* CrawledMemorySnapshot::Clone(const CrawledMemorySnapshot*
         obj.index_ = index++;
         clone->allObjects_.push_back(&obj);
     }
+    for (auto& obj : clone->staticFieldRoots_) {
+        obj.index_ = index++;
+        clone->allObjects_.push_back(&obj);
+    }
+    for (auto& obj : clone->stackRoots_) {
+        obj.index_ = index++;
+        clone->allObjects_.push_back(&obj);
+    }
     for (auto& obj : clone->managedObjects_) {
         obj.index_ = index++;
         clone->allObjects_.push_back(&obj);
     }
     // connections
+    clone->referenceFields_ = src->referenceFields_;
+    clone->referenceFieldStarts_ = src->referenceFieldStarts_;
+    clone->referencedBySlots_ = src->referencedBySlots_;
+    clone->referencedByStarts_ = src->referencedByStarts_;
+    clone->fieldPaths_ = src->fieldPaths_;
     for (std::size_t i = 0; i < clone->allObjects_.size(); i++) {
         auto cloneObj = clone->allObjects_[i];
         auto secondObj = src->allObjects_[i];
@@ -405,20 +1571,18 @@ CrawledMemorySnapshot* CrawledMemorySnapshot::Clone(const CrawledMemorySnapshot*
         for (auto& ref : secondObj->referencedBy_)
             cloneObj->referencedBy_.push_back(clone->allObjects_[ref->index_]);
     }
+    BuildIndices(clone);
     return clone;
 }
 
 CrawledMemorySnapshot* CrawledMemorySnapshot::Diff(const CrawledMemorySnapshot* firstSnapshot, const CrawledMemorySnapshot* secondSnapshot) {
+    UMPScopedTimer timer("diff");
     auto diffed = CrawledMemorySnapshot::Clone(secondSnapshot);
     // managed
-    std::unordered_map<std::uint64_t, const ManagedObject*> firstManagedObjects;
-    for (auto& managed : firstSnapshot->managedObjects_) {
-        firstManagedObjects[managed.address_] = &managed;
-    }
     for (auto& managed : diffed->managedObjects_) {
-        auto it = firstManagedObjects.find(managed.address_);
-        if (it != firstManagedObjects.end()) {
-            auto firstManaged = it->second;
+        auto firstIndex = FindObjectAt(firstSnapshot, managed.address_);
+        if (firstIndex != kNoManagedObject) {
+            auto firstManaged = &firstSnapshot->managedObjects_[firstIndex];
             managed.size_ -= firstManaged->size_;
             if (managed.size_ == 0)
                 managed.diff_ = CrawledDiffFlags::kSame;
@@ -450,6 +1614,52 @@ CrawledMemorySnapshot* CrawledMemorySnapshot::Diff(const CrawledMemorySnapshot*
             statics.diff_ = CrawledDiffFlags::kAdded;
         }
     }
+    // stacks, matched by the thread's stack address
+    std::unordered_map<std::uint64_t, const StackRoot*> firstStacks;
+    for (auto& stack : firstSnapshot->stackRoots_) {
+        firstStacks[stack.stackAddress_] = &stack;
+    }
+    for (auto& stack : diffed->stackRoots_) {
+        auto it = firstStacks.find(stack.stackAddress_);
+        if (it != firstStacks.end()) {
+            stack.size_ -= it->second->size_;
+            if (stack.size_ == 0)
+                stack.diff_ = CrawledDiffFlags::kSame;
+            else if (stack.size_ > 0)
+                stack.diff_ = CrawledDiffFlags::kBigger;
+            else
+                stack.diff_ = CrawledDiffFlags::kSmaller;
+        } else {
+            stack.diff_ = CrawledDiffFlags::kAdded;
+        }
+    }
+    // static field slots keep their size, so a field is compared by what it retains
+    std::unordered_map<std::uint64_t, const StaticFieldRoot*> firstFieldRoots;
+    for (auto& root : firstSnapshot->staticFieldRoots_) {
+        firstFieldRoots[root.nameHash_] = &root;
+    }
+    std::vector<bool> fieldRootAdded(diffed->staticFieldRoots_.size());
+    for (std::size_t i = 0; i < diffed->staticFieldRoots_.size(); i++) {
+        auto& root = diffed->staticFieldRoots_[i];
+        auto it = firstFieldRoots.find(root.nameHash_);
+        fieldRootAdded[i] = it == firstFieldRoots.end();
+        if (!fieldRootAdded[i])
+            root.size_ -= it->second->size_;
+    }
+    // retained sizes become retained growth
+    BuildRetainedSizes(diffed);
+    for (std::size_t i = 0; i < diffed->staticFieldRoots_.size(); i++) {
+        auto& root = diffed->staticFieldRoots_[i];
+        auto growth = diffed->retainedSizes_[root.index_];
+        if (fieldRootAdded[i])
+            root.diff_ = CrawledDiffFlags::kAdded;
+        else if (growth == 0)
+            root.diff_ = CrawledDiffFlags::kSame;
+        else if (growth > 0)
+            root.diff_ = CrawledDiffFlags::kBigger;
+        else
+            root.diff_ = CrawledDiffFlags::kSmaller;
+    }
     diffed->name_ = "Diff_" + QTime::currentTime().toString("H_m_s");
     diffed->isDiff_ = true;
     return diffed;
@@ -460,8 +1670,7 @@ void CrawledMemorySnapshot::Free(CrawledMemorySnapshot* snapshot) {
         if (section.sectionSize_ > 0)
             delete[] section.sectionBytes_;
     }
-    for (auto& type : snapshot->typeDescriptions_) {
-        if (type.staticsSize_ > 0)
-            delete[] type.statics_;
-    }
+    delete[] snapshot->staticsBytes_;
+    snapshot->staticsBytes_ = nullptr;
+    snapshot->typeCatalog_.reset();
 }
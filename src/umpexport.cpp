@@ -0,0 +1,372 @@
+#include "umpexport.h"
+
+#include <QByteArray>
+#include <QFileInfo>
+#include <QIODevice>
+#include <QtEndian>
+
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include <limits>
+#include <vector>
+
+#include "umpcrawler.h"
+
+const std::size_t kExportBufferSize = 1 << 20;
+const std::uint32_t kColumnarMagic = 0x43504D55; // "UMPC" read little-endian
+const std::uint32_t kColumnarVersion = 1;
+
+enum ExportColumnKind : std::uint8_t {
+    kColumnU32 = 0,
+    kColumnU64,
+    kColumnI64,
+    kColumnString,
+};
+
+// a column reads its value of a row straight from the snapshot, strings are indices into a dictionary
+// so every format escapes each distinct string once
+struct ExportColumn {
+    ExportColumn(const char* name, ExportColumnKind kind, std::function<std::uint64_t(std::size_t)> value,
+                 const std::vector<QByteArray>* dictionary = nullptr)
+        : name_(name), kind_(kind), value_(std::move(value)), dictionary_(dictionary) {}
+    const char* name_;
+    ExportColumnKind kind_;
+    std::function<std::uint64_t(std::size_t)> value_;
+    const std::vector<QByteArray>* dictionary_;
+    bool hex_ = false; // text formats write it as 0x...
+    bool nullable_ = false; // the kind's max value is left empty in csv and null in json
+};
+
+// batches writes into 1MB blocks, formats numbers without going through QString
+class ExportBuffer {
+public:
+    explicit ExportBuffer(QIODevice* device) : device_(device) {
+        data_.reserve(kExportBufferSize);
+    }
+    void Append(const char* data, std::size_t size) {
+        while (size > 0) {
+            auto chunk = std::min(size, kExportBufferSize - data_.size());
+            data_.insert(data_.end(), data, data + chunk);
+            data += chunk;
+            size -= chunk;
+            if (data_.size() == kExportBufferSize)
+                Flush();
+        }
+    }
+    void Append(const QByteArray& bytes) {
+        Append(bytes.constData(), static_cast<std::size_t>(bytes.size()));
+    }
+    void Append(char c) {
+        data_.push_back(c);
+        if (data_.size() == kExportBufferSize)
+            Flush();
+    }
+    void AppendUnsigned(std::uint64_t value) {
+        char digits[20];
+        int count = 0;
+        do {
+            digits[count++] = static_cast<char>('0' + value % 10);
+            value /= 10;
+        } while (value != 0);
+        std::reverse(digits, digits + count);
+        Append(digits, static_cast<std::size_t>(count));
+    }
+    void AppendSigned(std::int64_t value) {
+        if (value < 0) {
+            Append('-');
+            AppendUnsigned(static_cast<std::uint64_t>(0) - static_cast<std::uint64_t>(value));
+        } else {
+            AppendUnsigned(static_cast<std::uint64_t>(value));
+        }
+    }
+    void AppendHex(std::uint64_t value) {
+        char digits[18];
+        int count = 0;
+        do {
+            digits[count++] = "0123456789abcdef"[value & 15];
+            value >>= 4;
+        } while (value != 0);
+        digits[count++] = 'x';
+        digits[count++] = '0';
+        std::reverse(digits, digits + count);
+        Append(digits, static_cast<std::size_t>(count));
+    }
+    template<typename T>
+    void AppendLittleEndian(T value) {
+        value = qToLittleEndian(value);
+        Append(reinterpret_cast<const char*>(&value), sizeof(value));
+    }
+    bool Flush() {
+        if (!data_.empty() && !failed_)
+            failed_ = device_->write(data_.data(), static_cast<qint64>(data_.size())) != static_cast<qint64>(data_.size());
+        data_.clear();
+        return !failed_;
+    }
+    bool Failed() const { return failed_; }
+
+private:
+    QIODevice* device_;
+    std::vector<char> data_;
+    bool failed_ = false;
+};
+
+static QByteArray CsvEscape(const QByteArray& text) {
+    if (text.indexOf(',') < 0 && text.indexOf('"') < 0 && text.indexOf('\n') < 0 && text.indexOf('\r') < 0)
+        return text;
+    QByteArray escaped("\"");
+    for (auto c : text) {
+        if (c == '"')
+            escaped += '"';
+        escaped += c;
+    }
+    escaped += '"';
+    return escaped;
+}
+
+static QByteArray JsonEscape(const QByteArray& text) {
+    QByteArray escaped("\"");
+    for (auto c : text) {
+        auto u = static_cast<unsigned char>(c);
+        if (c == '"' || c == '\\') {
+            escaped += '\\';
+            escaped += c;
+        } else if (u < 0x20) {
+            escaped += QByteArray("\\u00") + QByteArray::number(u >> 4, 16) + QByteArray::number(u & 15, 16);
+        } else {
+            escaped += c;
+        }
+    }
+    escaped += '"';
+    return escaped;
+}
+
+static std::uint64_t NullOf(ExportColumnKind kind) {
+    return kind == kColumnU32 ? std::numeric_limits<std::uint32_t>::max() : std::numeric_limits<std::uint64_t>::max();
+}
+
+static std::vector<std::vector<QByteArray>> EscapeDictionaries(const std::vector<ExportColumn>& columns,
+                                                               QByteArray (*escape)(const QByteArray&)) {
+    std::vector<std::vector<QByteArray>> escaped(columns.size());
+    for (std::size_t c = 0; c < columns.size(); c++) {
+        if (columns[c].dictionary_ == nullptr)
+            continue;
+        for (auto& text : *columns[c].dictionary_)
+            escaped[c].push_back(escape(text));
+    }
+    return escaped;
+}
+
+static void WriteCsv(ExportBuffer& out, const std::vector<ExportColumn>& columns, std::size_t rowCount) {
+    auto dictionaries = EscapeDictionaries(columns, CsvEscape);
+    for (std::size_t c = 0; c < columns.size(); c++) {
+        if (c > 0)
+            out.Append(',');
+        out.Append(columns[c].name_, strlen(columns[c].name_));
+    }
+    out.Append('\n');
+    for (std::size_t row = 0; row < rowCount && !out.Failed(); row++) {
+        for (std::size_t c = 0; c < columns.size(); c++) {
+            auto& column = columns[c];
+            if (c > 0)
+                out.Append(',');
+            auto value = column.value_(row);
+            if (column.kind_ == kColumnString)
+                out.Append(dictionaries[c][static_cast<std::size_t>(value)]);
+            else if (column.nullable_ && value == NullOf(column.kind_))
+                continue;
+            else if (column.hex_)
+                out.AppendHex(value);
+            else if (column.kind_ == kColumnI64)
+                out.AppendSigned(static_cast<std::int64_t>(value));
+            else
+                out.AppendUnsigned(value);
+        }
+        out.Append('\n');
+    }
+}
+
+static void WriteJsonLines(ExportBuffer& out, const std::vector<ExportColumn>& columns, std::size_t rowCount) {
+    auto dictionaries = EscapeDictionaries(columns, JsonEscape);
+    std::vector<QByteArray> keys;
+    for (std::size_t c = 0; c < columns.size(); c++)
+        keys.push_back((c == 0 ? "{" : ",") + JsonEscape(columns[c].name_) + ":");
+    for (std::size_t row = 0; row < rowCount && !out.Failed(); row++) {
+        for (std::size_t c = 0; c < columns.size(); c++) {
+            auto& column = columns[c];
+            out.Append(keys[c]);
+            auto value = column.value_(row);
+            // addresses as strings, javascript numbers stop being exact past 2^53
+            if (column.kind_ == kColumnString) {
+                out.Append(dictionaries[c][static_cast<std::size_t>(value)]);
+            } else if (column.nullable_ && value == NullOf(column.kind_)) {
+                out.Append("null", 4);
+            } else if (column.hex_) {
+                out.Append('"');
+                out.AppendHex(value);
+                out.Append('"');
+            } else if (column.kind_ == kColumnI64) {
+                out.AppendSigned(static_cast<std::int64_t>(value));
+            } else {
+                out.AppendUnsigned(value);
+            }
+        }
+        out.Append("}\n", 2);
+    }
+}
+
+static void WriteColumnar(ExportBuffer& out, const std::vector<ExportColumn>& columns, std::size_t rowCount) {
+    out.AppendLittleEndian(kColumnarMagic);
+    out.AppendLittleEndian(kColumnarVersion);
+    out.AppendLittleEndian(static_cast<std::uint32_t>(rowCount));
+    out.AppendLittleEndian(static_cast<std::uint32_t>(columns.size()));
+    for (auto& column : columns) {
+        auto nameSize = static_cast<std::uint32_t>(strlen(column.name_));
+        out.AppendLittleEndian(nameSize);
+        out.Append(column.name_, nameSize);
+        out.Append(static_cast<char>(column.kind_));
+        for (std::size_t row = 0; row < rowCount && !out.Failed(); row++) {
+            auto value = column.value_(row);
+            switch (column.kind_) {
+            case kColumnU32:
+                out.AppendLittleEndian(static_cast<std::uint32_t>(value));
+                break;
+            case kColumnU64:
+            case kColumnI64:
+                out.AppendLittleEndian(value);
+                break;
+            case kColumnString: {
+                auto& text = (*column.dictionary_)[static_cast<std::size_t>(value)];
+                out.AppendLittleEndian(static_cast<std::uint32_t>(text.size()));
+                out.Append(text);
+                break;
+            }
+            }
+        }
+    }
+}
+
+QString UMPExportSuffix(UMPExportFormat format) {
+    switch (format) {
+    case UMPExportFormat::kJsonLines: return "jsonl";
+    case UMPExportFormat::kColumnar: return "umpc";
+    default: return "csv";
+    }
+}
+
+UMPExportFormat UMPExportFormatOf(const QString& fileName) {
+    auto suffix = QFileInfo(fileName).suffix().toLower();
+    if (suffix == "jsonl" || suffix == "json")
+        return UMPExportFormat::kJsonLines;
+    if (suffix == "umpc")
+        return UMPExportFormat::kColumnar;
+    return UMPExportFormat::kCsv;
+}
+
+int UMPExportSnapshot(const CrawledMemorySnapshot* snapshot, UMPExportTable table, UMPExportFormat format, QIODevice* device) {
+    auto& types = snapshot->typeCatalog_->types_;
+    auto& objects = snapshot->managedObjects_;
+    std::vector<QByteArray> typeNames, assemblyNames;
+    typeNames.reserve(types.size());
+    assemblyNames.reserve(types.size());
+    // straight from the catalog's utf-8, no QString on the way
+    auto& strings = snapshot->typeCatalog_->strings_;
+    for (auto& type : types) {
+        typeNames.push_back(QByteArray(strings.Data(type.nameId_), static_cast<int>(strings.Length(type.nameId_))));
+        assemblyNames.push_back(QByteArray(strings.Data(type.assemblyNameId_), static_cast<int>(strings.Length(type.assemblyNameId_))));
+    }
+    // by CrawledDiffFlags
+    std::vector<QByteArray> diffNames { "", "added", "bigger", "same", "smaller" };
+    auto isDiff = snapshot->isDiff_;
+    std::vector<ExportColumn> columns;
+    std::size_t rowCount = 0;
+    // types table state, filled before the columns read it
+    std::vector<std::uint64_t> typeCounts, typeAddedCounts;
+    std::vector<std::int64_t> typeSizes, typeAddedSizes;
+    std::vector<std::uint32_t> typeRows;
+    if (table == UMPExportTable::kTypes) {
+        typeCounts.assign(types.size(), 0);
+        typeSizes.assign(types.size(), 0);
+        typeAddedCounts.assign(types.size(), 0);
+        typeAddedSizes.assign(types.size(), 0);
+        // same rows as the type table, statics and static field roots count towards their type too
+        auto addThing = [&](std::uint32_t typeIndex, const ThingInMemory& thing) {
+            typeCounts[typeIndex]++;
+            typeSizes[typeIndex] += thing.size_;
+            if (thing.diff_ == CrawledDiffFlags::kAdded) {
+                typeAddedCounts[typeIndex]++;
+                typeAddedSizes[typeIndex] += thing.size_;
+            }
+        };
+        for (auto& statics : snapshot->staticFields_)
+            addThing(statics.typeDescription_->typeIndex_, statics);
+        for (auto& root : snapshot->staticFieldRoots_)
+            addThing(root.typeDescription_->typeIndex_, root);
+        for (auto& managed : objects)
+            addThing(managed.typeDescription_->typeIndex_, managed);
+        for (std::uint32_t i = 0; i < types.size(); i++) {
+            if (typeCounts[i] > 0)
+                typeRows.push_back(i);
+        }
+        std::stable_sort(typeRows.begin(), typeRows.end(), [&typeSizes](std::uint32_t a, std::uint32_t b) {
+            return typeSizes[a] > typeSizes[b];
+        });
+        rowCount = typeRows.size();
+        columns.push_back({ "type_index", kColumnU32, [&](std::size_t row) { return typeRows[row]; } });
+        columns.push_back({ "type", kColumnString, [&](std::size_t row) { return typeRows[row]; }, &typeNames });
+        columns.push_back({ "assembly", kColumnString, [&](std::size_t row) { return typeRows[row]; }, &assemblyNames });
+        columns.push_back({ "count", kColumnU64, [&](std::size_t row) { return typeCounts[typeRows[row]]; } });
+        columns.push_back({ "size", kColumnI64, [&](std::size_t row) {
+            return static_cast<std::uint64_t>(typeSizes[typeRows[row]]);
+        } });
+        if (isDiff) {
+            columns.push_back({ "added_count", kColumnU64, [&](std::size_t row) { return typeAddedCounts[typeRows[row]]; } });
+            columns.push_back({ "added_size", kColumnI64, [&](std::size_t row) {
+                return static_cast<std::uint64_t>(typeAddedSizes[typeRows[row]]);
+            } });
+        }
+    } else {
+        rowCount = objects.size();
+        auto thingIndex = [&objects](std::size_t row) { return objects[row].index_; };
+        columns.push_back({ "index", kColumnU32, [](std::size_t row) { return static_cast<std::uint64_t>(row); } });
+        ExportColumn address { "address", kColumnU64, [&objects](std::size_t row) { return objects[row].address_; } };
+        address.hex_ = true;
+        columns.push_back(address);
+        columns.push_back({ "type_index", kColumnU32, [&objects](std::size_t row) {
+            return static_cast<std::uint64_t>(objects[row].typeDescription_->typeIndex_);
+        } });
+        columns.push_back({ "type", kColumnString, [&objects](std::size_t row) {
+            return static_cast<std::uint64_t>(objects[row].typeDescription_->typeIndex_);
+        }, &typeNames });
+        columns.push_back({ "size", kColumnI64, [&objects](std::size_t row) { return static_cast<std::uint64_t>(objects[row].size_); } });
+        columns.push_back({ "retained_size", kColumnI64, [snapshot, thingIndex](std::size_t row) {
+            return static_cast<std::uint64_t>(snapshot->retainedSizes_[thingIndex(row)]);
+        } });
+        ExportColumn distance { "root_distance", kColumnU32, [snapshot, thingIndex](std::size_t row) {
+            return static_cast<std::uint64_t>(snapshot->rootDistances_[thingIndex(row)]);
+        } };
+        distance.nullable_ = true;
+        columns.push_back(distance);
+        columns.push_back({ "referenced_by", kColumnU32, [&objects](std::size_t row) {
+            return static_cast<std::uint64_t>(objects[row].referencedBy_.size());
+        } });
+        if (isDiff) {
+            columns.push_back({ "diff", kColumnString, [&objects](std::size_t row) {
+                return static_cast<std::uint64_t>(objects[row].diff_);
+            }, &diffNames });
+        }
+    }
+    ExportBuffer out(device);
+    switch (format) {
+    case UMPExportFormat::kCsv:
+        WriteCsv(out, columns, rowCount);
+        break;
+    case UMPExportFormat::kJsonLines:
+        WriteJsonLines(out, columns, rowCount);
+        break;
+    case UMPExportFormat::kColumnar:
+        WriteColumnar(out, columns, rowCount);
+        break;
+    }
+    return out.Flush() ? 0 : -1;
+}
@@ -0,0 +1,118 @@
+#include "umpheapstrip.h"
+
+#include <QPainter>
+#include <QMouseEvent>
+#include <QToolTip>
+#include <QVector>
+
+#include <algorithm>
+
+#include "umpanalyzer.h"
+#include "umpcrawler.h"
+#include "umpmodel.h"
+
+const int kStripRowHeight = 12;
+const int kStripLabelWidth = 110;
+// cells are filled with one brush per occupancy level, so painting costs a call per level rather than per cell
+const int kStripLevels = 16;
+
+UMPHeapStripWidget::UMPHeapStripWidget(const CrawledMemorySnapshot* snapshot, const UMPFragmentationReport* report, QWidget *parent)
+    : QWidget(parent), snapshot_(snapshot), report_(report) {
+    setMouseTracking(true);
+    setMinimumHeight(sizeHint().height());
+}
+
+QSize UMPHeapStripWidget::sizeHint() const {
+    return QSize(kStripLabelWidth + static_cast<int>(kHeatStripCells) * 3, static_cast<int>(report_->sections_.size()) * kStripRowHeight);
+}
+
+void UMPHeapStripWidget::SetCurrentSection(int row) {
+    currentRow_ = row;
+    update();
+}
+
+QRect UMPHeapStripWidget::CellRect(int row, int cell) const {
+    auto stripWidth = width() - kStripLabelWidth;
+    auto left = kStripLabelWidth + stripWidth * cell / static_cast<int>(kHeatStripCells);
+    auto right = kStripLabelWidth + stripWidth * (cell + 1) / static_cast<int>(kHeatStripCells);
+    return QRect(left, row * kStripRowHeight, right - left, kStripRowHeight - 1);
+}
+
+bool UMPHeapStripWidget::CellAt(const QPoint& pos, int& outRow, int& outCell) const {
+    auto stripWidth = width() - kStripLabelWidth;
+    if (pos.x() < kStripLabelWidth || stripWidth <= 0 || pos.y() < 0)
+        return false;
+    outRow = pos.y() / kStripRowHeight;
+    outCell = std::min(static_cast<int>(kHeatStripCells) - 1, (pos.x() - kStripLabelWidth) * static_cast<int>(kHeatStripCells) / stripWidth);
+    return outRow < static_cast<int>(report_->sections_.size());
+}
+
+void UMPHeapStripWidget::paintEvent(QPaintEvent* event) {
+    QPainter painter(this);
+    painter.fillRect(event->rect(), palette().base());
+    auto firstRow = std::max(0, event->rect().top() / kStripRowHeight);
+    auto lastRow = std::min(static_cast<int>(report_->sections_.size()) - 1, event->rect().bottom() / kStripRowHeight);
+    QVector<QRect> levels[kStripLevels];
+    for (auto row = firstRow; row <= lastRow; row++) {
+        auto& section = report_->sections_[static_cast<std::size_t>(row)];
+        for (int cell = 0; cell < static_cast<int>(kHeatStripCells); cell++) {
+            auto live = std::min(1.0f, section.cells_[cell]);
+            levels[std::min(kStripLevels - 1, static_cast<int>(live * kStripLevels))].push_back(CellRect(row, cell));
+        }
+    }
+    painter.setPen(Qt::NoPen);
+    for (int level = 0; level < kStripLevels; level++) {
+        if (levels[level].isEmpty())
+            continue;
+        // red for free, green for live
+        painter.setBrush(QColor::fromHsv(level * 120 / (kStripLevels - 1), 160, 220));
+        painter.drawRects(levels[level]);
+    }
+    painter.setPen(palette().text().color());
+    for (auto row = firstRow; row <= lastRow; row++) {
+        auto& section = report_->sections_[static_cast<std::size_t>(row)];
+        QRect label(2, row * kStripRowHeight, kStripLabelWidth - 4, kStripRowHeight);
+        painter.drawText(label, Qt::AlignLeft | Qt::AlignVCenter, QString::number(section.start_, 16));
+    }
+    if (currentRow_ >= firstRow && currentRow_ <= lastRow) {
+        painter.setPen(QPen(palette().highlight().color(), 2));
+        painter.setBrush(Qt::NoBrush);
+        painter.drawRect(QRect(kStripLabelWidth, currentRow_ * kStripRowHeight, width() - kStripLabelWidth - 1, kStripRowHeight - 1));
+    }
+}
+
+void UMPHeapStripWidget::mousePressEvent(QMouseEvent* event) {
+    int row, cell;
+    if (!CellAt(event->pos(), row, cell))
+        return;
+    SetCurrentSection(row);
+    auto& section = report_->sections_[static_cast<std::size_t>(row)];
+    auto cellBegin = section.start_ + section.size_ * static_cast<std::uint64_t>(cell) / kHeatStripCells;
+    auto cellEnd = section.start_ + section.size_ * static_cast<std::uint64_t>(cell + 1) / kHeatStripCells;
+    // an object reaching into the cell from the left counts as its first one
+    auto index = CrawledMemorySnapshot::FindObjectAt(snapshot_, cellBegin, true);
+    if (index == kNoManagedObject) {
+        auto& addresses = snapshot_->sortedAddresses_;
+        auto i = static_cast<std::size_t>(std::lower_bound(addresses.begin(), addresses.end(), cellBegin) - addresses.begin());
+        if (i < addresses.size() && addresses[i] < cellEnd)
+            index = snapshot_->sortedObjects_[i];
+    }
+    if (index != kNoManagedObject)
+        emit ThingSelected(snapshot_->managedObjects_[index].index_);
+}
+
+void UMPHeapStripWidget::mouseMoveEvent(QMouseEvent* event) {
+    int row, cell;
+    if (!CellAt(event->pos(), row, cell)) {
+        QToolTip::hideText();
+        return;
+    }
+    auto& section = report_->sections_[static_cast<std::size_t>(row)];
+    auto cellBegin = section.start_ + section.size_ * static_cast<std::uint64_t>(cell) / kHeatStripCells;
+    auto cellEnd = section.start_ + section.size_ * static_cast<std::uint64_t>(cell + 1) / kHeatStripCells;
+    QToolTip::showText(event->globalPos(), QString("%1 - %2: %3% live\nsection %4 live, largest hole %5")
+                       .arg(cellBegin, 0, 16).arg(cellEnd, 0, 16)
+                       .arg(static_cast<double>(std::min(1.0f, section.cells_[cell])) * 100, 0, 'f', 0)
+                       .arg(sizeToString(static_cast<qint64>(section.liveSize_)))
+                       .arg(sizeToString(static_cast<qint64>(section.largestHole_))), this);
+}
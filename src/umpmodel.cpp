@@ -4,6 +4,8 @@
 #include <QDebug>
 #include <algorithm>
 
+#include "umpparallel.h"
+
 QString sizeToString(qint64 size) {
     qint64 absSize = std::abs(size);
     if (absSize >= 1024 * 1024 * 1024) {
@@ -33,9 +35,9 @@ int UMPThingInMemoryModel::columnCount(const QModelIndex &) const {
 QVariant UMPThingInMemoryModel::data(const QModelIndex &index, int role) const {
     int row = index.row();
     int column = index.column();
-    if (row >= 0 && row < objects_.size()) {
+    if (row >= 0 && row < static_cast<int>(objects_.size())) {
         if (role == Qt::DisplayRole || role == Qt::ToolTipRole) {
-            auto mo = objects_[row];
+            auto mo = thingAt(row);
             switch(column) {
                 case 0: return mo->caption_;
                 case 1: return static_cast<quint32>(mo->referencedBy_.size());
@@ -55,7 +57,7 @@ QVariant UMPThingInMemoryModel::data(const QModelIndex &index, int role) const {
                     }
             }
         } else if (role == Qt::UserRole) {
-            auto mo = objects_[row];
+            auto mo = thingAt(row);
             switch(column) {
                 case 0: return mo->caption_;
                 case 1: return static_cast<quint32>(mo->referencedBy_.size());
@@ -63,7 +65,7 @@ QVariant UMPThingInMemoryModel::data(const QModelIndex &index, int role) const {
                 case 3: return static_cast<std::uint8_t>(mo->diff_);
             }
         } else if (role == Qt::BackgroundColorRole) {
-            auto mo = objects_[row];
+            auto mo = thingAt(row);
             switch(mo->diff_) {
                 case CrawledDiffFlags::kAdded:
                     return QVariant(QColor(Qt::magenta));
@@ -93,60 +95,170 @@ QVariant UMPThingInMemoryModel::headerData(int section, Qt::Orientation orientat
     return QVariant();
 }
 
-void UMPThingInMemoryModel::reset(const UMPSnapshotType& snapshotType, bool isDiff) {
+void UMPThingInMemoryModel::sort(int column, Qt::SortOrder order) {
+    emit layoutAboutToBeChanged(QList<QPersistentModelIndex>(), QAbstractItemModel::VerticalSortHint);
+    // selection and current index follow their object to its new row
+    auto oldIndexes = persistentIndexList();
+    std::vector<std::uint32_t> spanIndices;
+    spanIndices.reserve(static_cast<std::size_t>(oldIndexes.size()));
+    for (auto& index : oldIndexes) {
+        auto row = static_cast<std::uint32_t>(index.row());
+        spanIndices.push_back(order_.empty() ? row : order_[row]);
+    }
+    sortColumn_ = column;
+    sortOrder_ = order;
+    sortObjects();
+    QModelIndexList newIndexes;
+    newIndexes.reserve(oldIndexes.size());
+    for (int i = 0; i < oldIndexes.size(); i++) {
+        auto span = spanIndices[static_cast<std::size_t>(i)];
+        newIndexes.append(index(static_cast<int>(rows_.empty() ? span : rows_[span]), oldIndexes[i].column()));
+    }
+    changePersistentIndexList(oldIndexes, newIndexes);
+    emit layoutChanged(QList<QPersistentModelIndex>(), QAbstractItemModel::VerticalSortHint);
+}
+
+void UMPThingInMemoryModel::sortObjects() {
+    order_.clear();
+    rows_.clear();
+    if (sortColumn_ < 0 || objects_.size() < 2)
+        return;
+    // pull the raw key out once, then sort indices on it
+    std::vector<std::int64_t> keys(objects_.size());
+    // captions of managed objects are all the type name, address is what tells them apart. statics and
+    // static field roots keep their name order, ranked by caption ahead of the managed objects
+    std::vector<std::uint8_t> kinds(sortColumn_ == 0 ? objects_.size() : 0, 0);
+    if (sortColumn_ == 0) {
+        std::vector<std::uint32_t> named;
+        for (std::size_t i = 0; i < objects_.size(); i++) {
+            if (objects_[i]->type() != ThingType::MANAGED)
+                named.push_back(static_cast<std::uint32_t>(i));
+        }
+        std::sort(named.begin(), named.end(), [this](std::uint32_t a, std::uint32_t b) {
+            return objects_[a]->caption_ < objects_[b]->caption_;
+        });
+        for (std::size_t rank = 0; rank < named.size(); rank++)
+            keys[named[rank]] = static_cast<std::int64_t>(rank);
+    }
+    UMPParallelChunks(objects_.size(), [&](std::size_t, std::size_t begin, std::size_t end) {
+        for (auto i = begin; i < end; i++) {
+            auto thing = objects_[i];
+            switch (sortColumn_) {
+                case 0:
+                    if (thing->type() == ThingType::MANAGED) {
+                        kinds[i] = 1;
+                        keys[i] = static_cast<std::int64_t>(static_cast<ManagedObject*>(thing)->address_);
+                    }
+                    break;
+                case 1: keys[i] = static_cast<std::int64_t>(thing->referencedBy_.size()); break;
+                case 2: keys[i] = thing->size_; break;
+                default: keys[i] = static_cast<std::int64_t>(thing->diff_); break;
+            }
+        }
+    });
+    order_.resize(objects_.size());
+    for (std::size_t i = 0; i < order_.size(); i++)
+        order_[i] = static_cast<std::uint32_t>(i);
+    auto descending = sortOrder_ == Qt::DescendingOrder;
+    UMPParallelSort(order_, [&](std::uint32_t a, std::uint32_t b) {
+        if (!kinds.empty() && kinds[a] != kinds[b])
+            return descending ? kinds[a] > kinds[b] : kinds[a] < kinds[b];
+        if (keys[a] != keys[b])
+            return descending ? keys[a] > keys[b] : keys[a] < keys[b];
+        return a < b;
+    });
+    rows_.resize(order_.size());
+    for (std::size_t row = 0; row < order_.size(); row++)
+        rows_[order_[row]] = static_cast<std::uint32_t>(row);
+}
+
+void UMPThingInMemoryModel::reset(const UMPTypeGroupModel* typeGroups, int typeRow, bool isDiff) {
     isDiff_ = isDiff;
     beginResetModel();
-    objects_.clear();
-    auto size = static_cast<int>(snapshotType.objects_.size());
-    objects_.reserve(size);
-    std::copy(snapshotType.objects_.begin(), snapshotType.objects_.end(), std::back_inserter(objects_));
+    auto& snapshotType = typeGroups->getSubModel(typeRow);
+    typeGroups_ = typeGroups;
+    offset_ = snapshotType.offset_;
+    objects_ = snapshotType.objects_;
+    sortObjects();
     endResetModel();
 }
 
 int UMPThingInMemoryModel::indexOf(const ThingInMemory* thing) const {
-    for (int i = 0; i < objects_.size(); i++) {
-        auto object = objects_[i];
-        if (object == thing)
-            return i;
-    }
-    return -1;
+    if (typeGroups_ == nullptr)
+        return -1;
+    auto position = typeGroups_->groupPositionOf(thing);
+    if (position == kNoGroupPosition || position < offset_ || position - offset_ >= objects_.size())
+        return -1;
+    auto i = position - offset_;
+    return static_cast<int>(rows_.empty() ? i : rows_[i]);
 }
 
 // UMPTypeGroupModel
 
 UMPTypeGroupModel::UMPTypeGroupModel(CrawledMemorySnapshot* snapshot, QObject* parent)
     : QAbstractTableModel(parent), snapshot_(snapshot) {
-    std::unordered_map<std::uint32_t, std::vector<ThingInMemory*>> filters;
-    for (auto& obj : snapshot->staticFields_) {
-        auto& vector = filters[obj.typeDescription_->typeIndex_];
-        vector.push_back(&obj);
-    }
-    for (auto& obj : snapshot->managedObjects_) {
-        auto& vector = filters[obj.typeDescription_->typeIndex_];
-        vector.push_back(&obj);
-    }
-    std::unordered_map<std::int64_t, std::int64_t> typeSizes;
-    for (const auto& pair : filters)
-        typeSizes[pair.first] = 0;
-    for (const auto& pair : filters) {
-        auto& size = typeSizes[pair.first];
-        for (const auto& obj : pair.second)
-            size += obj->size_;
-    }
+    // counting sort of statics, static fields and managed objects by type index, every chunk keeps its own
+    // histogram so the scatter needs no locks and preserves the crawl order inside a type
+    auto typeCount = snapshot->typeCatalog_->types_.size();
+    auto staticCount = snapshot->staticFields_.size();
+    auto fieldRootEnd = staticCount + snapshot->staticFieldRoots_.size();
+    auto itemCount = fieldRootEnd + snapshot->managedObjects_.size();
+    auto typeIndexOf = [snapshot, staticCount, fieldRootEnd](std::size_t i) {
+        if (i < staticCount)
+            return snapshot->staticFields_[i].typeDescription_->typeIndex_;
+        if (i < fieldRootEnd)
+            return snapshot->staticFieldRoots_[i - staticCount].typeDescription_->typeIndex_;
+        return snapshot->managedObjects_[i - fieldRootEnd].typeDescription_->typeIndex_;
+    };
+    auto thingOf = [snapshot, staticCount, fieldRootEnd](std::size_t i) -> ThingInMemory* {
+        if (i < staticCount)
+            return &snapshot->staticFields_[i];
+        if (i < fieldRootEnd)
+            return &snapshot->staticFieldRoots_[i - staticCount];
+        return &snapshot->managedObjects_[i - fieldRootEnd];
+    };
+    auto chunkCount = UMPChunkCount(itemCount);
+    std::vector<std::uint32_t> counts(chunkCount * typeCount, 0);
+    std::vector<std::int64_t> sizes(chunkCount * typeCount, 0);
+    UMPParallelChunks(itemCount, chunkCount, [&](std::size_t chunk, std::size_t begin, std::size_t end) {
+        auto chunkCounts = counts.data() + chunk * typeCount;
+        auto chunkSizes = sizes.data() + chunk * typeCount;
+        for (auto i = begin; i < end; i++) {
+            auto typeIndex = typeIndexOf(i);
+            chunkCounts[typeIndex]++;
+            chunkSizes[typeIndex] += thingOf(i)->size_;
+        }
+    });
+    // counts become the scatter position of every chunk
+    groupedObjects_.resize(itemCount);
+    groupPositions_.assign(snapshot->allObjects_.size(), kNoGroupPosition);
+    types_.resize(typeCount);
     totalSize_ = 0;
-    for (std::size_t i = 0; i < snapshot->typeDescriptions_.size(); i++) {
-        auto& type = snapshot->typeDescriptions_[i];
-        types_.push_back(UMPSnapshotType());
-        auto group = &types_.back();
-        group->type_ = &type;
-        group->name_ = type.name_;
-        group->size_ = typeSizes[group->type_->typeIndex_];
-        group->objects_ = std::move(filters[group->type_->typeIndex_]);
-        totalSize_ += group->size_;
-
-
-
+    std::uint32_t offset = 0;
+    for (std::size_t i = 0; i < typeCount; i++) {
+        auto& group = types_[i];
+        group.type_ = &snapshot->typeCatalog_->types_[i];
+        group.offset_ = offset;
+        for (std::size_t chunk = 0; chunk < chunkCount; chunk++) {
+            auto& count = counts[chunk * typeCount + i];
+            auto chunkItems = count;
+            count = offset;
+            offset += chunkItems;
+            group.size_ += sizes[chunk * typeCount + i];
+        }
+        group.objects_.data_ = groupedObjects_.data() + group.offset_;
+        group.objects_.size_ = offset - group.offset_;
+        totalSize_ += group.size_;
     }
+    UMPParallelChunks(itemCount, chunkCount, [&](std::size_t chunk, std::size_t begin, std::size_t end) {
+        auto positions = counts.data() + chunk * typeCount;
+        for (auto i = begin; i < end; i++) {
+            auto thing = thingOf(i);
+            auto position = positions[typeIndexOf(i)]++;
+            groupedObjects_[position] = thing;
+            groupPositions_[thing->index_] = position;
+        }
+    });
 }
 
 UMPTypeGroupModel::~UMPTypeGroupModel() {
@@ -157,7 +269,7 @@ UMPTypeGroupModel::~UMPTypeGroupModel() {
 }
 
 int UMPTypeGroupModel::rowCount(const QModelIndex &) const {
-    return types_.size();
+    return static_cast<int>(types_.size());
 }
 
 int UMPTypeGroupModel::columnCount(const QModelIndex &) const {
@@ -167,48 +279,24 @@ int UMPTypeGroupModel::columnCount(const QModelIndex &) const {
 QVariant UMPTypeGroupModel::data(const QModelIndex &index, int role) const {
     int row = index.row();
     int column = index.column();
-    if (row >= 0 && row < types_.size()) {
+    if (row >= 0 && row < static_cast<int>(types_.size())) {
         if (role == Qt::DisplayRole || role == Qt::ToolTipRole) {
-            auto type = types_[row];
+            const auto& type = types_[static_cast<std::size_t>(row)];
             switch(column) {
-                case 1: {
-                    //qDebug("readString = %s",qPrintable(type.name_));
-                    //GlobalLogDef::writeToFile(row,1) ;
-                   // GlobalLogDef::writeToFile(type.name_,0) ;
-
-                    return type.name_;
-                }
+                case 1: return snapshot_->typeCatalog_->TypeName(*type.type_);
                 case 2: return static_cast<quint32>(type.objects_.size());
                 case 3: return sizeToString(type.size_);
-                case 0: {
-                    //QString str = QString::number(row);
-                    //GlobalLogDef::writeToFile(str,1) ;
-                   // qDebug("readString = %s",row);
-                     return row;
-
-                }
+                case 0: return row;
             }
-
         } else if (role == Qt::UserRole) {
-            auto type = types_[row];
+            const auto& type = types_[static_cast<std::size_t>(row)];
             switch(column) {
-            case 1: {
-                    //qDebug("readString = %s",qPrintable(type.name_));
-                    //GlobalLogDef::writeToFile(type.name_,0) ;
-                    return type.name_;
-                }
+                case 1: return snapshot_->typeCatalog_->TypeName(*type.type_);
                 case 2: return static_cast<quint32>(type.objects_.size());
                 case 3: return type.size_;
                 case 0: return row;
             }
-
-
-
-
         }
-
-
-
     }
 
     return QVariant();
@@ -228,3 +316,649 @@ QVariant UMPTypeGroupModel::headerData(int section, Qt::Orientation orientation,
     }
     return QVariant();
 }
+
+// UMPLazyListModel
+
+const int kLazyListPageSize = 4096;
+
+int UMPLazyListModel::rowCount(const QModelIndex &parent) const {
+    return parent.isValid() ? 0 : fetchedRows_;
+}
+
+QVariant UMPLazyListModel::data(const QModelIndex &index, int role) const {
+    int row = index.row();
+    if (row < 0 || row >= fetchedRows_)
+        return QVariant();
+    if (role == Qt::ToolTipRole)
+        role = Qt::DisplayRole;
+    if (role != Qt::DisplayRole && role != Qt::UserRole)
+        return QVariant();
+    return rowData(row, role);
+}
+
+bool UMPLazyListModel::canFetchMore(const QModelIndex &parent) const {
+    return !parent.isValid() && fetchedRows_ < totalRows_;
+}
+
+void UMPLazyListModel::fetchMore(const QModelIndex &parent) {
+    if (parent.isValid())
+        return;
+    auto count = std::min(kLazyListPageSize, totalRows_ - fetchedRows_);
+    if (count <= 0)
+        return;
+    beginInsertRows(QModelIndex(), fetchedRows_, fetchedRows_ + count - 1);
+    fetchedRows_ += count;
+    endInsertRows();
+}
+
+void UMPLazyListModel::resetRows(int totalRows) {
+    totalRows_ = std::max(0, totalRows);
+    fetchedRows_ = std::min(kLazyListPageSize, totalRows_);
+}
+
+static QString linkCaptionOf(const CrawledMemorySnapshot* snapshot, const ThingInMemory* thing) {
+    if (thing->type() == ThingType::STATIC)
+        return snapshot->typeCatalog_->TypeName(*static_cast<const StaticFields*>(thing)->typeDescription_);
+    if (thing->type() == ThingType::MANAGED) {
+        auto managed = static_cast<const ManagedObject*>(thing);
+        if (managed->typeDescription_->primitiveKind_ == PrimitiveKind::kString)
+            return CrawledMemorySnapshot::ReadString(snapshot, CrawledMemorySnapshot::FindInHeap(snapshot, managed->address_));
+    }
+    return thing->caption_;
+}
+
+// UMPThingLinkModel
+
+void UMPThingLinkModel::reset(const CrawledMemorySnapshot* snapshot, const ThingInMemory* thing, Direction direction) {
+    beginResetModel();
+    snapshot_ = snapshot;
+    thing_ = thing;
+    direction_ = direction;
+    std::size_t count = 0;
+    if (thing != nullptr)
+        count = direction == Direction::kReferences ? thing->references_.size() : thing->referencedBy_.size();
+    resetRows(static_cast<int>(std::min<std::size_t>(count, std::numeric_limits<int>::max())));
+    endResetModel();
+}
+
+QVariant UMPThingLinkModel::rowData(int row, int role) const {
+    auto i = static_cast<std::size_t>(row);
+    if (direction_ == Direction::kReferences) {
+        auto to = thing_->references_[i];
+        if (role == Qt::UserRole)
+            return to->index_;
+        return linkCaptionOf(snapshot_, to);
+    }
+    auto from = thing_->referencedBy_[i];
+    if (role == Qt::UserRole)
+        return from->index_;
+    return linkCaptionOf(snapshot_, from) + CrawledMemorySnapshot::EdgeName(snapshot_, from, thing_, CrawledMemorySnapshot::ReferencedByField(snapshot_, thing_, i));
+}
+
+// UMPObjectValueModel
+
+// nested structs deeper than this are shown as {...}
+const int kMaxValueDepth = 2;
+
+UMPObjectValueModel::~UMPObjectValueModel() {
+    delete reader_;
+}
+
+void UMPObjectValueModel::reset(const CrawledMemorySnapshot* snapshot, const ManagedObject* managed) {
+    beginResetModel();
+    if (snapshot_ != snapshot) {
+        delete reader_;
+        reader_ = new PrimitiveValueReader(snapshot);
+        snapshot_ = snapshot;
+    }
+    managed_ = managed;
+    elementType_ = nullptr;
+    lengths_.clear();
+    lowerBounds_.clear();
+    int rows = 0;
+    auto type = managed != nullptr ? managed->typeDescription_ : nullptr;
+    if (type != nullptr && type->primitiveKind_ == PrimitiveKind::kString) {
+        rows = 1;
+    } else if (type != nullptr && type->IsArray()) {
+        CrawledMemorySnapshot::ReadArrayBounds(snapshot, managed->address_, type, lengths_, lowerBounds_);
+        std::int64_t count = 1;
+        for (auto length : lengths_)
+            count *= std::max(0, length);
+        rows = static_cast<int>(std::min<std::int64_t>(count, std::numeric_limits<int>::max()));
+        elementType_ = &snapshot->typeCatalog_->types_[type->baseOrElementTypeIndex_];
+        elementSize_ = elementType_->IsValueType() ? static_cast<std::uint32_t>(elementType_->size_) : snapshot->runtimeInformation_.pointerSize;
+        elements_ = CrawledMemorySnapshot::FindInHeap(snapshot, managed->address_).Add(snapshot->runtimeInformation_.arrayHeaderSize);
+    }
+    resetRows(rows);
+    endResetModel();
+}
+
+QVariant UMPObjectValueModel::rowData(int row, int role) const {
+    if (elementType_ == nullptr) {
+        if (role == Qt::UserRole)
+            return QVariant();
+        return CrawledMemorySnapshot::ReadString(snapshot_, CrawledMemorySnapshot::FindInHeap(snapshot_, managed_->address_));
+    }
+    auto bo = elements_.Add(static_cast<std::uint32_t>(row) * elementSize_);
+    if (elementType_->IsValueType()) {
+        if (role == Qt::UserRole)
+            return QVariant();
+        return indexText(row) + " " + valueText(elementType_, bo, 0);
+    }
+    auto index = CrawledMemorySnapshot::FindObjectAt(snapshot_, bo.ReadPointer());
+    auto thing = index != kNoManagedObject ? &snapshot_->managedObjects_[index] : nullptr;
+    if (role == Qt::UserRole)
+        return thing != nullptr ? thing->index_ : std::numeric_limits<std::uint32_t>::max();
+    return indexText(row) + " " + (thing != nullptr ? linkCaptionOf(snapshot_, thing) : QString("nullptr"));
+}
+
+// "[i]" or "[i,j,...]" with the lower bounds applied, the last dimension varies fastest
+QString UMPObjectValueModel::indexText(int row) const {
+    std::vector<int> indices(lengths_.size());
+    for (std::size_t i = lengths_.size(); i-- > 0;) {
+        auto length = std::max(1, lengths_[i]);
+        indices[i] = row % length + lowerBounds_[i];
+        row /= length;
+    }
+    QString text = "[";
+    for (std::size_t i = 0; i < indices.size(); i++) {
+        if (i > 0)
+            text += ",";
+        text += QString::number(indices[i]);
+    }
+    return text + "]";
+}
+
+QString UMPObjectValueModel::valueText(const TypeDescription* type, const BytesAndOffset& bo, int depth) const {
+    if (type->primitiveKind_ != PrimitiveKind::kNone && type->primitiveKind_ != PrimitiveKind::kString)
+        return reader_->ReadPrimitiveAsString(type->primitiveKind_, bo);
+    if (!type->IsValueType()) {
+        auto address = bo.ReadPointer();
+        if (address == 0)
+            return "nullptr";
+        auto index = CrawledMemorySnapshot::FindObjectAt(snapshot_, address);
+        if (index == kNoManagedObject)
+            return QString("0x%1").arg(address, 0, 16);
+        return linkCaptionOf(snapshot_, &snapshot_->managedObjects_[index]);
+    }
+    if (depth >= kMaxValueDepth)
+        return "{...}";
+    std::vector<const FieldDescription*> fields;
+    CrawledMemorySnapshot::AllFieldsOf(snapshot_, type, FieldFindOptions::OnlyInstance, fields);
+    QString text = "{";
+    for (std::size_t i = 0; i < fields.size(); i++) {
+        auto field = fields[i];
+        if (field->typeIndex_ == type->typeIndex_ || field->offset_ == static_cast<std::uint32_t>(-1))
+            continue;
+        if (text.size() > 1)
+            text += ", ";
+        // field offsets count the object header, which unboxed values don't have
+        auto fieldLocation = bo.Add(field->offset_ - snapshot_->runtimeInformation_.objectHeaderSize);
+        text += snapshot_->typeCatalog_->FieldName(*field) + ": " + valueText(&snapshot_->typeCatalog_->types_[field->typeIndex_], fieldLocation, depth + 1);
+    }
+    return text + "}";
+}
+
+// UMPManagedListModel
+
+void UMPManagedListModel::reset(const CrawledMemorySnapshot* snapshot, const std::vector<std::uint32_t>* objects) {
+    beginResetModel();
+    snapshot_ = snapshot;
+    objects_ = objects;
+    resetRows(objects != nullptr ? static_cast<int>(std::min<std::size_t>(objects->size(), std::numeric_limits<int>::max())) : 0);
+    endResetModel();
+}
+
+QVariant UMPManagedListModel::rowData(int row, int role) const {
+    auto& managed = snapshot_->managedObjects_[(*objects_)[static_cast<std::size_t>(row)]];
+    if (role == Qt::UserRole)
+        return managed.index_;
+    return QString("%1  (%2 refs)").arg(managed.address_, 0, 16).arg(static_cast<quint32>(managed.referencedBy_.size()));
+}
+
+// UMPDuplicateGroupModel
+
+// longer previews are cut, the full text stays in the details panel
+const int kMaxPreviewLength = 256;
+
+UMPDuplicateGroupModel::UMPDuplicateGroupModel(const CrawledMemorySnapshot* snapshot, std::vector<UMPDuplicateGroup> groups, QObject* parent)
+    : QAbstractTableModel(parent), snapshot_(snapshot), groups_(std::move(groups)) {
+    for (auto& group : groups_)
+        wastedSize_ += group.wastedSize_;
+}
+
+int UMPDuplicateGroupModel::rowCount(const QModelIndex &) const {
+    return static_cast<int>(groups_.size());
+}
+
+int UMPDuplicateGroupModel::columnCount(const QModelIndex &) const {
+    return 4;
+}
+
+QVariant UMPDuplicateGroupModel::data(const QModelIndex &index, int role) const {
+    int row = index.row();
+    if (row < 0 || row >= static_cast<int>(groups_.size()))
+        return QVariant();
+    auto& group = groupAt(row);
+    if (role == Qt::DisplayRole || role == Qt::ToolTipRole) {
+        switch (index.column()) {
+            case 0: return previewOf(group);
+            case 1: return static_cast<quint32>(group.objects_.size());
+            case 2: return sizeToString(group.instanceSize_);
+            case 3: return sizeToString(group.wastedSize_);
+        }
+    } else if (role == Qt::UserRole) {
+        switch (index.column()) {
+            case 0: return previewOf(group);
+            case 1: return static_cast<quint32>(group.objects_.size());
+            case 2: return static_cast<qint64>(group.instanceSize_);
+            case 3: return static_cast<qint64>(group.wastedSize_);
+        }
+    }
+    return QVariant();
+}
+
+QVariant UMPDuplicateGroupModel::headerData(int section, Qt::Orientation orientation, int role) const {
+    if (orientation == Qt::Horizontal && role == Qt::DisplayRole) {
+        switch (section) {
+            case 0: return "Value";
+            case 1: return "Count";
+            case 2: return "Size";
+            case 3: return "Wasted";
+        }
+    }
+    return QVariant();
+}
+
+QString UMPDuplicateGroupModel::previewOf(const UMPDuplicateGroup& group) const {
+    auto& managed = snapshot_->managedObjects_[group.objects_[0]];
+    auto type = managed.typeDescription_;
+    if (type->primitiveKind_ == PrimitiveKind::kString) {
+        auto text = CrawledMemorySnapshot::ReadString(snapshot_, CrawledMemorySnapshot::FindInHeap(snapshot_, managed.address_));
+        if (text.size() > kMaxPreviewLength)
+            text = text.left(kMaxPreviewLength) + "...";
+        return text;
+    }
+    if (type->IsArray())
+        return QString("%1 (%2 elements)").arg(snapshot_->typeCatalog_->TypeName(*type)).arg(CrawledMemorySnapshot::ReadArrayLength(snapshot_, managed.address_, type));
+    return snapshot_->typeCatalog_->TypeName(*type);
+}
+
+// UMPDuplicateTypeModel
+
+UMPDuplicateTypeModel::UMPDuplicateTypeModel(const CrawledMemorySnapshot* snapshot, std::vector<UMPDuplicateTypeSummary> summaries, QObject* parent)
+    : QAbstractTableModel(parent), snapshot_(snapshot), summaries_(std::move(summaries)) {}
+
+int UMPDuplicateTypeModel::rowCount(const QModelIndex &) const {
+    return static_cast<int>(summaries_.size());
+}
+
+int UMPDuplicateTypeModel::columnCount(const QModelIndex &) const {
+    return 4;
+}
+
+QVariant UMPDuplicateTypeModel::data(const QModelIndex &index, int role) const {
+    int row = index.row();
+    if (row < 0 || row >= static_cast<int>(summaries_.size()))
+        return QVariant();
+    auto& summary = summaries_[static_cast<std::size_t>(row)];
+    if (role == Qt::DisplayRole || role == Qt::ToolTipRole || role == Qt::UserRole) {
+        switch (index.column()) {
+            case 0: return snapshot_->typeCatalog_->TypeName(*typeAt(row));
+            case 1: return summary.groupCount_;
+            case 2: return summary.copyCount_;
+            case 3:
+                if (role == Qt::UserRole)
+                    return static_cast<qint64>(summary.wastedSize_);
+                return sizeToString(summary.wastedSize_);
+        }
+    }
+    return QVariant();
+}
+
+QVariant UMPDuplicateTypeModel::headerData(int section, Qt::Orientation orientation, int role) const {
+    if (orientation == Qt::Horizontal && role == Qt::DisplayRole) {
+        switch (section) {
+            case 0: return "Type";
+            case 1: return "Groups";
+            case 2: return "Copies";
+            case 3: return "Wasted";
+        }
+    }
+    return QVariant();
+}
+
+// UMPRollupModel
+
+UMPRollupModel::UMPRollupModel(std::vector<UMPRollupNode> nodes, QObject* parent)
+    : QAbstractItemModel(parent), nodes_(std::move(nodes)) {
+    rows_.resize(nodes_.size(), 0);
+    for (auto& node : nodes_) {
+        for (std::size_t i = 0; i < node.children_.size(); i++)
+            rows_[node.children_[i]] = static_cast<int>(i);
+    }
+}
+
+QModelIndex UMPRollupModel::index(int row, int column, const QModelIndex &parent) const {
+    auto& node = nodeAt(parent);
+    if (row < 0 || row >= static_cast<int>(node.children_.size()))
+        return QModelIndex();
+    return createIndex(row, column, static_cast<quintptr>(node.children_[static_cast<std::size_t>(row)]));
+}
+
+QModelIndex UMPRollupModel::parent(const QModelIndex &index) const {
+    if (!index.isValid())
+        return QModelIndex();
+    auto parent = nodeAt(index).parent_;
+    if (parent == 0)
+        return QModelIndex();
+    return createIndex(rows_[parent], 0, static_cast<quintptr>(parent));
+}
+
+int UMPRollupModel::rowCount(const QModelIndex &parent) const {
+    if (parent.isValid() && parent.column() != 0)
+        return 0;
+    return static_cast<int>(nodeAt(parent).children_.size());
+}
+
+int UMPRollupModel::columnCount(const QModelIndex &) const {
+    return 4;
+}
+
+QVariant UMPRollupModel::data(const QModelIndex &index, int role) const {
+    if (!index.isValid())
+        return QVariant();
+    auto& node = nodeAt(index);
+    if (role == Qt::DisplayRole || role == Qt::ToolTipRole || role == Qt::UserRole) {
+        switch (index.column()) {
+            case 0: return node.name_;
+            case 1: return node.count_;
+            case 2:
+                if (role == Qt::UserRole)
+                    return static_cast<qint64>(node.shallowSize_);
+                return sizeToString(node.shallowSize_);
+            case 3:
+                if (role == Qt::UserRole)
+                    return static_cast<qint64>(node.retainedSize_);
+                return sizeToString(node.retainedSize_);
+        }
+    }
+    return QVariant();
+}
+
+QVariant UMPRollupModel::headerData(int section, Qt::Orientation orientation, int role) const {
+    if (orientation == Qt::Horizontal && role == Qt::DisplayRole) {
+        switch (section) {
+            case 0: return "Name";
+            case 1: return "Count";
+            case 2: return "Shallow";
+            case 3: return "Retained";
+        }
+    }
+    return QVariant();
+}
+
+// UMPHeapSectionModel
+
+UMPHeapSectionModel::UMPHeapSectionModel(UMPFragmentationReport report, QObject* parent)
+    : QAbstractTableModel(parent), report_(std::move(report)) {}
+
+int UMPHeapSectionModel::rowCount(const QModelIndex &) const {
+    return static_cast<int>(report_.sections_.size());
+}
+
+int UMPHeapSectionModel::columnCount(const QModelIndex &) const {
+    return 6;
+}
+
+QVariant UMPHeapSectionModel::data(const QModelIndex &index, int role) const {
+    int row = index.row();
+    if (row < 0 || row >= static_cast<int>(report_.sections_.size()))
+        return QVariant();
+    auto& section = report_.sections_[static_cast<std::size_t>(row)];
+    auto occupancy = section.size_ > 0 ? 100.0 * static_cast<double>(section.liveSize_) / static_cast<double>(section.size_) : 0.0;
+    if (role == Qt::UserRole) {
+        switch (index.column()) {
+            case 0: return static_cast<qint64>(section.start_);
+            case 1: return static_cast<qint64>(section.size_);
+            case 2: return static_cast<qint64>(section.liveSize_);
+            case 3: return static_cast<qint64>(occupancy * 100);
+            case 4: return section.holeCount_;
+            case 5: return static_cast<qint64>(section.largestHole_);
+        }
+    } else if (role == Qt::DisplayRole || role == Qt::ToolTipRole) {
+        switch (index.column()) {
+            case 0: return QString::number(section.start_, 16);
+            case 1: return sizeToString(static_cast<qint64>(section.size_));
+            case 2: return QString("%1 (%2 objects)").arg(sizeToString(static_cast<qint64>(section.liveSize_))).arg(section.objectCount_);
+            case 3: return QString("%1%").arg(occupancy, 0, 'f', 1);
+            case 4: return section.holeCount_;
+            case 5: return sizeToString(static_cast<qint64>(section.largestHole_));
+        }
+    }
+    return QVariant();
+}
+
+QVariant UMPHeapSectionModel::headerData(int section, Qt::Orientation orientation, int role) const {
+    if (orientation == Qt::Horizontal && role == Qt::DisplayRole) {
+        switch (section) {
+            case 0: return "Address";
+            case 1: return "Size";
+            case 2: return "Live";
+            case 3: return "Occupancy";
+            case 4: return "Holes";
+            case 5: return "Largest Hole";
+        }
+    }
+    return QVariant();
+}
+
+// UMPHoleHistogramModel
+
+UMPHoleHistogramModel::UMPHoleHistogramModel(const UMPFragmentationReport* report, QObject* parent)
+    : QAbstractTableModel(parent), report_(report) {
+    for (std::uint32_t bucket = 0; bucket < kHoleBuckets; bucket++) {
+        if (report_->holeCounts_[bucket] > 0)
+            buckets_.push_back(bucket);
+    }
+}
+
+int UMPHoleHistogramModel::rowCount(const QModelIndex &) const {
+    return static_cast<int>(buckets_.size());
+}
+
+int UMPHoleHistogramModel::columnCount(const QModelIndex &) const {
+    return 3;
+}
+
+QVariant UMPHoleHistogramModel::data(const QModelIndex &index, int role) const {
+    int row = index.row();
+    if (row < 0 || row >= static_cast<int>(buckets_.size()))
+        return QVariant();
+    auto bucket = buckets_[static_cast<std::size_t>(row)];
+    if (role == Qt::UserRole) {
+        switch (index.column()) {
+            case 0: return bucket;
+            case 1: return static_cast<qint64>(report_->holeCounts_[bucket]);
+            case 2: return static_cast<qint64>(report_->holeSizes_[bucket]);
+        }
+    } else if (role == Qt::DisplayRole || role == Qt::ToolTipRole) {
+        switch (index.column()) {
+            case 0: return QString("%1 - %2").arg(sizeToString(qint64(1) << bucket)).arg(sizeToString(qint64(1) << (bucket + 1)));
+            case 1: return static_cast<quint64>(report_->holeCounts_[bucket]);
+            case 2: return sizeToString(static_cast<qint64>(report_->holeSizes_[bucket]));
+        }
+    }
+    return QVariant();
+}
+
+QVariant UMPHoleHistogramModel::headerData(int section, Qt::Orientation orientation, int role) const {
+    if (orientation == Qt::Horizontal && role == Qt::DisplayRole) {
+        switch (section) {
+            case 0: return "Hole Size";
+            case 1: return "Count";
+            case 2: return "Total";
+        }
+    }
+    return QVariant();
+}
+
+// UMPUnreachableTypeModel
+
+UMPUnreachableTypeModel::UMPUnreachableTypeModel(const CrawledMemorySnapshot* snapshot, UMPHeapWalkReport report, QObject* parent)
+    : QAbstractTableModel(parent), snapshot_(snapshot), report_(std::move(report)) {}
+
+int UMPUnreachableTypeModel::rowCount(const QModelIndex &) const {
+    return static_cast<int>(report_.types_.size());
+}
+
+int UMPUnreachableTypeModel::columnCount(const QModelIndex &) const {
+    return 3;
+}
+
+QVariant UMPUnreachableTypeModel::data(const QModelIndex &index, int role) const {
+    int row = index.row();
+    if (row < 0 || row >= static_cast<int>(report_.types_.size()))
+        return QVariant();
+    auto& summary = report_.types_[static_cast<std::size_t>(row)];
+    if (role == Qt::DisplayRole || role == Qt::ToolTipRole || role == Qt::UserRole) {
+        switch (index.column()) {
+            case 0: return snapshot_->typeCatalog_->TypeName(snapshot_->typeCatalog_->types_[summary.typeIndex_]);
+            case 1: return summary.count_;
+            case 2:
+                if (role == Qt::UserRole)
+                    return static_cast<qint64>(summary.size_);
+                return sizeToString(static_cast<qint64>(summary.size_));
+        }
+    }
+    return QVariant();
+}
+
+QVariant UMPUnreachableTypeModel::headerData(int section, Qt::Orientation orientation, int role) const {
+    if (orientation == Qt::Horizontal && role == Qt::DisplayRole) {
+        switch (section) {
+            case 0: return "Type";
+            case 1: return "Count";
+            case 2: return "Size";
+        }
+    }
+    return QVariant();
+}
+
+// UMPRootModel
+
+UMPRootModel::UMPRootModel(const CrawledMemorySnapshot* snapshot, UMPRootReport report, QObject* parent)
+    : QAbstractTableModel(parent), snapshot_(snapshot), report_(std::move(report)),
+      firstManaged_(static_cast<std::uint32_t>(snapshot->allObjects_.size() - snapshot->managedObjects_.size())) {}
+
+int UMPRootModel::rowCount(const QModelIndex &) const {
+    return static_cast<int>(report_.roots_.size());
+}
+
+int UMPRootModel::columnCount(const QModelIndex &) const {
+    return 5;
+}
+
+std::uint32_t UMPRootModel::thingToShow(int row) const {
+    auto index = report_.roots_[static_cast<std::size_t>(row)].index_;
+    auto thing = snapshot_->allObjects_[index];
+    if (thing->type() == ThingType::GCHANDLE) {
+        auto target = static_cast<const GCHandle*>(thing)->target_;
+        return target == kNoManagedObject ? kNoManagedObject : firstManaged_ + target;
+    }
+    return index;
+}
+
+QVariant UMPRootModel::data(const QModelIndex &index, int role) const {
+    int row = index.row();
+    if (row < 0 || row >= static_cast<int>(report_.roots_.size()))
+        return QVariant();
+    auto& summary = report_.roots_[static_cast<std::size_t>(row)];
+    auto thing = snapshot_->allObjects_[summary.index_];
+    if (role == Qt::DisplayRole || role == Qt::ToolTipRole || role == Qt::UserRole) {
+        switch (index.column()) {
+            case 0:
+                if (thing->type() == ThingType::GCHANDLE)
+                    return QString("gchandle %1").arg(summary.index_);
+                return linkCaptionOf(snapshot_, thing);
+            case 1:
+                switch (thing->type()) {
+                    case ThingType::GCHANDLE: return "GCHandle";
+                    case ThingType::STATIC: return "Static";
+                    case ThingType::STATIC_FIELD: return "Static Field";
+                    case ThingType::STACK: return "Stack";
+                    default: return QVariant();
+                }
+            case 2:
+                if (thing->type() == ThingType::GCHANDLE) {
+                    auto target = static_cast<const GCHandle*>(thing)->target_;
+                    if (target == kNoManagedObject)
+                        return "null";
+                    auto& managed = snapshot_->managedObjects_[target];
+                    return QString("%1 %2").arg(snapshot_->typeCatalog_->TypeName(*managed.typeDescription_)).arg(managed.address_, 0, 16);
+                }
+                return QString("%1 references").arg(static_cast<quint64>(thing->references_.size()));
+            case 3: return summary.retainedCount_;
+            case 4:
+                if (role == Qt::UserRole)
+                    return static_cast<qint64>(summary.retainedSize_);
+                return sizeToString(summary.retainedSize_);
+        }
+    }
+    return QVariant();
+}
+
+QVariant UMPRootModel::headerData(int section, Qt::Orientation orientation, int role) const {
+    if (orientation == Qt::Horizontal && role == Qt::DisplayRole) {
+        switch (section) {
+            case 0: return "Root";
+            case 1: return "Kind";
+            case 2: return "Holds";
+            case 3: return "Retained Count";
+            case 4: return "Retained Size";
+        }
+    }
+    return QVariant();
+}
+
+// UMPQueryGroupModel
+
+UMPQueryGroupModel::UMPQueryGroupModel(const CrawledMemorySnapshot* snapshot, UMPQueryResult result, QObject* parent)
+    : QAbstractTableModel(parent), snapshot_(snapshot), result_(std::move(result)) {}
+
+int UMPQueryGroupModel::rowCount(const QModelIndex &) const {
+    return static_cast<int>(result_.groups_.size());
+}
+
+int UMPQueryGroupModel::columnCount(const QModelIndex &) const {
+    return 3;
+}
+
+QVariant UMPQueryGroupModel::data(const QModelIndex &index, int role) const {
+    int row = index.row();
+    if (row < 0 || row >= static_cast<int>(result_.groups_.size()))
+        return QVariant();
+    auto& group = groupAt(row);
+    if (role == Qt::DisplayRole || role == Qt::ToolTipRole || role == Qt::UserRole) {
+        switch (index.column()) {
+            case 0: return group.key_;
+            case 1: return static_cast<quint32>(group.objects_.size());
+            case 2:
+                if (role == Qt::UserRole)
+                    return static_cast<qint64>(group.size_);
+                return sizeToString(group.size_);
+        }
+    }
+    return QVariant();
+}
+
+QVariant UMPQueryGroupModel::headerData(int section, Qt::Orientation orientation, int role) const {
+    if (orientation == Qt::Horizontal && role == Qt::DisplayRole) {
+        switch (section) {
+            case 0: return "Group";
+            case 1: return "Count";
+            case 2: return "Size";
+        }
+    }
+    return QVariant();
+}
@@ -0,0 +1,529 @@
+#include "umpquery.h"
+
+#include <QMap>
+#include <QRegExp>
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+#include "umpcrawler.h"
+#include "umpparallel.h"
+
+enum class QueryField {
+    kType,
+    kAssembly,
+    kSize,
+    kRefCount,
+    kRefs,
+    kAddress
+};
+
+enum class QueryOp {
+    kEq,
+    kNe,
+    kLt,
+    kLe,
+    kGt,
+    kGe,
+    kMatch
+};
+
+struct QueryNode {
+    enum class Kind {
+        kAnd,
+        kOr,
+        kNot,
+        kTypeMask,
+        kCompare
+    };
+    Kind kind_ = Kind::kCompare;
+    int left_ = -1;
+    int right_ = -1;
+    QueryField field_ = QueryField::kSize;
+    QueryOp op_ = QueryOp::kEq;
+    std::uint64_t value_ = 0;
+    std::vector<std::uint8_t> typeMask_; // by type index, for type and assembly predicates
+};
+
+struct QueryToken {
+    enum class Kind {
+        kIdent,
+        kString,
+        kNumber,
+        kOp,
+        kLParen,
+        kRParen,
+        kEnd
+    };
+    Kind kind_ = Kind::kEnd;
+    QString text_;
+    std::uint64_t number_ = 0;
+    int pos_ = 0;
+};
+
+// splits the query into tokens, false with outError set on a character it can't place
+bool TokenizeQuery(const QString& query, std::vector<QueryToken>& outTokens, QString& outError) {
+    int i = 0;
+    int length = query.size();
+    while (i < length) {
+        auto c = query[i];
+        if (c.isSpace()) {
+            i++;
+            continue;
+        }
+        QueryToken token;
+        token.pos_ = i;
+        if (c == '(' || c == ')') {
+            token.kind_ = c == '(' ? QueryToken::Kind::kLParen : QueryToken::Kind::kRParen;
+            i++;
+        } else if (c == '"') {
+            auto end = query.indexOf('"', i + 1);
+            if (end < 0) {
+                outError = QString("unterminated string at %1").arg(i);
+                return false;
+            }
+            token.kind_ = QueryToken::Kind::kString;
+            token.text_ = query.mid(i + 1, end - i - 1);
+            i = end + 1;
+        } else if (c.isDigit()) {
+            int start = i;
+            bool hex = c == '0' && i + 1 < length && (query[i + 1] == 'x' || query[i + 1] == 'X');
+            if (hex)
+                i += 2;
+            while (i < length && (query[i].isLetterOrNumber() || query[i] == '.'))
+                i++;
+            auto text = query.mid(start, i - start);
+            bool ok = false;
+            if (hex) {
+                token.number_ = text.mid(2).toULongLong(&ok, 16);
+            } else {
+                // size suffixes are 1024 based like sizeToString
+                std::uint64_t unit = 1;
+                auto upper = text.toUpper();
+                if (upper.endsWith("KB"))
+                    unit = 1024;
+                else if (upper.endsWith("MB"))
+                    unit = 1024 * 1024;
+                else if (upper.endsWith("GB"))
+                    unit = 1024 * 1024 * 1024;
+                if (unit != 1)
+                    upper.chop(2);
+                else if (upper.endsWith("B"))
+                    upper.chop(1);
+                auto value = upper.toDouble(&ok) * static_cast<double>(unit);
+                ok = ok && value >= 0;
+                // max() rounds up to 2^64 as a double, anything from there on doesn't fit
+                if (ok && !(value < static_cast<double>(std::numeric_limits<std::uint64_t>::max()))) {
+                    outError = QString("number '%1' at %2 is out of range").arg(text).arg(start);
+                    return false;
+                }
+                if (ok)
+                    token.number_ = static_cast<std::uint64_t>(value);
+            }
+            if (!ok) {
+                outError = QString("bad number '%1' at %2").arg(text).arg(start);
+                return false;
+            }
+            token.kind_ = QueryToken::Kind::kNumber;
+        } else if (c.isLetter() || c == '_') {
+            int start = i;
+            while (i < length && (query[i].isLetterOrNumber() || query[i] == '_'))
+                i++;
+            token.kind_ = QueryToken::Kind::kIdent;
+            token.text_ = query.mid(start, i - start);
+        } else {
+            static const char* kOps[] = { "==", "!=", "<=", ">=", "<", ">", "~", "=" };
+            for (auto op : kOps) {
+                if (query.mid(i, static_cast<int>(strlen(op))) == op) {
+                    token.kind_ = QueryToken::Kind::kOp;
+                    token.text_ = op;
+                    break;
+                }
+            }
+            if (token.kind_ != QueryToken::Kind::kOp) {
+                outError = QString("unexpected '%1' at %2").arg(c).arg(i);
+                return false;
+            }
+            i += token.text_.size();
+        }
+        outTokens.push_back(token);
+    }
+    QueryToken end;
+    end.pos_ = length;
+    outTokens.push_back(end);
+    return true;
+}
+
+// recursive descent over
+//   query := [expr] ["group" "by" ident]
+//   expr := term {"or" term}, term := factor {"and" factor}
+//   factor := "not" factor | "(" expr ")" | ident op (string | number)
+class QueryParser {
+public:
+    QueryParser(const CrawledMemorySnapshot* snapshot, const std::vector<QueryToken>& tokens, std::vector<QueryNode>& nodes)
+        : snapshot_(snapshot), tokens_(tokens), nodes_(nodes) {}
+    bool Parse(int& outRoot, UMPQueryGroupBy& outGroupBy, QString& outError) {
+        outRoot = -1;
+        outGroupBy = UMPQueryGroupBy::kNone;
+        if (!IsKeyword("group") && Peek().kind_ != QueryToken::Kind::kEnd) {
+            outRoot = ParseOr();
+            if (outRoot < 0) {
+                outError = error_;
+                return false;
+            }
+        }
+        if (IsKeyword("group")) {
+            Next();
+            if (!IsKeyword("by")) {
+                outError = QString("expected 'by' at %1").arg(Peek().pos_);
+                return false;
+            }
+            Next();
+            auto& key = Next();
+            auto keyName = key.text_.toLower();
+            if (key.kind_ == QueryToken::Kind::kIdent && keyName == "type") {
+                outGroupBy = UMPQueryGroupBy::kType;
+            } else if (key.kind_ == QueryToken::Kind::kIdent && keyName == "assembly") {
+                outGroupBy = UMPQueryGroupBy::kAssembly;
+            } else {
+                outError = QString("can only group by type or assembly, at %1").arg(key.pos_);
+                return false;
+            }
+        }
+        if (Peek().kind_ != QueryToken::Kind::kEnd) {
+            outError = QString("unexpected '%1' at %2").arg(Peek().text_).arg(Peek().pos_);
+            return false;
+        }
+        return true;
+    }
+private:
+    const QueryToken& Peek() const {
+        return tokens_[position_];
+    }
+    const QueryToken& Next() {
+        auto& token = tokens_[position_];
+        if (token.kind_ != QueryToken::Kind::kEnd)
+            position_++;
+        return token;
+    }
+    bool IsKeyword(const char* keyword) const {
+        return Peek().kind_ == QueryToken::Kind::kIdent && Peek().text_.toLower() == keyword;
+    }
+    int Fail(const QString& error) {
+        if (error_.isEmpty())
+            error_ = error;
+        return -1;
+    }
+    int AddNode(QueryNode&& node) {
+        nodes_.push_back(std::move(node));
+        return static_cast<int>(nodes_.size() - 1);
+    }
+    int AddBinary(QueryNode::Kind kind, int left, int right) {
+        QueryNode node;
+        node.kind_ = kind;
+        node.left_ = left;
+        node.right_ = right;
+        return AddNode(std::move(node));
+    }
+    int ParseOr() {
+        auto left = ParseAnd();
+        while (left >= 0 && IsKeyword("or")) {
+            Next();
+            auto right = ParseAnd();
+            if (right < 0)
+                return -1;
+            left = AddBinary(QueryNode::Kind::kOr, left, right);
+        }
+        return left;
+    }
+    int ParseAnd() {
+        auto left = ParseFactor();
+        while (left >= 0 && IsKeyword("and")) {
+            Next();
+            auto right = ParseFactor();
+            if (right < 0)
+                return -1;
+            left = AddBinary(QueryNode::Kind::kAnd, left, right);
+        }
+        return left;
+    }
+    int ParseFactor() {
+        if (IsKeyword("not")) {
+            Next();
+            auto child = ParseFactor();
+            if (child < 0)
+                return -1;
+            return AddBinary(QueryNode::Kind::kNot, child, -1);
+        }
+        if (Peek().kind_ == QueryToken::Kind::kLParen) {
+            Next();
+            auto inner = ParseOr();
+            if (inner < 0)
+                return -1;
+            if (Peek().kind_ != QueryToken::Kind::kRParen)
+                return Fail(QString("expected ')' at %1").arg(Peek().pos_));
+            Next();
+            return inner;
+        }
+        return ParseComparison();
+    }
+    int ParseComparison() {
+        auto& fieldToken = Next();
+        if (fieldToken.kind_ != QueryToken::Kind::kIdent)
+            return Fail(QString("expected a field at %1").arg(fieldToken.pos_));
+        QueryNode node;
+        auto fieldName = fieldToken.text_.toLower();
+        if (fieldName == "type")
+            node.field_ = QueryField::kType;
+        else if (fieldName == "assembly")
+            node.field_ = QueryField::kAssembly;
+        else if (fieldName == "size")
+            node.field_ = QueryField::kSize;
+        else if (fieldName == "refcount")
+            node.field_ = QueryField::kRefCount;
+        else if (fieldName == "refs")
+            node.field_ = QueryField::kRefs;
+        else if (fieldName == "address")
+            node.field_ = QueryField::kAddress;
+        else
+            return Fail(QString("unknown field '%1' at %2").arg(fieldToken.text_).arg(fieldToken.pos_));
+        auto& opToken = Next();
+        if (opToken.kind_ != QueryToken::Kind::kOp)
+            return Fail(QString("expected an operator at %1").arg(opToken.pos_));
+        if (opToken.text_ == "==" || opToken.text_ == "=")
+            node.op_ = QueryOp::kEq;
+        else if (opToken.text_ == "!=")
+            node.op_ = QueryOp::kNe;
+        else if (opToken.text_ == "<")
+            node.op_ = QueryOp::kLt;
+        else if (opToken.text_ == "<=")
+            node.op_ = QueryOp::kLe;
+        else if (opToken.text_ == ">")
+            node.op_ = QueryOp::kGt;
+        else if (opToken.text_ == ">=")
+            node.op_ = QueryOp::kGe;
+        else
+            node.op_ = QueryOp::kMatch;
+        auto& valueToken = Next();
+        bool textField = node.field_ == QueryField::kType || node.field_ == QueryField::kAssembly;
+        if (textField) {
+            if (valueToken.kind_ != QueryToken::Kind::kString && valueToken.kind_ != QueryToken::Kind::kIdent)
+                return Fail(QString("expected a string at %1").arg(valueToken.pos_));
+            if (node.op_ != QueryOp::kEq && node.op_ != QueryOp::kNe && node.op_ != QueryOp::kMatch)
+                return Fail(QString("%1 only supports ==, != and ~, at %2").arg(fieldName).arg(opToken.pos_));
+            CompileTypeMask(node, valueToken.text_);
+            node.kind_ = QueryNode::Kind::kTypeMask;
+        } else {
+            if (valueToken.kind_ != QueryToken::Kind::kNumber)
+                return Fail(QString("expected a number at %1").arg(valueToken.pos_));
+            if (node.op_ == QueryOp::kMatch)
+                return Fail(QString("~ only applies to type and assembly, at %1").arg(opToken.pos_));
+            node.value_ = valueToken.number_;
+            node.kind_ = QueryNode::Kind::kCompare;
+        }
+        return AddNode(std::move(node));
+    }
+    // string predicates only depend on the type, so they are evaluated once per type here
+    void CompileTypeMask(QueryNode& node, const QString& value) {
+        auto& types = snapshot_->typeCatalog_->types_;
+        node.typeMask_.resize(types.size());
+        QRegExp wildcard(value, Qt::CaseInsensitive, QRegExp::Wildcard);
+        for (std::size_t i = 0; i < types.size(); i++) {
+            auto text = node.field_ == QueryField::kType ? snapshot_->typeCatalog_->TypeName(types[i]) : snapshot_->typeCatalog_->AssemblyName(types[i]);
+            bool match = node.op_ == QueryOp::kMatch ? wildcard.exactMatch(text) : text == value;
+            // "Texture*" should find UnityEngine.Texture2D, so type patterns also try the name without its namespace
+            if (!match && node.op_ == QueryOp::kMatch && node.field_ == QueryField::kType)
+                match = wildcard.exactMatch(text.mid(text.lastIndexOf('.') + 1));
+            node.typeMask_[i] = static_cast<std::uint8_t>(node.op_ == QueryOp::kNe ? !match : match);
+        }
+    }
+private:
+    const CrawledMemorySnapshot* snapshot_;
+    const std::vector<QueryToken>& tokens_;
+    std::vector<QueryNode>& nodes_;
+    std::size_t position_ = 0;
+    QString error_;
+};
+
+struct QueryColumns {
+    std::vector<std::uint32_t> typeIndex_;
+    std::vector<std::int64_t> size_;
+    std::vector<std::uint32_t> refCount_;
+    std::vector<std::uint32_t> refs_;
+    std::vector<std::uint64_t> address_;
+};
+
+template<typename T, typename V>
+void CompareColumn(const T* column, std::size_t count, QueryOp op, V value, std::uint8_t* out) {
+    // one loop per operator keeps the bodies branch free
+    switch (op) {
+    case QueryOp::kEq: for (std::size_t i = 0; i < count; i++) out[i] = column[i] == value; break;
+    case QueryOp::kNe: for (std::size_t i = 0; i < count; i++) out[i] = column[i] != value; break;
+    case QueryOp::kLt: for (std::size_t i = 0; i < count; i++) out[i] = column[i] < value; break;
+    case QueryOp::kLe: for (std::size_t i = 0; i < count; i++) out[i] = column[i] <= value; break;
+    case QueryOp::kGt: for (std::size_t i = 0; i < count; i++) out[i] = column[i] > value; break;
+    case QueryOp::kGe: for (std::size_t i = 0; i < count; i++) out[i] = column[i] >= value; break;
+    default: std::fill(out, out + count, static_cast<std::uint8_t>(0)); break;
+    }
+}
+
+const std::size_t kQueryBlockSize = 4096;
+
+// evaluates node over rows [begin, begin + count) into out, scratch holds one block per tree level
+void EvaluateQueryNode(const std::vector<QueryNode>& nodes, int index, const QueryColumns& columns, std::size_t begin, std::size_t count,
+                       std::uint8_t* out, std::vector<std::vector<std::uint8_t>>& scratch, std::size_t depth) {
+    auto& node = nodes[static_cast<std::size_t>(index)];
+    switch (node.kind_) {
+    case QueryNode::Kind::kAnd:
+    case QueryNode::Kind::kOr: {
+        if (scratch.size() <= depth)
+            scratch.resize(depth + 1, std::vector<std::uint8_t>(kQueryBlockSize));
+        EvaluateQueryNode(nodes, node.left_, columns, begin, count, out, scratch, depth + 1);
+        auto right = scratch[depth].data();
+        EvaluateQueryNode(nodes, node.right_, columns, begin, count, right, scratch, depth + 1);
+        if (node.kind_ == QueryNode::Kind::kAnd) {
+            for (std::size_t i = 0; i < count; i++)
+                out[i] &= right[i];
+        } else {
+            for (std::size_t i = 0; i < count; i++)
+                out[i] |= right[i];
+        }
+        break;
+    }
+    case QueryNode::Kind::kNot:
+        EvaluateQueryNode(nodes, node.left_, columns, begin, count, out, scratch, depth + 1);
+        for (std::size_t i = 0; i < count; i++)
+            out[i] ^= 1;
+        break;
+    case QueryNode::Kind::kTypeMask: {
+        auto typeIndex = columns.typeIndex_.data() + begin;
+        auto mask = node.typeMask_.data();
+        for (std::size_t i = 0; i < count; i++)
+            out[i] = mask[typeIndex[i]];
+        break;
+    }
+    case QueryNode::Kind::kCompare:
+        switch (node.field_) {
+        case QueryField::kSize:
+            CompareColumn(columns.size_.data() + begin, count, node.op_, static_cast<std::int64_t>(node.value_), out);
+            break;
+        case QueryField::kRefCount:
+            CompareColumn(columns.refCount_.data() + begin, count, node.op_, node.value_, out);
+            break;
+        case QueryField::kRefs:
+            CompareColumn(columns.refs_.data() + begin, count, node.op_, node.value_, out);
+            break;
+        default:
+            CompareColumn(columns.address_.data() + begin, count, node.op_, node.value_, out);
+            break;
+        }
+        break;
+    }
+}
+
+bool UMPRunQuery(const CrawledMemorySnapshot* snapshot, const QString& query, UMPQueryResult& outResult, QString& outError) {
+    outResult = UMPQueryResult();
+    std::vector<QueryToken> tokens;
+    if (!TokenizeQuery(query, tokens, outError))
+        return false;
+    std::vector<QueryNode> nodes;
+    int root;
+    QueryParser parser(snapshot, tokens, nodes);
+    if (!parser.Parse(root, outResult.groupBy_, outError))
+        return false;
+    // only copy out the columns the query reads
+    bool needRefCount = false, needRefs = false, needAddress = false;
+    for (auto& node : nodes) {
+        if (node.kind_ != QueryNode::Kind::kCompare)
+            continue;
+        needRefCount |= node.field_ == QueryField::kRefCount;
+        needRefs |= node.field_ == QueryField::kRefs;
+        needAddress |= node.field_ == QueryField::kAddress;
+    }
+    auto& objects = snapshot->managedObjects_;
+    auto count = objects.size();
+    QueryColumns columns;
+    columns.typeIndex_.resize(count);
+    columns.size_.resize(count);
+    if (needRefCount)
+        columns.refCount_.resize(count);
+    if (needRefs)
+        columns.refs_.resize(count);
+    if (needAddress)
+        columns.address_.resize(count);
+    auto chunkCount = UMPChunkCount(count);
+    std::vector<std::vector<std::uint32_t>> chunkMatches(chunkCount);
+    UMPParallelChunks(count, chunkCount, [&](std::size_t chunk, std::size_t begin, std::size_t end) {
+        for (std::size_t i = begin; i < end; i++) {
+            auto& managed = objects[i];
+            columns.typeIndex_[i] = managed.typeDescription_->typeIndex_;
+            columns.size_[i] = managed.size_;
+            if (needRefCount)
+                columns.refCount_[i] = static_cast<std::uint32_t>(managed.referencedBy_.size());
+            if (needRefs)
+                columns.refs_[i] = static_cast<std::uint32_t>(managed.references_.size());
+            if (needAddress)
+                columns.address_[i] = managed.address_;
+        }
+        auto& matches = chunkMatches[chunk];
+        if (root < 0) {
+            for (auto i = begin; i < end; i++)
+                matches.push_back(static_cast<std::uint32_t>(i));
+            return;
+        }
+        std::vector<std::uint8_t> mask(kQueryBlockSize);
+        std::vector<std::vector<std::uint8_t>> scratch;
+        for (auto block = begin; block < end; block += kQueryBlockSize) {
+            auto blockCount = std::min(kQueryBlockSize, end - block);
+            EvaluateQueryNode(nodes, root, columns, block, blockCount, mask.data(), scratch, 0);
+            for (std::size_t i = 0; i < blockCount; i++) {
+                if (mask[i])
+                    matches.push_back(static_cast<std::uint32_t>(block + i));
+            }
+        }
+    });
+    // bucket the matches, chunks are concatenated in order so each group stays sorted by index
+    std::vector<std::uint32_t> keyOfType(snapshot->typeCatalog_->types_.size(), 0);
+    std::vector<QString> keys;
+    if (outResult.groupBy_ == UMPQueryGroupBy::kType) {
+        for (std::size_t i = 0; i < keyOfType.size(); i++) {
+            keyOfType[i] = static_cast<std::uint32_t>(i);
+            keys.push_back(snapshot->typeCatalog_->TypeName(snapshot->typeCatalog_->types_[i]));
+        }
+    } else if (outResult.groupBy_ == UMPQueryGroupBy::kAssembly) {
+        QMap<QString, std::uint32_t> assemblies;
+        for (std::size_t i = 0; i < keyOfType.size(); i++) {
+            auto assembly = snapshot->typeCatalog_->AssemblyName(snapshot->typeCatalog_->types_[i]);
+            auto it = assemblies.find(assembly);
+            if (it == assemblies.end()) {
+                it = assemblies.insert(assembly, static_cast<std::uint32_t>(keys.size()));
+                keys.push_back(assembly);
+            }
+            keyOfType[i] = it.value();
+        }
+    } else {
+        keys.push_back("All");
+    }
+    std::vector<std::uint32_t> groupOfKey(keys.size(), std::numeric_limits<std::uint32_t>::max());
+    for (auto& matches : chunkMatches) {
+        for (auto index : matches) {
+            auto key = keyOfType[columns.typeIndex_[index]];
+            if (groupOfKey[key] == std::numeric_limits<std::uint32_t>::max()) {
+                groupOfKey[key] = static_cast<std::uint32_t>(outResult.groups_.size());
+                UMPQueryGroup group;
+                group.key_ = keys[key];
+                outResult.groups_.push_back(group);
+            }
+            auto& group = outResult.groups_[groupOfKey[key]];
+            group.objects_.push_back(index);
+            group.size_ += columns.size_[index];
+            outResult.matchCount_++;
+            outResult.matchSize_ += columns.size_[index];
+        }
+    }
+    std::sort(outResult.groups_.begin(), outResult.groups_.end(), [](const UMPQueryGroup& a, const UMPQueryGroup& b) {
+        return a.size_ > b.size_;
+    });
+    return true;
+}
@@ -0,0 +1,51 @@
+#include "umpstringpool.h"
+
+#include <QByteArray>
+
+const std::size_t kInitialSlotCount = 1024;
+
+UMPStringPool::UMPStringPool() {
+    slots_.assign(kInitialSlotCount, 0);
+    Add("", 0);
+}
+
+std::uint32_t UMPStringPool::Add(const char* text, std::uint32_t length) {
+    auto mask = slots_.size() - 1;
+    auto slot = static_cast<std::size_t>(UMPHashBytes(text, length)) & mask;
+    while (slots_[slot] != 0) {
+        auto id = slots_[slot] - 1;
+        if (Length(id) == length && memcmp(Data(id), text, length) == 0)
+            return id;
+        slot = (slot + 1) & mask;
+    }
+    auto id = static_cast<std::uint32_t>(bytes_.size());
+    bytes_.resize(bytes_.size() + sizeof(length) + length + 1);
+    memcpy(&bytes_[id], &length, sizeof(length));
+    memcpy(&bytes_[id + sizeof(length)], text, length);
+    bytes_.back() = 0;
+    slots_[slot] = id + 1;
+    // kept at most half full so probes stay short
+    if (++count_ * 2 > slots_.size())
+        Rehash(slots_.size() * 2);
+    return id;
+}
+
+std::uint32_t UMPStringPool::Add(const QString& text) {
+    auto utf8 = text.toUtf8();
+    return Add(utf8.constData(), static_cast<std::uint32_t>(utf8.size()));
+}
+
+void UMPStringPool::Rehash(std::size_t slotCount) {
+    std::vector<std::uint32_t> slots(slotCount, 0);
+    auto mask = slotCount - 1;
+    for (auto entry : slots_) {
+        if (entry == 0)
+            continue;
+        auto id = entry - 1;
+        auto slot = static_cast<std::size_t>(UMPHashBytes(Data(id), Length(id))) & mask;
+        while (slots[slot] != 0)
+            slot = (slot + 1) & mask;
+        slots[slot] = entry;
+    }
+    slots_.swap(slots);
+}
@@ -0,0 +1,146 @@
+#include "umptrace.h"
+
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QStringList>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+
+static std::atomic<bool> capturing_ {false};
+static std::mutex traceMutex_;
+static UMPTrace trace_;
+// steady clock nanoseconds at BeginCapture, 0 before the first capture
+static std::atomic<std::int64_t> clockStart_ {0};
+static std::atomic<std::uint32_t> threadCount_ {0};
+
+static std::uint32_t& CurrentDepth() {
+    thread_local std::uint32_t depth = 0;
+    return depth;
+}
+
+static std::int64_t SteadyNanoseconds() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void UMPTraceRecorder::BeginCapture(const QString& name) {
+    std::lock_guard<std::mutex> lock(traceMutex_);
+    trace_.name_ = name;
+    trace_.events_.clear();
+    clockStart_ = SteadyNanoseconds();
+    capturing_ = true;
+}
+
+UMPTrace UMPTraceRecorder::EndCapture() {
+    std::lock_guard<std::mutex> lock(traceMutex_);
+    capturing_ = false;
+    UMPTrace trace;
+    std::swap(trace, trace_);
+    return trace;
+}
+
+bool UMPTraceRecorder::IsCapturing() {
+    return capturing_;
+}
+
+// every scope reads the clock twice, so this stays off the trace mutex
+std::int64_t UMPTraceRecorder::Now() {
+    auto start = clockStart_.load(std::memory_order_relaxed);
+    return start != 0 ? (SteadyNanoseconds() - start) / 1000 : 0;
+}
+
+// small thread numbers read better in a trace viewer than native ids
+std::uint32_t UMPTraceRecorder::CurrentThread() {
+    thread_local std::uint32_t thread = ++threadCount_;
+    return thread;
+}
+
+void UMPTraceRecorder::Add(UMPTraceEvent&& event) {
+    std::lock_guard<std::mutex> lock(traceMutex_);
+    if (!capturing_)
+        return;
+    trace_.events_.push_back(std::move(event));
+}
+
+UMPScopedTimer::UMPScopedTimer(const char* name) : recording_(UMPTraceRecorder::IsCapturing()) {
+    if (!recording_)
+        return;
+    event_.name_ = name;
+    event_.thread_ = UMPTraceRecorder::CurrentThread();
+    event_.depth_ = CurrentDepth()++;
+    event_.start_ = UMPTraceRecorder::Now();
+}
+
+UMPScopedTimer::~UMPScopedTimer() {
+    if (!recording_)
+        return;
+    CurrentDepth()--;
+    event_.duration_ = UMPTraceRecorder::Now() - event_.start_;
+    UMPTraceRecorder::Add(std::move(event_));
+}
+
+void UMPScopedTimer::AddCounter(const char* name, std::uint64_t value) {
+    if (recording_)
+        event_.counters_.emplace_back(name, value);
+}
+
+QByteArray UMPTraceToChromeJson(const UMPTrace& trace) {
+    QJsonArray events;
+    auto processName = [&events](UMPTraceProcess process, const QString& name) {
+        QJsonObject event;
+        event["name"] = "process_name";
+        event["ph"] = "M";
+        event["pid"] = static_cast<int>(process);
+        event["args"] = QJsonObject { { "name", name } };
+        events.append(event);
+    };
+    processName(UMPTraceProcess::HOST, "UnityMemPerf");
+    processName(UMPTraceProcess::AGENT, "Agent");
+    for (auto& from : trace.events_) {
+        QJsonObject event;
+        event["name"] = from.name_;
+        event["cat"] = from.process_ == UMPTraceProcess::AGENT ? "agent" : "host";
+        event["ph"] = "X";
+        event["pid"] = static_cast<int>(from.process_);
+        event["tid"] = static_cast<int>(from.thread_);
+        event["ts"] = static_cast<double>(from.start_);
+        event["dur"] = static_cast<double>(from.duration_);
+        QJsonObject args;
+        for (auto& counter : from.counters_)
+            args[counter.first] = static_cast<double>(counter.second);
+        if (!args.isEmpty())
+            event["args"] = args;
+        events.append(event);
+    }
+    QJsonObject root;
+    root["traceEvents"] = events;
+    root["displayTimeUnit"] = "ms";
+    root["otherData"] = QJsonObject { { "capture", trace.name_ } };
+    return QJsonDocument(root).toJson(QJsonDocument::Compact);
+}
+
+QString UMPTraceSummary(const UMPTrace& trace) {
+    // scopes are recorded as they close, list them as they opened
+    std::vector<const UMPTraceEvent*> events;
+    for (auto& event : trace.events_) {
+        if (event.depth_ == 0)
+            events.push_back(&event);
+    }
+    std::stable_sort(events.begin(), events.end(), [](const UMPTraceEvent* a, const UMPTraceEvent* b) {
+        return a->start_ < b->start_;
+    });
+    QStringList stages;
+    for (auto event : events) {
+        auto name = event->process_ == UMPTraceProcess::AGENT ? "agent " + event->name_ : event->name_;
+        auto stage = QString("%1 %2 ms").arg(name).arg(event->duration_ / 1000);
+        for (auto& counter : event->counters_) {
+            if (counter.first.endsWith("bytes"))
+                stage += QString(" (%1 MB)").arg(static_cast<double>(counter.second) / 1024 / 1024, 0, 'f', 1);
+        }
+        stages << stage;
+    }
+    return stages.join(", ");
+}
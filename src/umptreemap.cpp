@@ -0,0 +1,287 @@
+#include "umptreemap.h"
+
+#include <QPainter>
+#include <QMouseEvent>
+#include <QKeyEvent>
+#include <QToolTip>
+#include <QVector>
+#include <QtConcurrent/QtConcurrentRun>
+
+#include <algorithm>
+#include <cmath>
+
+#include "umpcrawler.h"
+#include "umpmodel.h"
+
+// rects past this many per zoom level go to the "other" rect, more would be too small to see anyway
+const std::size_t kMaxTreemapRects = 2000;
+// rects are filled with one brush per hue bucket, so painting costs a call per bucket rather than per rect
+const int kTreemapHueBuckets = 16;
+const double kMinLabelWidth = 60;
+const double kMinLabelHeight = 14;
+
+void UMPSquarify(std::vector<UMPTreemapItem> items, std::int64_t otherSize, const QRectF& bounds, std::vector<UMPTreemapRect>& outRects) {
+    outRects.clear();
+    items.erase(std::remove_if(items.begin(), items.end(), [](const UMPTreemapItem& item) { return item.size_ <= 0; }), items.end());
+    if (otherSize > 0)
+        items.push_back({ otherSize, kTreemapOther });
+    if (items.empty() || bounds.isEmpty())
+        return;
+    auto bySize = [](const UMPTreemapItem& a, const UMPTreemapItem& b) { return a.size_ > b.size_; };
+    std::sort(items.begin(), items.end(), bySize);
+    double total = 0;
+    for (auto& item : items)
+        total += static_cast<double>(item.size_);
+    auto scale = bounds.width() * bounds.height() / total;
+    auto free = bounds;
+    std::size_t rowBegin = 0;
+    while (rowBegin < items.size()) {
+        // grow the row along the short side while that improves its worst aspect ratio, items are sorted
+        // so the first one is the largest of the row and the one being added the smallest
+        auto side = std::min(free.width(), free.height());
+        if (side <= 0)
+            break;
+        auto largest = static_cast<double>(items[rowBegin].size_) * scale;
+        double rowArea = 0;
+        auto worst = std::numeric_limits<double>::max();
+        auto rowEnd = rowBegin;
+        while (rowEnd < items.size()) {
+            auto area = static_cast<double>(items[rowEnd].size_) * scale;
+            auto newArea = rowArea + area;
+            auto ratio = std::max(side * side * largest / (newArea * newArea), newArea * newArea / (side * side * area));
+            if (ratio > worst)
+                break;
+            worst = ratio;
+            rowArea = newArea;
+            rowEnd++;
+        }
+        auto thickness = rowArea / side;
+        // a wide free area gets a column at its left edge, a tall one a row at its top
+        auto column = free.width() >= free.height();
+        double offset = 0;
+        for (auto i = rowBegin; i < rowEnd; i++) {
+            auto length = static_cast<double>(items[i].size_) * scale / thickness;
+            UMPTreemapRect rect;
+            rect.rect_ = column ? QRectF(free.left(), free.top() + offset, thickness, length)
+                                : QRectF(free.left() + offset, free.top(), length, thickness);
+            rect.size_ = items[i].size_;
+            rect.id_ = items[i].id_;
+            outRects.push_back(rect);
+            offset += length;
+        }
+        if (column)
+            free.setLeft(free.left() + thickness);
+        else
+            free.setTop(free.top() + thickness);
+        rowBegin = rowEnd;
+    }
+}
+
+// keeps the kMaxTreemapRects largest items as a min-heap and sums up the rest, so a type with
+// millions of instances is never copied out whole
+static void AddLargestItem(std::vector<UMPTreemapItem>& items, std::int64_t& otherSize, const UMPTreemapItem& item) {
+    if (item.size_ <= 0)
+        return;
+    auto bySize = [](const UMPTreemapItem& a, const UMPTreemapItem& b) { return a.size_ > b.size_; };
+    if (items.size() < kMaxTreemapRects) {
+        items.push_back(item);
+        std::push_heap(items.begin(), items.end(), bySize);
+    } else if (item.size_ > items.front().size_) {
+        otherSize += items.front().size_;
+        std::pop_heap(items.begin(), items.end(), bySize);
+        items.back() = item;
+        std::push_heap(items.begin(), items.end(), bySize);
+    } else {
+        otherSize += item.size_;
+    }
+}
+
+UMPTreemapWidget::UMPTreemapWidget(const UMPTypeGroupModel* typeGroups, QWidget *parent)
+    : QWidget(parent), typeGroups_(typeGroups) {
+    setMouseTracking(true);
+    setFocusPolicy(Qt::StrongFocus);
+    connect(&watcher_, &QFutureWatcher<std::vector<UMPTreemapRect>>::finished, this, &UMPTreemapWidget::OnLayoutFinished);
+}
+
+UMPTreemapWidget::~UMPTreemapWidget() {
+    // the layout reads the type groups, which go away with the snapshot tab
+    watcher_.waitForFinished();
+}
+
+void UMPTreemapWidget::ZoomTo(std::uint32_t typeIndex) {
+    zoomType_ = typeIndex;
+    hovered_ = kTreemapOther;
+    selected_ = kTreemapOther;
+    auto it = layouts_.find(zoomType_);
+    if (it != layouts_.end()) {
+        rects_ = it.value();
+        update();
+        return;
+    }
+    rects_.clear();
+    update();
+    RequestLayout();
+}
+
+void UMPTreemapWidget::RequestLayout() {
+    generation_++;
+    if (!watcher_.isRunning())
+        StartLayout();
+}
+
+void UMPTreemapWidget::StartLayout() {
+    runningGeneration_ = generation_;
+    auto typeGroups = typeGroups_;
+    auto typeIndex = zoomType_;
+    QRectF bounds(rect());
+    runningZoom_ = zoomType_;
+    watcher_.setFuture(QtConcurrent::run([typeGroups, typeIndex, bounds]() {
+        std::vector<UMPTreemapItem> items;
+        std::int64_t otherSize = 0;
+        if (typeIndex == kTreemapOther) {
+            for (int row = 0; row < typeGroups->rowCount(); row++)
+                AddLargestItem(items, otherSize, { typeGroups->getSubModel(row).size_, static_cast<std::uint32_t>(row) });
+        } else {
+            for (auto thing : typeGroups->getSubModel(static_cast<int>(typeIndex)).objects_)
+                AddLargestItem(items, otherSize, { thing->size_, thing->index_ });
+        }
+        std::vector<UMPTreemapRect> rects;
+        UMPSquarify(std::move(items), otherSize, bounds, rects);
+        return rects;
+    }));
+}
+
+void UMPTreemapWidget::OnLayoutFinished() {
+    if (runningGeneration_ != generation_) {
+        // zoomed or resized meanwhile
+        StartLayout();
+        return;
+    }
+    QRectF bounds(rect());
+    if (bounds != rectsBounds_)
+        layouts_.clear();
+    rectsBounds_ = bounds;
+    // a level that was zoomed out of meanwhile is only cached
+    layouts_[runningZoom_] = watcher_.result();
+    if (runningZoom_ == zoomType_) {
+        rects_ = layouts_[runningZoom_];
+        update();
+    }
+}
+
+void UMPTreemapWidget::resizeEvent(QResizeEvent*) {
+    layouts_.clear();
+    RequestLayout();
+}
+
+void UMPTreemapWidget::paintEvent(QPaintEvent*) {
+    QPainter painter(this);
+    painter.fillRect(rect(), palette().window());
+    if (rects_.empty()) {
+        painter.drawText(rect(), Qt::AlignCenter, watcher_.isRunning() ? "Laying out..." : "Nothing to show");
+        return;
+    }
+    // stretch the last layout until the one for the new size arrives
+    auto scaleX = rectsBounds_.width() > 0 ? width() / rectsBounds_.width() : 1.0;
+    auto scaleY = rectsBounds_.height() > 0 ? height() / rectsBounds_.height() : 1.0;
+    auto toWidget = [=](const QRectF& r) {
+        return QRectF(r.left() * scaleX, r.top() * scaleY, r.width() * scaleX, r.height() * scaleY);
+    };
+    QVector<QRectF> buckets[kTreemapHueBuckets + 1]; // the last one is the other rect
+    for (auto& rect : rects_) {
+        auto bucket = rect.id_ == kTreemapOther ? kTreemapHueBuckets : static_cast<int>((rect.id_ * 2654435761u) % kTreemapHueBuckets);
+        buckets[bucket].push_back(toWidget(rect.rect_));
+    }
+    painter.setPen(QPen(palette().dark().color(), 0));
+    for (int bucket = 0; bucket <= kTreemapHueBuckets; bucket++) {
+        if (buckets[bucket].isEmpty())
+            continue;
+        painter.setBrush(bucket == kTreemapHueBuckets ? QColor(Qt::lightGray) : QColor::fromHsv(bucket * 360 / kTreemapHueBuckets, 70, 230));
+        painter.drawRects(buckets[bucket]);
+    }
+    painter.setBrush(Qt::NoBrush);
+    painter.setPen(palette().text().color());
+    auto metrics = painter.fontMetrics();
+    for (auto& rect : rects_) {
+        auto r = toWidget(rect.rect_);
+        if (r.width() < kMinLabelWidth || r.height() < kMinLabelHeight)
+            continue;
+        auto text = metrics.elidedText(CaptionOf(rect), Qt::ElideRight, static_cast<int>(r.width()) - 4);
+        painter.drawText(r.adjusted(2, 1, -2, -1), Qt::AlignLeft | Qt::AlignTop, text);
+    }
+    for (auto& rect : rects_) {
+        if (rect.id_ == selected_ || rect.id_ == hovered_) {
+            painter.setPen(QPen(rect.id_ == selected_ ? palette().highlight().color() : palette().text().color(), 2));
+            painter.drawRect(toWidget(rect.rect_));
+        }
+    }
+}
+
+const UMPTreemapRect* UMPTreemapWidget::RectAt(const QPointF& pos) const {
+    if (width() <= 0 || height() <= 0)
+        return nullptr;
+    QPointF layoutPos(pos.x() * rectsBounds_.width() / width(), pos.y() * rectsBounds_.height() / height());
+    for (auto& rect : rects_) {
+        if (rect.rect_.contains(layoutPos))
+            return &rect;
+    }
+    return nullptr;
+}
+
+QString UMPTreemapWidget::CaptionOf(const UMPTreemapRect& rect) const {
+    if (rect.id_ == kTreemapOther)
+        return QString("Other %1").arg(sizeToString(rect.size_));
+    auto snapshot = typeGroups_->getSnapshot();
+    if (zoomType_ == kTreemapOther) {
+        auto& group = typeGroups_->getSubModel(static_cast<int>(rect.id_));
+        return QString("%1 %2 (%3)").arg(snapshot->typeCatalog_->TypeName(*group.type_)).arg(sizeToString(rect.size_)).arg(static_cast<quint64>(group.objects_.size()));
+    }
+    auto thing = snapshot->allObjects_[rect.id_];
+    if (thing->type() == ThingType::MANAGED)
+        return QString("%1 %2").arg(static_cast<const ManagedObject*>(thing)->address_, 0, 16).arg(sizeToString(rect.size_));
+    return QString("%1 %2").arg(thing->caption_).arg(sizeToString(rect.size_));
+}
+
+void UMPTreemapWidget::mousePressEvent(QMouseEvent* event) {
+    if (event->button() == Qt::RightButton) {
+        if (zoomType_ != kTreemapOther)
+            ZoomTo(kTreemapOther);
+        return;
+    }
+    auto rect = RectAt(event->localPos());
+    if (rect == nullptr || rect->id_ == kTreemapOther)
+        return;
+    selected_ = rect->id_;
+    update();
+    if (zoomType_ == kTreemapOther)
+        emit TypeSelected(rect->id_);
+}
+
+void UMPTreemapWidget::mouseDoubleClickEvent(QMouseEvent* event) {
+    auto rect = RectAt(event->localPos());
+    if (rect == nullptr || rect->id_ == kTreemapOther)
+        return;
+    if (zoomType_ == kTreemapOther)
+        ZoomTo(rect->id_);
+    else
+        emit ThingSelected(rect->id_);
+}
+
+void UMPTreemapWidget::mouseMoveEvent(QMouseEvent* event) {
+    auto rect = RectAt(event->localPos());
+    auto hovered = rect != nullptr ? rect->id_ : kTreemapOther;
+    if (rect != nullptr)
+        QToolTip::showText(event->globalPos(), CaptionOf(*rect), this);
+    if (hovered != hovered_) {
+        hovered_ = hovered;
+        update();
+    }
+}
+
+void UMPTreemapWidget::keyPressEvent(QKeyEvent* event) {
+    if (event->key() == Qt::Key_Backspace && zoomType_ != kTreemapOther) {
+        ZoomTo(kTreemapOther);
+        return;
+    }
+    QWidget::keyPressEvent(event);
+}
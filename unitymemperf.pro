@@ -4,7 +4,7 @@
 #
 #-------------------------------------------------
 
-QT       += core gui opengl network
+QT       += core gui opengl network concurrent
 
 greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
 
@@ -34,16 +34,31 @@ SOURCES += \
         src/mainwindow.cpp \
         src/startappprocess.cpp \
         src/remoteprocess.cpp \
+        src/umpanalyzer.cpp \
         src/umpcrawler.cpp \
-        src/umpmodel.cpp
+        src/umpexport.cpp \
+        src/umpheapstrip.cpp \
+        src/umpmodel.cpp \
+        src/umpquery.cpp \
+        src/umpstringpool.cpp \
+        src/umptrace.cpp \
+        src/umptreemap.cpp
 
 HEADERS += \
         include/adbprocess.h \
         include/detailswidget.h \
         include/globalLog.h \
+        include/umpanalyzer.h \
         include/umpcrawler.h \
+        include/umpexport.h \
+        include/umpheapstrip.h \
         include/umpmemory.h \
         include/umpmodel.h \
+        include/umpparallel.h \
+        include/umpquery.h \
+        include/umpstringpool.h \
+        include/umptrace.h \
+        include/umptreemap.h \
         include/mainwindow.h \
         include/startappprocess.h \
         include/remoteprocess.h